@@ -0,0 +1,193 @@
+#include "AnalogKernel.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GOPHER_ANALOG_SSE2
+#include <emmintrin.h>
+#endif
+
+static_assert(XUSER_MAX_COUNT == 4, "The analog kernel handles one pad per SSE lane");
+static_assert(sizeof(XINPUT_STATE) == 16, "The analog kernel loads one XINPUT_STATE per SSE register");
+
+// Description:
+//   Computes the analog outputs of every pad one at a time. Reference for the SSE2 kernel and
+//     the fallback on processors without it.
+//
+// Params:
+//   states     The controller state of every pad slot
+//   settings   Dead zones, curves and trigger modes to apply
+//   frame      Receives the outputs of every pad
+void processAnalogScalar(const XINPUT_STATE states[XUSER_MAX_COUNT], const AnalogSettings &settings, AnalogFrame &frame)
+{
+  frame.active = 0;
+
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+  {
+    const XINPUT_GAMEPAD &pad = states[i].Gamepad;
+    const float lx = pad.sThumbLX;
+    const float ly = pad.sThumbLY;
+    const float rx = pad.sThumbRX;
+    const float ry = pad.sThumbRY;
+    const float cx = settings.swapSticks ? rx : lx;
+    const float cy = settings.swapSticks ? ry : ly;
+    const float sx = settings.swapSticks ? lx : rx;
+    const float sy = settings.swapSticks ? ly : ry;
+
+    const float triggers[2] = { (float)pad.bLeftTrigger, (float)pad.bRightTrigger };
+    float axes[2];
+    bool active = false;
+    for (int t = 0; t < 2; ++t)
+    {
+      const float deflection = triggers[t] * TRIGGER_TO_STICK;
+      axes[t] = settings.triggerCurve->evaluate(deflection * deflection);
+      active = active || triggers[t] > settings.triggerRest[t];
+    }
+
+    float cursorSq = cx * cx + cy * cy;
+    float cursorMult = 0.0f;
+    if (cursorSq > settings.cursorDeadZoneSq)
+    {
+      cursorMult = settings.cursorCurve->evaluate(cursorSq) * (1.0f + settings.triggerSpeed[0] * axes[0]) * (1.0f + settings.triggerSpeed[1] * axes[1]);
+      active = true;
+    }
+
+    float scrollSq = sx * sx + sy * sy;
+    float scrollMult = 0.0f;
+    if (scrollSq > settings.scrollDeadZoneSq)
+    {
+      scrollMult = settings.scrollCurve->evaluate(scrollSq);
+      active = true;
+    }
+
+    frame.cursorX[i] = cx * cursorMult;
+    frame.cursorY[i] = cy * cursorMult;
+    frame.wheelX[i] = sx * scrollMult;
+    frame.wheelY[i] = sy * scrollMult + settings.triggerWheel[0] * axes[0] + settings.triggerWheel[1] * axes[1];
+    if (active)
+    {
+      frame.active |= 1 << i;
+    }
+  }
+}
+
+#ifdef GOPHER_ANALOG_SSE2
+
+// Description:
+//   Looks up four deflections in a response curve, matching ResponseCurve::evaluate. Deflections
+//     past the end of the table land on its last entry with a fraction of 1, which gives the
+//     same clamp without a branch.
+//
+// Params:
+//   curve      The curve to evaluate
+//   lengthsq   The squared deflections
+//
+// Returns:
+//   The four multipliers.
+static inline __m128 evaluateCurve(const ResponseCurve &curve, __m128 lengthsq)
+{
+  const float *table = curve.getTable();
+  const __m128 position = _mm_min_ps(_mm_mul_ps(lengthsq, _mm_set1_ps(curve.getIndexScale())), _mm_set1_ps((float)ResponseCurve::TABLE_SIZE));
+  const __m128i index = _mm_cvttps_epi32(_mm_min_ps(position, _mm_set1_ps((float)(ResponseCurve::TABLE_SIZE - 1))));
+  const __m128 fraction = _mm_sub_ps(position, _mm_cvtepi32_ps(index));
+
+  // SSE2 has no gather.
+  alignas(16) int indices[4];
+  _mm_store_si128((__m128i*)indices, index);
+  const __m128 low = _mm_setr_ps(table[indices[0]], table[indices[1]], table[indices[2]], table[indices[3]]);
+  const __m128 high = _mm_setr_ps(table[indices[0] + 1], table[indices[1] + 1], table[indices[2] + 1], table[indices[3] + 1]);
+  return _mm_add_ps(low, _mm_mul_ps(_mm_sub_ps(high, low), fraction));
+}
+
+// Description:
+//   Sign extends the low or high four 16 bit lanes to floats.
+static inline __m128 lowShortsToFloats(__m128i shorts)
+{
+  return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(shorts, shorts), 16));
+}
+
+static inline __m128 highShortsToFloats(__m128i shorts)
+{
+  return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(shorts, shorts), 16));
+}
+
+// Description:
+//   Computes the analog outputs of every pad at once, one pad per SSE lane. The four states
+//     are loaded as four registers and transposed, so every axis and trigger ends up in a
+//     register of its own. Same results as processAnalogScalar.
+//
+// Params:
+//   states     The controller state of every pad slot
+//   settings   Dead zones, curves and trigger modes to apply
+//   frame      Receives the outputs of every pad
+void processAnalog(const XINPUT_STATE states[XUSER_MAX_COUNT], const AnalogSettings &settings, AnalogFrame &frame)
+{
+  // Every state is, in 16 bit lanes: packet low, packet high, buttons, triggers, LX, LY, RX, RY.
+  const __m128i s0 = _mm_loadu_si128((const __m128i*)&states[0]);
+  const __m128i s1 = _mm_loadu_si128((const __m128i*)&states[1]);
+  const __m128i s2 = _mm_loadu_si128((const __m128i*)&states[2]);
+  const __m128i s3 = _mm_loadu_si128((const __m128i*)&states[3]);
+
+  // Thumbsticks: LX of pads 0-3 followed by LY of pads 0-3, then the same for the right stick.
+  const __m128i sticks01 = _mm_unpackhi_epi64(s0, s1);
+  const __m128i sticks23 = _mm_unpackhi_epi64(s2, s3);
+  const __m128i sticksLo = _mm_unpacklo_epi16(sticks01, sticks23);
+  const __m128i sticksHi = _mm_unpackhi_epi16(sticks01, sticks23);
+  const __m128i left = _mm_unpacklo_epi16(sticksLo, sticksHi);
+  const __m128i right = _mm_unpackhi_epi16(sticksLo, sticksHi);
+  const __m128 lx = lowShortsToFloats(left);
+  const __m128 ly = highShortsToFloats(left);
+  const __m128 rx = lowShortsToFloats(right);
+  const __m128 ry = highShortsToFloats(right);
+
+  // Triggers: the buttons of pads 0-3 followed by their packed trigger bytes.
+  const __m128i header01 = _mm_unpacklo_epi64(s0, s1);
+  const __m128i header23 = _mm_unpacklo_epi64(s2, s3);
+  const __m128i header = _mm_unpackhi_epi16(_mm_unpacklo_epi16(header01, header23), _mm_unpackhi_epi16(header01, header23));
+  const __m128i triggers = _mm_unpackhi_epi16(header, _mm_setzero_si128());
+  const __m128 lt = _mm_cvtepi32_ps(_mm_and_si128(triggers, _mm_set1_epi32(0xFF)));
+  const __m128 rt = _mm_cvtepi32_ps(_mm_srli_epi32(triggers, 8));
+
+  const __m128 cx = settings.swapSticks ? rx : lx;
+  const __m128 cy = settings.swapSticks ? ry : ly;
+  const __m128 sx = settings.swapSticks ? lx : rx;
+  const __m128 sy = settings.swapSticks ? ly : ry;
+
+  const __m128 toStick = _mm_set1_ps(TRIGGER_TO_STICK);
+  const __m128 lDeflection = _mm_mul_ps(lt, toStick);
+  const __m128 rDeflection = _mm_mul_ps(rt, toStick);
+  const __m128 lAxis = evaluateCurve(*settings.triggerCurve, _mm_mul_ps(lDeflection, lDeflection));
+  const __m128 rAxis = evaluateCurve(*settings.triggerCurve, _mm_mul_ps(rDeflection, rDeflection));
+
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 cursorSq = _mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy));
+  const __m128 cursorMoving = _mm_cmpgt_ps(cursorSq, _mm_set1_ps(settings.cursorDeadZoneSq));
+  const __m128 speed = _mm_mul_ps(
+    _mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(settings.triggerSpeed[0]), lAxis)),
+    _mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(settings.triggerSpeed[1]), rAxis)));
+  const __m128 cursorMult = _mm_and_ps(cursorMoving, _mm_mul_ps(evaluateCurve(*settings.cursorCurve, cursorSq), speed));
+
+  const __m128 scrollSq = _mm_add_ps(_mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy));
+  const __m128 scrolling = _mm_cmpgt_ps(scrollSq, _mm_set1_ps(settings.scrollDeadZoneSq));
+  const __m128 scrollMult = _mm_and_ps(scrolling, evaluateCurve(*settings.scrollCurve, scrollSq));
+  const __m128 triggerWheel = _mm_add_ps(
+    _mm_mul_ps(_mm_set1_ps(settings.triggerWheel[0]), lAxis),
+    _mm_mul_ps(_mm_set1_ps(settings.triggerWheel[1]), rAxis));
+
+  _mm_storeu_ps(frame.cursorX, _mm_mul_ps(cx, cursorMult));
+  _mm_storeu_ps(frame.cursorY, _mm_mul_ps(cy, cursorMult));
+  _mm_storeu_ps(frame.wheelX, _mm_mul_ps(sx, scrollMult));
+  _mm_storeu_ps(frame.wheelY, _mm_add_ps(_mm_mul_ps(sy, scrollMult), triggerWheel));
+
+  const __m128 triggering = _mm_or_ps(
+    _mm_cmpgt_ps(lt, _mm_set1_ps(settings.triggerRest[0])),
+    _mm_cmpgt_ps(rt, _mm_set1_ps(settings.triggerRest[1])));
+  frame.active = (DWORD)_mm_movemask_ps(_mm_or_ps(_mm_or_ps(cursorMoving, scrolling), triggering));
+}
+
+#else
+
+void processAnalog(const XINPUT_STATE states[XUSER_MAX_COUNT], const AnalogSettings &settings, AnalogFrame &frame)
+{
+  processAnalogScalar(states, settings, frame);
+}
+
+#endif
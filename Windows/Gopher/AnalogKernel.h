@@ -0,0 +1,38 @@
+#pragma once
+
+#include <windows.h>
+#include <xinput.h>
+
+#include "ResponseCurve.h"
+
+// Scales a trigger value to the thumbstick range, so triggers share the curve code.
+const float TRIGGER_TO_STICK = MAXSHORT / 255.0f;
+
+// Everything the analog kernel needs from the config, gathered whenever the config or the
+// cursor speed changes. Index 0 of the trigger arrays is the left trigger, 1 the right one.
+struct AnalogSettings
+{
+  const ResponseCurve *cursorCurve = nullptr;
+  const ResponseCurve *scrollCurve = nullptr;
+  const ResponseCurve *triggerCurve = nullptr;  // Trigger outputs from 0 at the dead zone to 1 at full press.
+  float cursorDeadZoneSq = 0.0f;    // Squared dead zone of the cursor stick.
+  float scrollDeadZoneSq = 0.0f;    // Squared dead zone of the scroll stick.
+  bool swapSticks = false;          // Moves the cursor with the right stick and scrolls with the left one.
+  float triggerRest[2] = { 255.0f, 255.0f };  // Value at or below which a trigger drives nothing. 255 when it drives no axis.
+  float triggerSpeed[2] = { 0.0f, 0.0f };     // Change of the cursor speed at full press. 0 when not a speed control.
+  float triggerWheel[2] = { 0.0f, 0.0f };     // Wheel units per frame at full press. 0 when the trigger does not scroll.
+};
+
+// Analog outputs of every pad for one frame, one lane per pad.
+struct AnalogFrame
+{
+  float cursorX[XUSER_MAX_COUNT];   // Cursor motion, trigger speed control included.
+  float cursorY[XUSER_MAX_COUNT];
+  float wheelX[XUSER_MAX_COUNT];    // Wheel motion of the scroll stick and the scrolling triggers.
+  float wheelY[XUSER_MAX_COUNT];
+  DWORD active;                     // Bit n is set when the sticks or triggers of pad n produce motion.
+};
+
+void processAnalog(const XINPUT_STATE states[XUSER_MAX_COUNT], const AnalogSettings &settings, AnalogFrame &frame);
+
+void processAnalogScalar(const XINPUT_STATE states[XUSER_MAX_COUNT], const AnalogSettings &settings, AnalogFrame &frame);
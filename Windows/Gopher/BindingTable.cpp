@@ -0,0 +1,272 @@
+#include "BindingTable.h"
+
+#include <intrin.h>
+
+// Description:
+//   Checks whether every button of a chord became held this frame.
+static bool chordPressed(WORD chord, WORD buttons, WORD previousButtons)
+{
+  return (buttons & chord) == chord && (previousButtons & chord) != chord;
+}
+
+BindingTable::BindingTable()
+{
+  clear();
+}
+
+// Description:
+//   Unbinds every binding.
+void BindingTable::clear()
+{
+  ZeroMemory(_masks, sizeof(_masks));
+  ZeroMemory(_sequences, sizeof(_sequences));
+  _sequenceWindow = 0;
+  compile();
+}
+
+// Description:
+//   Assigns the controller buttons that trigger a binding.
+//
+// Params:
+//   id     The binding to assign
+//   mask   The buttons that must all be held. 0 disables the binding.
+void BindingTable::bind(BindingId id, WORD mask)
+{
+  bindSequence(id, &mask, 1);
+}
+
+// Description:
+//   Assigns a sequence of chords that trigger a binding. The binding is held from the press of
+//     the last chord until it is released, if every chord was pressed within the sequence
+//     window of the one before. Pressing any other button starts over.
+//
+// Params:
+//   id     The binding to assign
+//   steps  The buttons of every chord, in order. Steps of 0 are left out.
+//   count  Number of steps. Steps past MAX_SEQUENCE_STEPS are ignored.
+void BindingTable::bindSequence(BindingId id, const WORD *steps, size_t count)
+{
+  BindingSequence &sequence = _sequences[id];
+  ZeroMemory(&sequence, sizeof(sequence));
+  for (size_t i = 0; i < count && sequence.count < MAX_SEQUENCE_STEPS; ++i)
+  {
+    if (steps[i] != 0)
+    {
+      sequence.steps[sequence.count++] = steps[i];
+    }
+  }
+
+  _masks[id] = sequence.count > 0 ? sequence.steps[sequence.count - 1] : 0;
+
+  // A single chord is not a sequence.
+  if (sequence.count == 1)
+  {
+    sequence.count = 0;
+  }
+
+  compile();
+}
+
+// Description:
+//   Sets the longest time allowed between two steps of a sequence.
+//
+// Params:
+//   ticks  The time in performance counter ticks
+void BindingTable::setSequenceWindow(LONGLONG ticks)
+{
+  _sequenceWindow = ticks;
+}
+
+// Description:
+//   Rebuilds the bit sets used by BindingState::update() from the masks of the bindings.
+void BindingTable::compile()
+{
+  ZeroMemory(_usingButton, sizeof(_usingButton));
+  _bound = 0;
+  _withSupersets = 0;
+  _sequenceBindings = 0;
+  _usedButtons = 0;
+
+  for (int id = 0; id < BINDING_COUNT; ++id)
+  {
+    const WORD mask = _masks[id];
+    if (mask == 0)
+    {
+      continue;
+    }
+
+    const BindingSet bit = 1u << id;
+    _bound |= bit;
+    _usedButtons |= mask;
+    for (int button = 0; button < 16; ++button)
+    {
+      if (mask & (1 << button))
+      {
+        _usingButton[button] |= bit;
+      }
+    }
+    if (_sequences[id].count > 0)
+    {
+      _sequenceBindings |= bit;
+    }
+  }
+
+  const BindingSet chords = _bound & ~_sequenceBindings;
+  for (int id = 0; id < BINDING_COUNT; ++id)
+  {
+    _supersets[id] = 0;
+    if (!(chords & (1u << id)))
+    {
+      continue;
+    }
+
+    const WORD mask = _masks[id];
+    for (int other = 0; other < BINDING_COUNT; ++other)
+    {
+      const WORD otherMask = _masks[other];
+      if ((chords & (1u << other)) && otherMask != mask && (otherMask & mask) == mask)
+      {
+        _supersets[id] |= 1u << other;
+      }
+    }
+    if (_supersets[id] != 0)
+    {
+      _withSupersets |= 1u << id;
+    }
+  }
+}
+
+BindingState::BindingState()
+{
+  reset();
+}
+
+// Description:
+//   Forgets the press state of every binding, e.g. after the pad was unplugged or the profile
+//     changed.
+void BindingState::reset()
+{
+  ZeroMemory(_bindings, sizeof(_bindings));
+  ZeroMemory(_sequences, sizeof(_sequences));
+  _active = 0;
+  _suppressed = 0;
+  _edges = 0;
+}
+
+// Description:
+//   Computes the press and release edges of every binding for one frame.
+//
+// Params:
+//   table            The bindings of the profile in use
+//   buttons          The wButtons word of the current frame
+//   previousButtons  The wButtons word of the previous frame
+//   now              Performance counter value of the current frame
+void BindingState::update(const BindingTable &table, WORD buttons, WORD previousButtons, LONGLONG now)
+{
+  // A binding is held unless one of its buttons is released.
+  BindingSet notHeld = 0;
+  for (DWORD up = (WORD)~buttons & table._usedButtons; up != 0; up &= up - 1)
+  {
+    unsigned long button;
+    _BitScanForward(&button, up);
+    notHeld |= table._usingButton[button];
+  }
+  BindingSet held = table._bound & ~notHeld;
+
+  // A sequence is held only once all of its steps were pressed in time.
+  BindingSet completed = 0;
+  for (BindingSet pending = table._sequenceBindings; pending != 0; pending &= pending - 1)
+  {
+    unsigned long id;
+    _BitScanForward(&id, pending);
+    if (advanceSequence(table, id, buttons, previousButtons, now))
+    {
+      completed |= 1u << id;
+    }
+  }
+  held = (held & ~table._sequenceBindings) | completed;
+
+  // Chords contained in a held larger chord stay suppressed until their own buttons are released.
+  BindingSet overridden = 0;
+  for (BindingSet pending = held & table._withSupersets; pending != 0; pending &= pending - 1)
+  {
+    unsigned long id;
+    _BitScanForward(&id, pending);
+    if (held & table._supersets[id])
+    {
+      overridden |= 1u << id;
+    }
+  }
+  _suppressed = (_suppressed | overridden) & held;
+
+  const BindingSet active = held & ~_suppressed;
+  const BindingSet pressed = active & ~_active;
+  const BindingSet released = _active & ~active;
+
+  // Only bindings that are held, or were changed or held last frame, have state to update.
+  for (BindingSet touched = active | _active | _edges; touched != 0; touched &= touched - 1)
+  {
+    unsigned long id;
+    _BitScanForward(&id, touched);
+    const BindingSet bit = 1u << id;
+
+    Binding &binding = _bindings[id];
+    binding.isDown = (pressed & bit) != 0;
+    binding.isUp = (released & bit) != 0;
+  }
+
+  _active = active;
+  _edges = pressed | released;
+}
+
+// Description:
+//   Advances a sequence by the buttons pressed this frame.
+//
+// Params:
+//   table            The bindings of the profile in use
+//   id               The binding of the sequence
+//   buttons          The wButtons word of the current frame
+//   previousButtons  The wButtons word of the previous frame
+//   now              Performance counter value of the current frame
+//
+// Returns:
+//   true while every step was pressed and the last one is still held.
+bool BindingState::advanceSequence(const BindingTable &table, DWORD id, WORD buttons, WORD previousButtons, LONGLONG now)
+{
+  const BindingSequence &sequence = table._sequences[id];
+  SequenceProgress &state = _sequences[id];
+  if (state.progress == sequence.count)
+  {
+    const WORD last = sequence.steps[sequence.count - 1];
+    if ((buttons & last) == last)
+    {
+      return true;
+    }
+    state.progress = 0;
+  }
+  else if (state.progress > 0 && now - state.stepTime > table._sequenceWindow)
+  {
+    state.progress = 0;
+  }
+
+  const WORD pressed = buttons & ~previousButtons;
+  if (pressed == 0)
+  {
+    return false;
+  }
+
+  const WORD step = sequence.steps[state.progress];
+  if (chordPressed(step, buttons, previousButtons))
+  {
+    ++state.progress;
+    state.stepTime = now;
+  }
+  else if (pressed & ~step)
+  {
+    // Any other button breaks the sequence, and may start it over.
+    state.progress = chordPressed(sequence.steps[0], buttons, previousButtons) ? 1 : 0;
+    state.stepTime = now;
+  }
+
+  return state.progress == sequence.count;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <windows.h>
+
+// Dense identifiers of every controller button binding Gopher knows about.
+enum BindingId
+{
+  // Gopher commands
+  BINDING_MOUSE_LEFT,
+  BINDING_MOUSE_RIGHT,
+  BINDING_MOUSE_MIDDLE,
+  BINDING_HIDE,
+  BINDING_DISABLE,
+  BINDING_DISABLE_VIBRATION,
+  BINDING_SPEED_CHANGE,
+  BINDING_OSK,
+
+  // Keyboard mappings
+  BINDING_DPAD_UP,
+  BINDING_DPAD_DOWN,
+  BINDING_DPAD_LEFT,
+  BINDING_DPAD_RIGHT,
+  BINDING_START,
+  BINDING_BACK,
+  BINDING_LEFT_THUMB,
+  BINDING_RIGHT_THUMB,
+  BINDING_LEFT_SHOULDER,
+  BINDING_RIGHT_SHOULDER,
+  BINDING_A,
+  BINDING_B,
+  BINDING_X,
+  BINDING_Y,
+
+  BINDING_COUNT,
+  BINDING_FIRST_KEYBOARD = BINDING_DPAD_UP
+};
+
+// Per-frame state of one binding.
+struct Binding
+{
+  bool isDown;      // The buttons became held this frame.
+  bool isUp;        // The buttons were released this frame.
+};
+
+static const size_t MAX_SEQUENCE_STEPS = 4;
+
+// Chords pressed one after the other to trigger a binding, like pressing START twice.
+struct BindingSequence
+{
+  WORD steps[MAX_SEQUENCE_STEPS];   // Buttons of every step. The last step is the binding's mask.
+  DWORD count;                      // Number of steps. 0 for bindings that are a single chord.
+};
+
+// One bit per BindingId.
+typedef DWORD BindingSet;
+static_assert(BINDING_COUNT <= 32, "BindingSet has one bit per binding");
+
+// Flat table of all button bindings, indexed by BindingId. Built once from the config file and
+// not changed afterwards, so every pad reads the table of the profile in use; what a pad
+// pressed is kept in its own BindingState.
+//
+// Binding the table compiles it into bit sets: the bindings that use each button, and for
+// every chord the larger chords that contain it. A frame then finds every held chord by
+// walking the at most 16 released buttons, not the bindings, and only touches the bindings
+// that are held or changed. While a chord is held, the chords it contains are suppressed until
+// their own buttons are released, so START+BACK does not also trigger START. Sequences take
+// no part in suppression.
+class BindingTable
+{
+private:
+  WORD _masks[BINDING_COUNT];           // Controller buttons that must all be held. 0 when the binding is unused.
+  BindingSequence _sequences[BINDING_COUNT];
+  LONGLONG _sequenceWindow;             // Longest time between two steps of a sequence.
+
+  // Compiled from the masks by compile()
+  BindingSet _usingButton[16];          // Bindings whose mask includes each button.
+  BindingSet _supersets[BINDING_COUNT]; // Chords that contain every button of a chord and more.
+  BindingSet _bound;                    // Bindings with a mask.
+  BindingSet _withSupersets;            // Chords that some larger chord contains.
+  BindingSet _sequenceBindings;         // Bindings that are sequences.
+  WORD _usedButtons;                    // Buttons used by any binding.
+
+  friend class BindingState;
+
+public:
+  BindingTable();
+
+  void clear();
+
+  void bind(BindingId id, WORD mask);
+
+  void bindSequence(BindingId id, const WORD *steps, size_t count);
+
+  void setSequenceWindow(LONGLONG ticks);
+
+  // Description:
+  //   Gets the controller buttons that must all be held for a binding, 0 when it is unused.
+  WORD getMask(BindingId id) const
+  {
+    return _masks[id];
+  }
+
+  const BindingSequence &sequence(BindingId id) const
+  {
+    return _sequences[id];
+  }
+
+private:
+  void compile();
+};
+
+// What one pad pressed of the bindings of a BindingTable, updated once per frame from the
+// current and previous button words.
+class BindingState
+{
+private:
+  // How far a pad got through a sequence.
+  struct SequenceProgress
+  {
+    DWORD progress;                     // Steps pressed so far.
+    LONGLONG stepTime;                  // Timestamp of the last step pressed.
+  };
+
+  Binding _bindings[BINDING_COUNT];
+  SequenceProgress _sequences[BINDING_COUNT];
+  BindingSet _active;                   // Bindings held and not suppressed.
+  BindingSet _suppressed;               // Held chords overridden by a larger chord.
+  BindingSet _edges;                    // Bindings pressed or released last frame.
+
+public:
+  BindingState();
+
+  void reset();
+
+  void update(const BindingTable &table, WORD buttons, WORD previousButtons, LONGLONG now);
+
+  const Binding &operator[](BindingId id) const
+  {
+    return _bindings[id];
+  }
+
+private:
+  bool advanceSequence(const BindingTable &table, DWORD id, WORD buttons, WORD previousButtons, LONGLONG now);
+};
@@ -1,37 +1,38 @@
 #include "CXBOXController.h"
 
 CXBOXController::CXBOXController(int playerNumber)
+  : _lastResult(ERROR_DEVICE_NOT_CONNECTED)
+  , _haptics(playerNumber - 1)
 {
   _controllerNum = playerNumber - 1; //set number
 }
 
 XINPUT_STATE CXBOXController::GetState()
 {
-  ZeroMemory(&this->_controllerState, sizeof(XINPUT_STATE));
-  XInputGetState(_controllerNum, &this->_controllerState);
+  Poll(this->_controllerState);
   return _controllerState;
 }
 
-bool CXBOXController::IsConnected()
+DWORD CXBOXController::Poll(XINPUT_STATE &state)
 {
-  ZeroMemory(&this->_controllerState, sizeof(XINPUT_STATE));
-  DWORD Result = XInputGetState(_controllerNum, &this->_controllerState);
-
-  return (Result == ERROR_SUCCESS);
+  ZeroMemory(&state, sizeof(XINPUT_STATE));
+  _lastResult = XInputGetState(_controllerNum, &state);
+  return _lastResult;
 }
 
-void CXBOXController::Vibrate(int leftVal, int rightVal)
+bool CXBOXController::IsConnected()
 {
-  // Create a Vibraton State
-  XINPUT_VIBRATION Vibration;
-
-  // Zeroise the Vibration
-  ZeroMemory(&Vibration, sizeof(XINPUT_VIBRATION));
+  // Reuse the result of the last read instead of querying XInput again.
+  return (_lastResult == ERROR_SUCCESS);
+}
 
-  // Set the Vibration Values
-  Vibration.wLeftMotorSpeed = leftVal;
-  Vibration.wRightMotorSpeed = rightVal;
+void CXBOXController::Vibrate(const HapticEffect &effect)
+{
+  // Queue the effect; the haptics engine drives the motors off the caller's thread.
+  _haptics.play(effect);
+}
 
-  // Vibrate the controller
-  XInputSetState(_controllerNum, &Vibration);
-}
\ No newline at end of file
+void CXBOXController::StopVibration()
+{
+  _haptics.cancel();
+}
@@ -3,14 +3,21 @@
 #include <windows.h>
 #include <xinput.h>
 
-class CXBOXController
+#include "Haptics.h"
+#include "IController.h"
+
+class CXBOXController : public IController
 {
 private:
   XINPUT_STATE _controllerState;
   int _controllerNum;
+  DWORD _lastResult;  // Return code of the last XInputGetState call.
+  HapticsEngine _haptics;
 public:
   CXBOXController(int playerNumber);
   XINPUT_STATE GetState();
-  bool IsConnected();
-  void Vibrate(int leftVal, int rightVal);
+  DWORD Poll(XINPUT_STATE &state) override;
+  bool IsConnected() override;
+  void Vibrate(const HapticEffect &effect) override;
+  void StopVibration() override;
 };
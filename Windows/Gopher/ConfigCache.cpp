@@ -0,0 +1,290 @@
+#include "ConfigCache.h"
+
+#include <algorithm>
+
+static void chordToCache(const KeyChord &chord, ConfigCacheData::Chord &cached)
+{
+  cached.count = 0;
+  for (const WORD key : chord)
+  {
+    cached.keys[cached.count++] = key;
+  }
+}
+
+static KeyChord chordFromCache(const ConfigCacheData::Chord &cached)
+{
+  KeyChord chord;
+  for (DWORD i = 0; i < cached.count && i < CHORD_CAPACITY; ++i)
+  {
+    chord.push_back(cached.keys[i]);
+  }
+  return chord;
+}
+
+static bool curveToCache(const std::vector<CurvePoint> &points, DWORD &count, CurvePoint *cached)
+{
+  if (points.size() > ConfigCacheData::MAX_CURVE_POINTS)
+  {
+    return false;
+  }
+
+  count = (DWORD)points.size();
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    cached[i] = points[i];
+  }
+  return true;
+}
+
+// Description:
+//   Reads the last write time and size of a file from its directory entry.
+//
+// Params:
+//   path   The file
+//   stamp  Receives the stamp
+//
+// Returns:
+//   true if the file exists.
+bool getConfigStamp(const std::string &path, ConfigStamp &stamp)
+{
+  WIN32_FILE_ATTRIBUTE_DATA attributes;
+  if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes))
+  {
+    return false;
+  }
+
+  stamp.writeTime = ((ULONGLONG)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+  stamp.size = ((ULONGLONG)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+  return true;
+}
+
+// Description:
+//   Maps a config cache and copies it into a config, if it was built from the given version of
+//     the config file.
+//
+// Params:
+//   cachePath  The cache file
+//   source     Stamp of the config file as it is now
+//   config     Receives the cached settings. Left untouched if the cache is not used.
+//
+// Returns:
+//   true if the cache was valid and used.
+bool readConfigCache(const std::string &cachePath, const ConfigStamp &source, GopherConfig &config)
+{
+  HANDLE file = CreateFileA(cachePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  HANDLE mapping = NULL;
+  if (GetFileSizeEx(file, &size) && size.QuadPart == sizeof(ConfigCacheData))
+  {
+    mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  }
+  CloseHandle(file);
+  if (mapping == NULL)
+  {
+    return false;
+  }
+
+  const ConfigCacheData *data = (const ConfigCacheData*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(ConfigCacheData));
+  CloseHandle(mapping);
+  if (data == NULL)
+  {
+    return false;
+  }
+
+  bool valid = data->magic == ConfigCacheData::MAGIC
+    && data->version == ConfigCacheData::VERSION
+    && data->source.writeTime == source.writeTime
+    && data->source.size == source.size
+    && data->speedCount > 0 && data->speedCount <= ConfigCacheData::MAX_SPEEDS
+    && data->cursorCurveCount <= ConfigCacheData::MAX_CURVE_POINTS
+    && data->scrollCurveCount <= ConfigCacheData::MAX_CURVE_POINTS
+    && data->triggerCurveCount <= ConfigCacheData::MAX_CURVE_POINTS;
+
+  if (valid)
+  {
+    config.DEAD_ZONE = data->DEAD_ZONE;
+    config.SCROLL_DEAD_ZONE = data->SCROLL_DEAD_ZONE;
+    config.TRIGGER_DEAD_ZONE = data->TRIGGER_DEAD_ZONE;
+    config.TRIGGER_RELEASE_ZONE = data->TRIGGER_RELEASE_ZONE;
+    config.TRIGGER_LEFT_MODE = data->TRIGGER_LEFT_MODE;
+    config.TRIGGER_RIGHT_MODE = data->TRIGGER_RIGHT_MODE;
+    config.TRIGGER_CURSOR_SPEED = data->TRIGGER_CURSOR_SPEED;
+    config.SCROLL_SPEED = data->SCROLL_SPEED;
+    config.SCROLL_NOTCHED = data->SCROLL_NOTCHED;
+    config.FPS = data->FPS;
+    config.IDLE_FPS = data->IDLE_FPS;
+    config.IDLE_TIMEOUT = data->IDLE_TIMEOUT;
+    config.SEQUENCE_TIME = data->SEQUENCE_TIME;
+    config.HOLD_TIME = data->HOLD_TIME;
+    config.DOUBLE_TAP_TIME = data->DOUBLE_TAP_TIME;
+    config.TURBO_RATE = data->TURBO_RATE;
+    config.TURBO_BUTTONS = data->TURBO_BUTTONS;
+    config.SWAP_THUMBSTICKS = data->SWAP_THUMBSTICKS;
+    config.CURSOR_MODE = data->CURSOR_MODE;
+    config.CURSOR_NOCOALESCE = data->CURSOR_NOCOALESCE;
+    config.FILTER_MIN_CUTOFF = data->FILTER_MIN_CUTOFF;
+    config.FILTER_BETA = data->FILTER_BETA;
+    config.STICK_CALIBRATION = data->STICK_CALIBRATION;
+    config.TRACE_FILE.assign(data->TRACE_FILE, strnlen(data->TRACE_FILE, MAX_PATH));
+    config.TRACE_SIZE = (SIZE_T)data->TRACE_SIZE;
+    config.LOG_LEVEL = data->LOG_LEVEL;
+    config.LOG_FILE.assign(data->LOG_FILE, strnlen(data->LOG_FILE, MAX_PATH));
+    config.LOG_ETW = data->LOG_ETW;
+    config.PROCESS_PRIORITY = data->PROCESS_PRIORITY;
+    config.MMCSS_TASK.assign(data->MMCSS_TASK, strnlen(data->MMCSS_TASK, ConfigCacheData::MAX_MMCSS_TASK));
+    config.POLL_AFFINITY = data->POLL_AFFINITY;
+    config.LOOP_AFFINITY = data->LOOP_AFFINITY;
+    config.NO_POWER_THROTTLING = data->NO_POWER_THROTTLING;
+
+    config.acceleration_factor = data->acceleration_factor;
+    config.speeds.assign(data->speeds, data->speeds + data->speedCount);
+    config.speed_names.clear();
+    for (DWORD i = 0; i < data->speedCount; ++i)
+    {
+      config.speed_names.push_back(std::string(data->speedNames[i], strnlen(data->speedNames[i], ConfigCacheData::MAX_SPEED_NAME)));
+    }
+
+    config.cursorCurvePoints.assign(data->cursorCurve, data->cursorCurve + data->cursorCurveCount);
+    config.scrollCurvePoints.assign(data->scrollCurve, data->scrollCurve + data->scrollCurveCount);
+    config.triggerCurvePoints.assign(data->triggerCurve, data->triggerCurve + data->triggerCurveCount);
+
+    config.bindings.clear();
+    for (int id = 0; id < BINDING_COUNT; ++id)
+    {
+      config.bindings.bindSequence((BindingId)id, data->bindingSteps[id], (std::min)(data->bindingStepCounts[id], (DWORD)MAX_SEQUENCE_STEPS));
+      config.bindingKeys[id] = chordFromCache(data->bindingKeys[id]);
+      config.holdKeys[id] = chordFromCache(data->holdKeys[id]);
+      config.doubleKeys[id] = chordFromCache(data->doubleKeys[id]);
+    }
+    config.GAMEPAD_TRIGGER_LEFT = chordFromCache(data->GAMEPAD_TRIGGER_LEFT);
+    config.GAMEPAD_TRIGGER_RIGHT = chordFromCache(data->GAMEPAD_TRIGGER_RIGHT);
+    config.setSequenceWindow();
+  }
+
+  UnmapViewOfFile(data);
+  return valid;
+}
+
+// Description:
+//   Stores a parsed config as the cache of a config file. The cache is written next to the old
+//     one and then moved over it, so a reader never maps a half-written cache.
+//
+// Params:
+//   cachePath  The cache file
+//   source     Stamp the config file had before it was parsed
+//   config     The parsed settings
+//
+// Returns:
+//   true if the cache was written, false if the config does not fit the cache or writing failed.
+bool writeConfigCache(const std::string &cachePath, const ConfigStamp &source, const GopherConfig &config)
+{
+  if (config.speeds.size() > ConfigCacheData::MAX_SPEEDS || config.TRACE_FILE.size() >= MAX_PATH || config.LOG_FILE.size() >= MAX_PATH
+    || config.MMCSS_TASK.size() >= ConfigCacheData::MAX_MMCSS_TASK)
+  {
+    return false;
+  }
+
+  ConfigCacheData data;
+  ZeroMemory(&data, sizeof(data));
+  data.magic = ConfigCacheData::MAGIC;
+  data.version = ConfigCacheData::VERSION;
+  data.source = source;
+
+  data.DEAD_ZONE = config.DEAD_ZONE;
+  data.SCROLL_DEAD_ZONE = config.SCROLL_DEAD_ZONE;
+  data.TRIGGER_DEAD_ZONE = config.TRIGGER_DEAD_ZONE;
+  data.TRIGGER_RELEASE_ZONE = config.TRIGGER_RELEASE_ZONE;
+  data.TRIGGER_LEFT_MODE = config.TRIGGER_LEFT_MODE;
+  data.TRIGGER_RIGHT_MODE = config.TRIGGER_RIGHT_MODE;
+  data.TRIGGER_CURSOR_SPEED = config.TRIGGER_CURSOR_SPEED;
+  data.SCROLL_SPEED = config.SCROLL_SPEED;
+  data.SCROLL_NOTCHED = config.SCROLL_NOTCHED;
+  data.FPS = config.FPS;
+  data.IDLE_FPS = config.IDLE_FPS;
+  data.IDLE_TIMEOUT = config.IDLE_TIMEOUT;
+  data.SEQUENCE_TIME = config.SEQUENCE_TIME;
+  data.HOLD_TIME = config.HOLD_TIME;
+  data.DOUBLE_TAP_TIME = config.DOUBLE_TAP_TIME;
+  data.TURBO_RATE = config.TURBO_RATE;
+  data.TURBO_BUTTONS = config.TURBO_BUTTONS;
+  data.SWAP_THUMBSTICKS = config.SWAP_THUMBSTICKS;
+  data.CURSOR_MODE = config.CURSOR_MODE;
+  data.CURSOR_NOCOALESCE = config.CURSOR_NOCOALESCE;
+  data.FILTER_MIN_CUTOFF = config.FILTER_MIN_CUTOFF;
+  data.FILTER_BETA = config.FILTER_BETA;
+  data.STICK_CALIBRATION = config.STICK_CALIBRATION;
+  memcpy(data.TRACE_FILE, config.TRACE_FILE.c_str(), config.TRACE_FILE.size());
+  data.TRACE_SIZE = config.TRACE_SIZE;
+  data.LOG_LEVEL = config.LOG_LEVEL;
+  memcpy(data.LOG_FILE, config.LOG_FILE.c_str(), config.LOG_FILE.size());
+  data.LOG_ETW = config.LOG_ETW;
+  data.PROCESS_PRIORITY = config.PROCESS_PRIORITY;
+  memcpy(data.MMCSS_TASK, config.MMCSS_TASK.c_str(), config.MMCSS_TASK.size());
+  data.POLL_AFFINITY = config.POLL_AFFINITY;
+  data.LOOP_AFFINITY = config.LOOP_AFFINITY;
+  data.NO_POWER_THROTTLING = config.NO_POWER_THROTTLING;
+
+  data.acceleration_factor = config.acceleration_factor;
+  data.speedCount = (DWORD)config.speeds.size();
+  for (size_t i = 0; i < config.speeds.size(); ++i)
+  {
+    const std::string &name = config.speed_names[i];
+    if (name.size() >= ConfigCacheData::MAX_SPEED_NAME)
+    {
+      return false;
+    }
+    data.speeds[i] = config.speeds[i];
+    memcpy(data.speedNames[i], name.c_str(), name.size());
+  }
+
+  if (!curveToCache(config.cursorCurvePoints, data.cursorCurveCount, data.cursorCurve)
+    || !curveToCache(config.scrollCurvePoints, data.scrollCurveCount, data.scrollCurve)
+    || !curveToCache(config.triggerCurvePoints, data.triggerCurveCount, data.triggerCurve))
+  {
+    return false;
+  }
+
+  for (int id = 0; id < BINDING_COUNT; ++id)
+  {
+    const BindingSequence &sequence = config.bindings.sequence((BindingId)id);
+    if (sequence.count > 0)
+    {
+      data.bindingStepCounts[id] = sequence.count;
+      memcpy(data.bindingSteps[id], sequence.steps, sizeof(sequence.steps));
+    }
+    else
+    {
+      data.bindingStepCounts[id] = 1;
+      data.bindingSteps[id][0] = config.bindings.getMask((BindingId)id);
+    }
+    chordToCache(config.bindingKeys[id], data.bindingKeys[id]);
+    chordToCache(config.holdKeys[id], data.holdKeys[id]);
+    chordToCache(config.doubleKeys[id], data.doubleKeys[id]);
+  }
+  chordToCache(config.GAMEPAD_TRIGGER_LEFT, data.GAMEPAD_TRIGGER_LEFT);
+  chordToCache(config.GAMEPAD_TRIGGER_RIGHT, data.GAMEPAD_TRIGGER_RIGHT);
+
+  const std::string tempPath = cachePath + ".tmp";
+  HANDLE file = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  DWORD written = 0;
+  BOOL ok = WriteFile(file, &data, sizeof(data), &written, NULL) && written == sizeof(data);
+  CloseHandle(file);
+
+  if (!ok || !MoveFileExA(tempPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+  {
+    DeleteFileA(tempPath.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+
+#include "GopherConfig.h"
+
+// Identifies one version of a config file without reading it.
+struct ConfigStamp
+{
+  ULONGLONG writeTime;  // Last write time as a FILETIME.
+  ULONGLONG size;       // File size in bytes.
+};
+
+// Parsed config stored next to config.ini, so startup maps one small file instead of parsing
+// text. The layout is fixed-size so the mapped file is validated by its size and used in place;
+// configs that do not fit the limits below are simply never cached.
+struct ConfigCacheData
+{
+  static const DWORD MAGIC = 0x43433347;  // "G3CC"
+  static const DWORD VERSION = 11;
+
+  static const size_t MAX_SPEEDS = 16;
+  static const size_t MAX_SPEED_NAME = 32;
+  static const size_t MAX_CURVE_POINTS = 32;
+  static const size_t MAX_MMCSS_TASK = 64;
+
+  struct Chord
+  {
+    DWORD count;
+    WORD keys[CHORD_CAPACITY];
+  };
+
+  DWORD magic;
+  DWORD version;
+  ConfigStamp source;         // The config file the data was parsed from.
+
+  LONG DEAD_ZONE;
+  LONG SCROLL_DEAD_ZONE;
+  LONG TRIGGER_DEAD_ZONE;
+  LONG TRIGGER_RELEASE_ZONE;
+  LONG TRIGGER_LEFT_MODE;
+  LONG TRIGGER_RIGHT_MODE;
+  float TRIGGER_CURSOR_SPEED;
+  float SCROLL_SPEED;
+  LONG SCROLL_NOTCHED;
+  LONG FPS;
+  LONG IDLE_FPS;
+  LONG IDLE_TIMEOUT;
+  LONG SEQUENCE_TIME;
+  LONG HOLD_TIME;
+  LONG DOUBLE_TAP_TIME;
+  LONG TURBO_RATE;
+  WORD TURBO_BUTTONS;
+  LONG SWAP_THUMBSTICKS;
+  LONG CURSOR_MODE;
+  LONG CURSOR_NOCOALESCE;
+  float FILTER_MIN_CUTOFF;
+  float FILTER_BETA;
+  LONG STICK_CALIBRATION;
+  char TRACE_FILE[MAX_PATH];
+  ULONGLONG TRACE_SIZE;
+  LONG LOG_LEVEL;
+  char LOG_FILE[MAX_PATH];
+  LONG LOG_ETW;
+  LONG PROCESS_PRIORITY;
+  char MMCSS_TASK[MAX_MMCSS_TASK];
+  DWORD POLL_AFFINITY;
+  DWORD LOOP_AFFINITY;
+  LONG NO_POWER_THROTTLING;
+
+  float acceleration_factor;
+  DWORD speedCount;
+  float speeds[MAX_SPEEDS];
+  char speedNames[MAX_SPEEDS][MAX_SPEED_NAME];
+
+  DWORD cursorCurveCount;
+  CurvePoint cursorCurve[MAX_CURVE_POINTS];
+  DWORD scrollCurveCount;
+  CurvePoint scrollCurve[MAX_CURVE_POINTS];
+  DWORD triggerCurveCount;
+  CurvePoint triggerCurve[MAX_CURVE_POINTS];
+
+  WORD bindingSteps[BINDING_COUNT][MAX_SEQUENCE_STEPS];  // Chords of every binding. A single chord is one step.
+  DWORD bindingStepCounts[BINDING_COUNT];
+  Chord bindingKeys[BINDING_COUNT];
+  Chord holdKeys[BINDING_COUNT];
+  Chord doubleKeys[BINDING_COUNT];
+  Chord GAMEPAD_TRIGGER_LEFT;
+  Chord GAMEPAD_TRIGGER_RIGHT;
+};
+
+bool getConfigStamp(const std::string &path, ConfigStamp &stamp);
+
+bool readConfigCache(const std::string &cachePath, const ConfigStamp &source, GopherConfig &config);
+
+bool writeConfigCache(const std::string &cachePath, const ConfigStamp &source, const GopherConfig &config);
@@ -1,204 +1,487 @@
 #include "ConfigFile.h"
-#include <iostream>
-#include <fstream> 
-#include <sstream>
-#include <vector>
-#include <windows.h>
+#include "Log.h"
 
-void ConfigFile::removeComment(std::string &line) const
+#include <charconv>
+#include <climits>
+#include <fstream>
+#include <stdio.h>
+
+static const char WHITESPACE[] = " \t\r";
+static const std::string_view UTF8_BOM = "\xEF\xBB\xBF";
+
+static std::string_view trim(std::string_view text)
 {
-  if (line.find('#') != line.npos)
+  size_t first = text.find_first_not_of(WHITESPACE);
+  if (first == text.npos)
   {
-    line.erase(line.find('#'));
+    return std::string_view();
   }
+  return text.substr(first, text.find_last_not_of(WHITESPACE) - first + 1);
 }
 
-bool ConfigFile::onlyWhitespace(const std::string &line) const
+// Description:
+//   Reads a config file. A default file is written first if it does not exist and
+//     createDefault is set.
+//
+// Params:
+//   fileName       The config file to read
+//   createDefault  Whether to write the default config when the file cannot be read
+ConfigFile::ConfigFile(const std::string &fileName, bool createDefault)
+  : _fileName(fileName)
+  , _loaded(false)
 {
-  return (line.find_first_not_of(' ') == line.npos);
+  if (!readFile())
+  {
+    if (!createDefault)
+    {
+      addDiagnostic(0, "Couldn't read " + _fileName);
+      return;
+    }
+
+    logMessage(LOG_INFO, "%s not found! Building a fresh one...\n", _fileName.c_str());
+    writeDefault();
+
+    if (!readFile())
+    {
+      addDiagnostic(0, "Configuration file " + _fileName + " still couldn't be found!");
+      return;
+    }
+    logMessage(LOG_INFO, "Now using %s.\n", _fileName.c_str());
+  }
+
+  _loaded = true;
+  parse();
 }
 
-bool ConfigFile::validLine(const std::string &line) const
+// Description:
+//   Reads the whole file into the text buffer.
+//
+// Returns:
+//   true if the file was read.
+bool ConfigFile::readFile()
 {
-  std::string temp = line;
-  temp.erase(0, temp.find_first_not_of("\t "));
-  if (temp[0] == '=')
+  std::ifstream file(_fileName, std::ios::binary | std::ios::ate);
+  if (!file)
   {
     return false;
   }
 
-  for (size_t i = temp.find('=') + 1; i < temp.length(); i++)
+  std::streamoff size = file.tellg();
+  if (size < 0)
   {
-    if (temp[i] != ' ')
-    {
-      return true;
-    }
+    return false;
   }
 
-  return false;
+  _text.resize((size_t)size);
+  file.seekg(0);
+  return (bool)file.read(&_text[0], size);
 }
 
-void ConfigFile::extractKey(std::string &key, size_t const &sepPos, const std::string &line) const
+// Description:
+//   Writes the default configuration to the config file.
+void ConfigFile::writeDefault() const
 {
-  key = line.substr(0, sepPos);
-  if (key.find('\t') != line.npos || key.find(' ') != line.npos)
+  // Lines end in '\n' rather than std::endl, so the file is written in one go when it is closed.
+  std::ofstream outfile(_fileName);
+
+  // Begin config dump to file
+  outfile << "#	GOPHER DEFAULT CONFIGURATION rev1.0 - Auto generated by Gopher360." << '\n';
+  outfile << "#	If you want a fresh one, just DELETE THIS FILE and re-run Gopher360." << '\n';
+  outfile << "#	Set which controller buttons will activate the configuration events." << '\n';
+  outfile << "#	SET 0 FOR NO FUNCTION." << '\n';
+  outfile << "#	AVAILABLE VALUES AT https://msdn.microsoft.com/en-us/library/windows/desktop/microsoft.directx_sdk.reference.xinput_gamepad(v=vs.85).aspx" << '\n';
+  outfile << "#	TIP: Sum the hex value for double button shortcuts eg. 0x0010(START) 0x0020(BACK) so 0x0030(START+BACK) will trigger the event only when both are pressed." << '\n';
+  outfile << "#	While a shortcut is held, shortcuts made of some of its buttons are ignored, so START+BACK does not also press START." << '\n';
+  outfile << "#	Separate values with | for a sequence eg. 0x0010|0x0010 will trigger the event when START is pressed twice within SEQUENCE_TIME." << '\n';
+  outfile << "\n\n";
+  outfile << "CONFIG_MOUSE_LEFT = 0x1000	# Left mouse button" << '\n';
+  outfile << "CONFIG_MOUSE_RIGHT = 0x4000	# Right mouse button" << '\n';
+  outfile << "CONFIG_MOUSE_MIDDLE = 0x0040	# Middle mouse button" << '\n';
+  outfile << "CONFIG_HIDE = 0x8000		# Hides the terminal" << '\n';
+  outfile << "CONFIG_DISABLE = 0x0030		# Disables the Gopher" << '\n';
+  outfile << "CONFIG_DISABLE_VIBRATION = 0x0011 # Disables Gopher Vibrations" << '\n';
+  outfile << "CONFIG_SPEED_CHANGE =  0x0300	# Change speed" << '\n';
+  outfile << "#CONFIG_OSK = 0x0020   # Toggle on-screen keyboard" << '\n';
+  outfile << "\n\n";
+  outfile << "#	KEYBOARD SHORTCUTS ON CONTROLLER BUTTONS" << '\n';
+  outfile << "#	SET 0 FOR NO FUNCTION" << '\n';
+  outfile << "#	AVAILABLE VALUES AT> https://msdn.microsoft.com/en-us/library/windows/desktop/dd375731" << '\n';
+  outfile << "\n\n";
+  outfile << "GAMEPAD_DPAD_UP = 0x26" << '\n';
+  outfile << "GAMEPAD_DPAD_DOWN = 0x28" << '\n';
+  outfile << "GAMEPAD_DPAD_LEFT = 0x25" << '\n';
+  outfile << "GAMEPAD_DPAD_RIGHT = 0x27" << '\n';
+  outfile << "GAMEPAD_START = 0x5B" << '\n';
+  outfile << "GAMEPAD_BACK = 0xA8" << '\n';
+  outfile << "GAMEPAD_LEFT_THUMB = 0" << '\n';
+  outfile << "GAMEPAD_RIGHT_THUMB = 0x71" << '\n';
+  outfile << "GAMEPAD_LEFT_SHOULDER = 0" << '\n';
+  outfile << "GAMEPAD_RIGHT_SHOULDER = 0" << '\n';
+  outfile << "GAMEPAD_A = 0" << '\n';
+  outfile << "GAMEPAD_B = 0x0D" << '\n';
+  outfile << "GAMEPAD_X = 0" << '\n';
+  outfile << "GAMEPAD_Y = 0" << '\n';
+  outfile << "GAMEPAD_TRIGGER_LEFT = 0" << '\n';
+  outfile << "GAMEPAD_TRIGGER_RIGHT = 0" << '\n';
+  outfile << "\n\n";
+  outfile << "# ADVANCED CONFIGURATION SETTINGS" << '\n';
+  outfile << "#  ALLOWED CURSOR SPEEDS, FIRST WILL BE CHOSEN BY DEFAULT.  VALUES > 1.0 WILL BE IGNORED.  NO SPACES." << '\n';
+  outfile << "CURSOR_SPEED = ULTRALOW=0.005,LOW=0.015,MED=0.025,HIGH=0.04" << '\n';
+  outfile << "#  SET ACCELERATION FACTOR FOR NON-LINEAR CURSOR SPEED" << '\n';
+  outfile << "# ACCELERATION_FACTOR = 3" << '\n';
+  outfile << "#  OPTIONAL CUSTOM CURVES AS INPUT:OUTPUT POINTS FROM THE DEAD ZONE (0) TO FULL DEFLECTION (1). REPLACES ACCELERATION_FACTOR. NO SPACES." << '\n';
+  outfile << "# CURSOR_CURVE = 0:0,0.5:0.15,1:1" << '\n';
+  outfile << "# SCROLL_CURVE = 0:0,1:1" << '\n';
+  outfile << "#  Set to 1 to scroll in whole notches like a notched mouse wheel, for programs that ignore smooth scrolling. 0 scrolls smoothly." << '\n';
+  outfile << "SCROLL_NOTCHED = 0" << '\n';
+  outfile << "#  Trigger value from 0 to 255 above which a trigger is pressed, and at or below which a pressed trigger is released again." << '\n';
+  outfile << "#  A release value below the press value stops a trigger held near the threshold from pressing its keys over and over." << '\n';
+  outfile << "TRIGGER_DEAD_ZONE = 30" << '\n';
+  outfile << "TRIGGER_RELEASE_ZONE = 20" << '\n';
+  outfile << "#  Continuous use of each trigger besides its keys. 0 for none, 1 to scroll (left up, right down) as fast as the scroll stick, 2 to scale the cursor speed towards TRIGGER_CURSOR_SPEED." << '\n';
+  outfile << "TRIGGER_LEFT_MODE = 0" << '\n';
+  outfile << "TRIGGER_RIGHT_MODE = 0" << '\n';
+  outfile << "#  Cursor speed multiplier of a fully pressed trigger in mode 2. Below 1 for a precision mode, above 1 for a boost." << '\n';
+  outfile << "TRIGGER_CURSOR_SPEED = 0.25" << '\n';
+  outfile << "#  Optional custom curve for the trigger outputs, like CURSOR_CURVE." << '\n';
+  outfile << "# TRIGGER_CURVE = 0:0,1:1" << '\n';
+  outfile << "#  Swaps the function of the thumbsticks. Set to 0 for default behavior or set to 1 to have the mouse movement on the right stick and scrolling on the left stick." << '\n';
+  outfile << "SWAP_THUMBSTICKS = 0" << '\n';
+  outfile << "#  Cursor output. 0 positions the cursor directly (default). 1 sends relative mouse motion like a real mouse, which works in games using raw input but follows the Windows pointer speed settings." << '\n';
+  outfile << "CURSOR_MODE = 0" << '\n';
+  outfile << "#  Set to 1 to stop Windows from merging relative mouse motion events. Only used with CURSOR_MODE = 1." << '\n';
+  outfile << "CURSOR_NOCOALESCE = 0" << '\n';
+  outfile << "#  Smoothing of worn or wireless sticks that jitter at rest. 0 disables it. Otherwise the smoothing frequency in Hz of a resting stick; lower is smoother, 1 is a good start." << '\n';
+  outfile << "#  FILTER_BETA sets how quickly the smoothing fades out as the stick moves faster. Raise it if fast moves lag, lower it if slow moves still jitter." << '\n';
+  outfile << "FILTER_MIN_CUTOFF = 0" << '\n';
+  outfile << "FILTER_BETA = 5" << '\n';
+  outfile << "#  Set to 1 to measure where the sticks of each controller rest and how much they wander there. The measurements center worn sticks and are kept in gopher.state." << '\n';
+  outfile << "#  Traces record the sticks as read, so GopherBench replays them without the measurements." << '\n';
+  outfile << "STICK_CALIBRATION = 0" << '\n';
+  outfile << "#  Number of times per second the controller is read. Defaults to 150." << '\n';
+  outfile << "FPS = 150" << '\n';
+  outfile << "#  Number of times per second the controller is read after IDLE_TIMEOUT milliseconds without input." << '\n';
+  outfile << "IDLE_FPS = 10" << '\n';
+  outfile << "IDLE_TIMEOUT = 5000" << '\n';
+  outfile << "#  Milliseconds allowed between two presses of a button sequence. Defaults to 300." << '\n';
+  outfile << "SEQUENCE_TIME = 300" << '\n';
+  outfile << "#  Keys sent when a button is held for HOLD_TIME milliseconds, or tapped twice within DOUBLE_TAP_TIME. Set like the keyboard shortcuts with _HOLD or _DOUBLE added to the name." << '\n';
+  outfile << "#  A button with either of them sends its own keys as a tap when it is released, or once DOUBLE_TAP_TIME has passed." << '\n';
+  outfile << "# GAMEPAD_A_HOLD = 0x1B" << '\n';
+  outfile << "# GAMEPAD_A_DOUBLE = 0x0D" << '\n';
+  outfile << "HOLD_TIME = 500" << '\n';
+  outfile << "DOUBLE_TAP_TIME = 250" << '\n';
+  outfile << "#  Buttons whose keys repeat TURBO_RATE times per second while held. Sum the hex values of the buttons like the shortcuts." << '\n';
+  outfile << "TURBO_BUTTONS = 0" << '\n';
+  outfile << "TURBO_RATE = 10" << '\n';
+  outfile << "#  File to record every controller state and generated input to, for offline analysis. 0 to disable." << '\n';
+  outfile << "TRACE_FILE = 0" << '\n';
+  outfile << "#  Space preallocated for the trace in megabytes, from 1 to 256. Recording stops when it is full." << '\n';
+  outfile << "TRACE_SIZE = 64" << '\n';
+  outfile << "#  Lowest level of the messages logged: 0 debug, 1 info, 2 warning, 3 error." << '\n';
+  outfile << "LOG_LEVEL = 1" << '\n';
+  outfile << "#  File messages are appended to, with their time and level. 0 to disable." << '\n';
+  outfile << "LOG_FILE = 0" << '\n';
+  outfile << "#  Set to 1 to also write messages as ETW events of the Gopher360 provider, GUID {5B2E7C19-8D43-4A6F-9E07-C3D1F4A8B265}." << '\n';
+  outfile << "LOG_ETW = 0" << '\n';
+  outfile << "#  Priority class of Gopher: 0 normal, 1 above normal, 2 high. Raise it if the cursor stutters while other programs keep the CPU busy." << '\n';
+  outfile << "PROCESS_PRIORITY = 0" << '\n';
+  outfile << "#  Multimedia Class Scheduler task the threads reading and sending the input join, such as Games or Pro Audio. 0 for none." << '\n';
+  outfile << "MMCSS_TASK = 0" << '\n';
+  outfile << "#  Cores the controller polling thread and the thread sending the input may run on. Sum the hex values of the cores: 0x1 for the first, 0x2 for the second, 0x4 for the third... 0 for any." << '\n';
+  outfile << "POLL_AFFINITY = 0" << '\n';
+  outfile << "LOOP_AFFINITY = 0" << '\n';
+  outfile << "#  Set to 1 to keep Windows from running Gopher in power saving mode (EcoQoS) while its window is hidden or in the background." << '\n';
+  outfile << "NO_POWER_THROTTLING = 0" << '\n';
+  outfile << "#  To see whether these settings help, run GopherBench -stats 30 under load with them and again without them, and compare the tick jitter." << '\n';
+  outfile << "\n\n";
+  outfile << "# PER-PROGRAM PROFILES" << '\n';
+  outfile << "#  A copy of this file saved as profiles\\<program>.ini, e.g. profiles\\notepad.exe.ini, is used instead while that program is in the foreground." << '\n';
+  outfile << "#  Profiles are read again whenever this file or one of them is saved. TRACE_FILE, TRACE_SIZE, the LOG_ settings and the scheduling settings from PROCESS_PRIORITY to NO_POWER_THROTTLING are only read from this file." << '\n';
+  // End config dump
+}
+
+// Description:
+//   Splits the text buffer into lines and parses each of them.
+void ConfigFile::parse()
+{
+  std::string_view text(_text);
+  if (text.substr(0, UTF8_BOM.size()) == UTF8_BOM)
   {
-    key.erase(key.find_first_of("\t "));
+    text.remove_prefix(UTF8_BOM.size());
+  }
+
+  size_t lineNo = 0;
+  while (!text.empty())
+  {
+    size_t end = text.find('\n');
+    parseLine(text.substr(0, end), ++lineNo);
+    if (end == text.npos)
+    {
+      break;
+    }
+    text.remove_prefix(end + 1);
   }
 }
-void ConfigFile::extractValues(std::vector<std::string> &values, size_t const &sepPos, const std::string &line) const
+
+// Description:
+//   Parses one line of the file. Comments and blank lines are skipped; anything else must be
+//     KEY = VALUE, with values separated by |.
+//
+// Params:
+//   line     The line, without its line break
+//   lineNo   Line number for diagnostics, starting at 1
+void ConfigFile::parseLine(std::string_view line, size_t lineNo)
 {
-  std::string candidate=line.substr(sepPos + 1);
-  candidate.erase(0, candidate.find_first_not_of("\t "));
-  candidate.erase(candidate.find_last_not_of("\t ") + 1);
+  line = trim(line.substr(0, line.find('#')));
+  if (line.empty())
+  {
+    return;
+  }
 
-  std::stringstream stream(candidate);
-  std::string value;
-  while (std::getline(stream, value, '|')) {
-    values.push_back(value);
+  size_t separator = line.find('=');
+  if (separator == line.npos)
+  {
+    addDiagnostic(lineNo, "Couldn't find separator");
+    return;
+  }
+
+  std::string_view key = trim(line.substr(0, separator));
+  std::string_view value = trim(line.substr(separator + 1));
+  if (key.empty() || value.empty() || key.find_first_of(WHITESPACE) != key.npos)
+  {
+    addDiagnostic(lineNo, "Bad format");
+    return;
+  }
+
+  Entry entry;
+  entry.line = lineNo;
+  for (;;)
+  {
+    size_t bar = value.find('|');
+    entry.values.push_back(trim(value.substr(0, bar)));
+    if (bar == value.npos)
+    {
+      break;
+    }
+    value.remove_prefix(bar + 1);
+  }
+
+  std::pair<std::map<std::string_view, Entry>::iterator, bool> inserted = _contents.emplace(key, std::move(entry));
+  if (!inserted.second)
+  {
+    addDiagnostic(lineNo, std::string(key) + " is already set on line " + std::to_string(inserted.first->second.line) + ", ignoring this one");
   }
 }
 
-void ConfigFile::extractContents(const std::string &line)
+const ConfigFile::Entry *ConfigFile::find(std::string_view key) const
 {
-  std::string temp = line;
-  temp.erase(0, temp.find_first_not_of("\t "));
-  size_t sepPos = temp.find('=');
+  std::map<std::string_view, Entry>::const_iterator it = _contents.find(key);
+  return it == _contents.end() ? NULL : &it->second;
+}
 
-  std::string key;
-  std::vector<std::string> values;
-  extractKey(key, sepPos, temp);
-  extractValues(values, sepPos, temp);
+void ConfigFile::addDiagnostic(size_t line, const std::string &message)
+{
+  ConfigDiagnostic diagnostic;
+  diagnostic.line = line;
+  diagnostic.message = message;
+  _diagnostics.push_back(diagnostic);
+}
 
-  if (!contents.insert({key, values}).second) exitWithError("CFG: Can only have unique key names!\n");
+void ConfigFile::addInvalidValue(const Entry &entry, std::string_view key, std::string_view value, const char *expected)
+{
+  addDiagnostic(entry.line, std::string(key) + ": \"" + std::string(value) + "\" is not " + expected + ", ignoring it");
+}
+
+// Description:
+//   Gets the first value of a key.
+//
+// Params:
+//   key            The key to look up
+//   defaultValue   Returned when the key is not set
+//
+// Returns:
+//   The value. It points into the file buffer and is valid as long as this object.
+std::string_view ConfigFile::getString(std::string_view key, std::string_view defaultValue) const
+{
+  const Entry *entry = find(key);
+  return entry == NULL ? defaultValue : entry->values.front();
 }
 
-void ConfigFile::parseLine(const std::string &line, size_t const lineNo)
+// Description:
+//   Gets the first value of a key as an integer. Decimal, 0x hexadecimal and 0 octal values
+//     are accepted, like strtol.
+//
+// Params:
+//   key            The key to look up
+//   defaultValue   Returned when the key is not set or not an integer
+//
+// Returns:
+//   The value.
+long ConfigFile::getInt(std::string_view key, long defaultValue)
 {
-  if (line.find('=') == line.npos)
+  const Entry *entry = find(key);
+  if (entry == NULL)
   {
-    exitWithError("CFG: Couldn't find separator on line: " + Convert::T_to_string(lineNo) + "\n");
+    return defaultValue;
   }
 
-  if (!validLine(line))
+  long value;
+  if (!parseInt(entry->values.front(), value))
   {
-    exitWithError("CFG: Bad format for line: " + Convert::T_to_string(lineNo) + "\n");
+    addInvalidValue(*entry, key, entry->values.front(), "an integer");
+    return defaultValue;
   }
-
-  extractContents(line);
+  return value;
 }
 
-void ConfigFile::ExtractKeys()
+// Description:
+//   Gets the first value of a key as an integer within a range. Values outside of it are
+//     clamped to the nearest end, with a diagnostic when the value was set in the file.
+//
+// Params:
+//   key            The key to look up
+//   defaultValue   Returned when the key is not set or not an integer, clamped to the range
+//   minimum        The smallest accepted value
+//   maximum        The largest accepted value
+//
+// Returns:
+//   The value.
+long ConfigFile::getInt(std::string_view key, long defaultValue, long minimum, long maximum)
 {
-  std::ifstream file;
-  file.open(fName.c_str());
-
-  if (!file)
+  const long value = getInt(key, defaultValue);
+  if (value >= minimum && value <= maximum)
   {
-    printf("%s not found! Building a fresh one... ", fName.c_str());
-
-    std::ofstream outfile("config.ini");
-
-    // Begin config dump to file
-    outfile << "#	GOPHER DEFAULT CONFIGURATION rev1.0 - Auto generated by Gopher360." << std::endl;
-    outfile << "#	If you want a fresh one, just DELETE THIS FILE and re-run Gopher360." << std::endl;
-    outfile << "#	Set which controller buttons will activate the configuration events." << std::endl;
-    outfile << "#	SET 0 FOR NO FUNCTION." << std::endl;
-    outfile << "#	AVAILABLE VALUES AT https://msdn.microsoft.com/en-us/library/windows/desktop/microsoft.directx_sdk.reference.xinput_gamepad(v=vs.85).aspx" << std::endl;
-    outfile << "#	TIP: Sum the hex value for double button shortcuts eg. 0x0010(START) 0x0020(BACK) so 0x0030(START+BACK) will trigger the event only when both are pressed." << std::endl;
-    outfile << "\n" << std::endl;
-    outfile << "CONFIG_MOUSE_LEFT = 0x1000	# Left mouse button" << std::endl;
-    outfile << "CONFIG_MOUSE_RIGHT = 0x4000	# Right mouse button" << std::endl;
-    outfile << "CONFIG_MOUSE_MIDDLE = 0x0040	# Middle mouse button" << std::endl;
-    outfile << "CONFIG_HIDE = 0x8000		# Hides the terminal" << std::endl;
-    outfile << "CONFIG_DISABLE = 0x0030		# Disables the Gopher" << std::endl;
-    outfile << "CONFIG_DISABLE_VIBRATION = 0x0011 # Disables Gopher Vibrations" << std::endl;
-    outfile << "CONFIG_SPEED_CHANGE =  0x0300	# Change speed" << std::endl;
-    outfile << "#CONFIG_OSK = 0x0020   # Toggle on-screen keyboard" << std::endl;
-    outfile << "\n" << std::endl;
-    outfile << "#	KEYBOARD SHORTCUTS ON CONTROLLER BUTTONS" << std::endl;
-    outfile << "#	SET 0 FOR NO FUNCTION" << std::endl;
-    outfile << "#	AVAILABLE VALUES AT> https://msdn.microsoft.com/en-us/library/windows/desktop/dd375731" << std::endl;
-    outfile << "\n" << std::endl;
-    outfile << "GAMEPAD_DPAD_UP = 0x26" << std::endl;
-    outfile << "GAMEPAD_DPAD_DOWN = 0x28" << std::endl;
-    outfile << "GAMEPAD_DPAD_LEFT = 0x25" << std::endl;
-    outfile << "GAMEPAD_DPAD_RIGHT = 0x27" << std::endl;
-    outfile << "GAMEPAD_START = 0x5B" << std::endl;
-    outfile << "GAMEPAD_BACK = 0xA8" << std::endl;
-    outfile << "GAMEPAD_LEFT_THUMB = 0" << std::endl;
-    outfile << "GAMEPAD_RIGHT_THUMB = 0x71" << std::endl;
-    outfile << "GAMEPAD_LEFT_SHOULDER = 0" << std::endl;
-    outfile << "GAMEPAD_RIGHT_SHOULDER = 0" << std::endl;
-    outfile << "GAMEPAD_A = 0" << std::endl;
-    outfile << "GAMEPAD_B = 0x0D" << std::endl;
-    outfile << "GAMEPAD_X = 0" << std::endl;
-    outfile << "GAMEPAD_Y = 0" << std::endl;
-    outfile << "GAMEPAD_TRIGGER_LEFT = 0" << std::endl;
-    outfile << "GAMEPAD_TRIGGER_RIGHT = 0" << std::endl;
-    outfile << "\n" << std::endl;
-    outfile << "# ADVANCED CONFIGURATION SETTINGS" << std::endl;
-    outfile << "#  ALLOWED CURSOR SPEEDS, FIRST WILL BE CHOSEN BY DEFAULT.  VALUES > 1.0 WILL BE IGNORED.  NO SPACES." << std::endl;
-    outfile << "CURSOR_SPEED = ULTRALOW=0.005,LOW=0.015,MED=0.025,HIGH=0.04" << std::endl;
-    outfile << "#  SET ACCELERATION FACTOR FOR NON-LINEAR CURSOR SPEED" << std::endl;
-    outfile << "# ACCELERATION_FACTOR = 3" << std::endl;
-    outfile << "#  Swaps the function of the thumbsticks. Set to 0 for default behavior or set to 1 to have the mouse movement on the right stick and scrolling on the left stick." << std::endl;
-    outfile << "SWAP_THUMBSTICKS = 0" << std::endl;
-    // End config dump
-
-    outfile.close();
-    
-    file.open(fName.c_str());
-
-    if (!file)
-    {
+    return value;
+  }
 
-      exitWithError("\nERROR! Configuration file " + fName + " still couldn't be found!\n");
-    }
-    else
-    {
+  const long clamped = value < minimum ? minimum : maximum;
+  const Entry *entry = find(key);
+  if (entry == NULL)
+  {
+    return clamped;
+  }
+  addDiagnostic(entry->line, std::string(key) + ": " + std::to_string(value) + " is not between " + std::to_string(minimum)
+    + " and " + std::to_string(maximum) + ", using " + std::to_string(clamped));
+  return clamped;
+}
 
-      printf("Success!\nNow using %s.\n", fName.c_str());
-    }
+// Description:
+//   Gets the first value of a key as a decimal number.
+//
+// Params:
+//   key            The key to look up
+//   defaultValue   Returned when the key is not set or not a number
+//
+// Returns:
+//   The value.
+float ConfigFile::getFloat(std::string_view key, float defaultValue)
+{
+  const Entry *entry = find(key);
+  if (entry == NULL)
+  {
+    return defaultValue;
   }
 
-  //exitWithError("\nSafety exit!\n");
+  float value;
+  if (!parseFloat(entry->values.front(), value))
+  {
+    addInvalidValue(*entry, key, entry->values.front(), "a number");
+    return defaultValue;
+  }
+  return value;
+}
 
-  std::string line;
-  size_t lineNo = 0;
-  while (std::getline(file, line))
+// Description:
+//   Gets every value of a key as a 16 bit button mask or key code. Values that do not fit
+//     are left out.
+//
+// Params:
+//   key  The key to look up
+//
+// Returns:
+//   The values, or none if the key is not set.
+std::vector<WORD> ConfigFile::getWords(std::string_view key)
+{
+  std::vector<WORD> words;
+  const Entry *entry = find(key);
+  if (entry == NULL)
   {
-    lineNo++;
-    std::string temp = line;
+    return words;
+  }
 
-    if (temp.empty())
+  for (const std::string_view &text : entry->values)
+  {
+    long value;
+    if (!parseInt(text, value) || value < 0 || value > 0xFFFF)
     {
+      addInvalidValue(*entry, key, text, "a 16 bit value");
       continue;
     }
+    words.push_back((WORD)value);
+  }
+  return words;
+}
 
-    removeComment(temp);
-    if (onlyWhitespace(temp))
-    {
-      continue;
-    }
+// Description:
+//   Converts text to an integer. The whole text must be the number.
+//
+// Params:
+//   text   Decimal, 0x hexadecimal or 0 octal number with an optional sign
+//   value  Receives the number
+//
+// Returns:
+//   true if the text is a valid number.
+bool ConfigFile::parseInt(std::string_view text, long &value)
+{
+  bool negative = false;
+  if (!text.empty() && (text[0] == '-' || text[0] == '+'))
+  {
+    negative = text[0] == '-';
+    text.remove_prefix(1);
+  }
 
-    parseLine(temp, lineNo);
+  int base = 10;
+  if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+  {
+    base = 16;
+    text.remove_prefix(2);
+  }
+  else if (text.size() > 1 && text[0] == '0')
+  {
+    base = 8;
+    text.remove_prefix(1);
   }
 
-  file.close();
-}
+  unsigned long magnitude;
+  const char *end = text.data() + text.size();
+  std::from_chars_result result = std::from_chars(text.data(), end, magnitude, base);
+  if (text.empty() || result.ec != std::errc() || result.ptr != end || magnitude > (unsigned long)LONG_MAX)
+  {
+    return false;
+  }
 
-ConfigFile::ConfigFile(const std::string &fName)
-{
-  this->fName = fName;
-  ExtractKeys();
+  value = negative ? -(long)magnitude : (long)magnitude;
+  return true;
 }
 
-void ConfigFile::exitWithError(const std::string &error)
+// Description:
+//   Converts text to a decimal number. The whole text must be the number.
+//
+// Params:
+//   text   The number, like 0.025 or -1.5e-3
+//   value  Receives the number
+//
+// Returns:
+//   true if the text is a valid number.
+bool ConfigFile::parseFloat(std::string_view text, float &value)
 {
-  std::cout << error;
-  std::cin.ignore();
-  std::cin.get();
+  if (!text.empty() && text[0] == '+')
+  {
+    text.remove_prefix(1);
+  }
 
-  exit(EXIT_FAILURE);
+  const char *end = text.data() + text.size();
+  std::from_chars_result result = std::from_chars(text.data(), end, value);
+  return !text.empty() && result.ec == std::errc() && result.ptr == end;
 }
@@ -1,44 +1,76 @@
 #pragma once
 
-#include <iostream>
-#include <string>
-#include <sstream>
+#include <windows.h>
 #include <map>
-#include <fstream>
+#include <string>
+#include <string_view>
 #include <vector>
-#include "Convert.h"
 
+// A problem found while reading a config file. The line is 0 for problems with the file itself.
+struct ConfigDiagnostic
+{
+  size_t line;
+  std::string message;
+};
+
+// Reads a config file of KEY = VALUE|VALUE lines with # comments. The file is read into one
+// buffer and split in a single pass; keys and values are views into that buffer, so nothing is
+// copied until a value is converted. Problems never stop the parse: the line or value is skipped,
+// a diagnostic is recorded and the setting keeps its default.
 class ConfigFile
 {
 private:
-  std::map<std::string, std::vector<std::string>> contents;
-  std::string fName;
-
-  void removeComment(std::string &line) const;
-
-  bool onlyWhitespace(const std::string &line) const;
-  bool validLine(const std::string &line) const;
+  struct Entry
+  {
+    size_t line;
+    std::vector<std::string_view> values;
+  };
 
-  void extractKey(std::string &key, size_t const &sepPos, const std::string &line) const;
-  void extractValues(std::vector<std::string> &values, size_t const &sepPos, const std::string &line) const;
+  std::string _fileName;
+  std::string _text;
+  std::map<std::string_view, Entry> _contents;
+  std::vector<ConfigDiagnostic> _diagnostics;
+  bool _loaded;
 
-  void extractContents(const std::string &line);
+  bool readFile();
+  void writeDefault() const;
 
-  void parseLine(const std::string &line, size_t const lineNo);
+  void parse();
+  void parseLine(std::string_view line, size_t lineNo);
 
-  void ExtractKeys();
+  const Entry *find(std::string_view key) const;
+  void addDiagnostic(size_t line, const std::string &message);
+  void addInvalidValue(const Entry &entry, std::string_view key, std::string_view value, const char *expected);
 
 public:
-  ConfigFile(const std::string &fName);
+  ConfigFile(const std::string &fileName, bool createDefault = true);
 
-  std::vector<std::string> getValuesOfKey(const std::string &key, const std::vector<std::string> &defaultValue = {"0"}) const
+  // True if the file was read. A file that could not be read has no keys.
+  bool isLoaded() const
   {
-    std::map<std::string, std::vector<std::string>>::const_iterator it = contents.find(key);
-    if (it == contents.end())
-      return defaultValue;
+    return _loaded;
+  }
 
-    return it->second;
-  };
+  const std::vector<ConfigDiagnostic> &getDiagnostics() const
+  {
+    return _diagnostics;
+  }
+
+  std::string_view getString(std::string_view key, std::string_view defaultValue = "0") const;
+
+  long getInt(std::string_view key, long defaultValue = 0);
+
+  long getInt(std::string_view key, long defaultValue, long minimum, long maximum);
+
+  float getFloat(std::string_view key, float defaultValue = 0.0f);
 
-  void exitWithError(const std::string &error);
-};
\ No newline at end of file
+  std::vector<WORD> getWords(std::string_view key);
+
+  static bool parseInt(std::string_view text, long &value);
+
+  static bool parseFloat(std::string_view text, float &value);
+
+private:
+  ConfigFile(const ConfigFile&) = delete;
+  ConfigFile& operator=(const ConfigFile&) = delete;
+};
@@ -0,0 +1,62 @@
+#include "ConfigProfile.h"
+
+// Description:
+//   Builds every table of the profile from its config and selected cursor speed.
+void ConfigProfile::compile()
+{
+  if (speedIndex >= config.speeds.size())
+  {
+    speedIndex = 0;
+  }
+
+  compileCursor();
+  scrollCurve.build((float)config.SCROLL_DEAD_ZONE, 0.0f, config.SCROLL_SPEED, config.FPS, config.scrollCurvePoints);
+  triggerCurve.build(config.TRIGGER_DEAD_ZONE * TRIGGER_TO_STICK, 0.0f, 1.0f, 1, config.triggerCurvePoints);
+
+  analog.cursorCurve = &cursorCurve;
+  analog.scrollCurve = &scrollCurve;
+  analog.triggerCurve = &triggerCurve;
+  analog.cursorDeadZoneSq = (float)config.DEAD_ZONE * config.DEAD_ZONE;
+  analog.scrollDeadZoneSq = (float)config.SCROLL_DEAD_ZONE * config.SCROLL_DEAD_ZONE;
+  analog.swapSticks = config.SWAP_THUMBSTICKS != 0;
+
+  // Triggers used for scrolling scroll as fast as the stick at full press, up for the left one.
+  const int modes[2] = { config.TRIGGER_LEFT_MODE, config.TRIGGER_RIGHT_MODE };
+  const float wheel = MAXSHORT * config.SCROLL_SPEED / config.FPS;
+  for (int t = 0; t < 2; ++t)
+  {
+    analog.triggerRest[t] = modes[t] == TRIGGER_AXIS_NONE ? 255.0f : (float)config.TRIGGER_DEAD_ZONE;
+    analog.triggerSpeed[t] = modes[t] == TRIGGER_AXIS_CURSOR_SPEED ? config.TRIGGER_CURSOR_SPEED - 1.0f : 0.0f;
+    analog.triggerWheel[t] = modes[t] == TRIGGER_AXIS_SCROLL ? (t == 0 ? wheel : -wheel) : 0.0f;
+  }
+}
+
+// Description:
+//   Rebuilds the cursor curve after the selected cursor speed changed.
+void ConfigProfile::compileCursor()
+{
+  cursorCurve.build((float)config.DEAD_ZONE, config.acceleration_factor, getSpeed(), config.FPS, config.cursorCurvePoints);
+}
+
+// Description:
+//   Gets the selected cursor speed.
+float ConfigProfile::getSpeed() const
+{
+  return speedIndex < config.speeds.size() ? config.speeds[speedIndex] : DEFAULT_SPEED;
+}
+
+// Description:
+//   Lists the executables of the profiles, for ForegroundWatcher::setProcesses.
+//
+// Returns:
+//   The executable of every profile, by profile index. config.ini has an empty name that
+//     never matches.
+std::vector<std::string> ProfileSet::getProcesses() const
+{
+  std::vector<std::string> processes;
+  for (const std::unique_ptr<ConfigProfile> &profile : profiles)
+  {
+    processes.push_back(profile->process);
+  }
+  return processes;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AnalogKernel.h"
+#include "GopherConfig.h"
+#include "ResponseCurve.h"
+
+// A config together with the tables derived from it, compiled when it is loaded so Gopher
+// switches to it by exchanging a pointer.
+struct ConfigProfile
+{
+  static constexpr float DEFAULT_SPEED = 0.025f;  // Cursor speed of a config without speeds.
+
+  std::string process;              // Executable the profile is for, in lower case. Empty for config.ini.
+  GopherConfig config;
+  unsigned int speedIndex = 0;      // Index of the selected cursor speed in config.speeds.
+
+  // Thumbstick response curves
+  ResponseCurve cursorCurve;
+  ResponseCurve scrollCurve;
+  ResponseCurve triggerCurve;       // Trigger outputs from 0 at the dead zone to 1 at full press.
+  AnalogSettings analog;            // Curves and settings the analog kernel applies.
+
+  void compile();
+
+  void compileCursor();
+
+  float getSpeed() const;
+
+  ConfigProfile() = default;
+
+private:
+  ConfigProfile(const ConfigProfile&) = delete;
+  ConfigProfile& operator=(const ConfigProfile&) = delete;
+};
+
+// config.ini and the per-program profiles found in the profiles directory next to it. Each
+// profile is a complete config file named after the executable it applies to, such as
+// profiles\notepad.exe.ini.
+struct ProfileSet
+{
+  std::vector<std::unique_ptr<ConfigProfile>> profiles;  // config.ini first.
+
+  std::vector<std::string> getProcesses() const;
+};
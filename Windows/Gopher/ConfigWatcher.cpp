@@ -0,0 +1,241 @@
+#include "ConfigWatcher.h"
+
+#include "Log.h"
+
+ConfigWatcher::ConfigWatcher()
+  : _thread(NULL)
+  , _stop(CreateEvent(NULL, TRUE, FALSE, NULL))
+{
+}
+
+ConfigWatcher::~ConfigWatcher()
+{
+  stop();
+  CloseHandle(_stop);
+}
+
+// Description:
+//   Starts watching a file. Does nothing if the watcher is already running.
+//
+// Params:
+//   path       The file to watch, absolute or relative to the working directory, or
+//                directory\*.ext for every file with that extension in the directory
+//   onChange   Called on the watcher thread after the file was written, created or replaced
+//
+// Returns:
+//   false if the watcher thread could not be started.
+bool ConfigWatcher::start(const std::string &path, std::function<void()> onChange)
+{
+  if (_thread != NULL)
+  {
+    return true;
+  }
+
+  char fullPath[MAX_PATH];
+  char *fileName = NULL;
+  DWORD length = GetFullPathNameA(path.c_str(), MAX_PATH, fullPath, &fileName);
+  if (length == 0 || length >= MAX_PATH || fileName == NULL)
+  {
+    return false;
+  }
+
+  WCHAR wideName[MAX_PATH];
+  if (MultiByteToWideChar(CP_ACP, 0, fileName, -1, wideName, MAX_PATH) == 0)
+  {
+    return false;
+  }
+
+  _fileName = wideName;
+  _directory.assign(fullPath, fileName);
+  _onChange = onChange;
+
+  ResetEvent(_stop);
+  _thread = CreateThread(NULL, 0, threadProc, this, 0, NULL);
+  return _thread != NULL;
+}
+
+// Description:
+//   Stops the watcher thread and waits for it to exit.
+void ConfigWatcher::stop()
+{
+  if (_thread == NULL)
+  {
+    return;
+  }
+
+  SetEvent(_stop);
+  WaitForSingleObject(_thread, INFINITE);
+  CloseHandle(_thread);
+  _thread = NULL;
+}
+
+DWORD WINAPI ConfigWatcher::threadProc(LPVOID param)
+{
+  static_cast<ConfigWatcher*>(param)->run();
+  return 0;
+}
+
+// Description:
+//   Opens a directory to watch its changes.
+//
+// Params:
+//   path   The directory
+//
+// Returns:
+//   The handle, or INVALID_HANDLE_VALUE if the directory cannot be opened, e.g. because it does
+//     not exist.
+static HANDLE openDirectory(const std::string &path)
+{
+  return CreateFileA(path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                     OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+}
+
+// Description:
+//   Waits for the next changes in a directory, or for stop.
+//
+// Params:
+//   directory    The directory, opened by openDirectory
+//   overlapped   The overlapped structure of the reads, with a manual-reset event
+//   buffer       Receives the FILE_NOTIFY_INFORMATION entries
+//   size         Size of buffer in bytes
+//   filter       The FILE_NOTIFY_CHANGE_ flags of the changes to wait for
+//   bytes        Receives the bytes written to buffer, 0 if the changes did not fit
+//
+// Returns:
+//   false if stop was called or the directory can no longer be watched.
+bool ConfigWatcher::waitForChanges(HANDLE directory, OVERLAPPED &overlapped, DWORD *buffer, DWORD size, DWORD filter, DWORD &bytes)
+{
+  ResetEvent(overlapped.hEvent);
+  if (!ReadDirectoryChangesW(directory, buffer, size, FALSE, filter, NULL, &overlapped, NULL))
+  {
+    return false;
+  }
+
+  const HANDLE events[] = { overlapped.hEvent, _stop };
+  if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0)
+  {
+    DWORD ignored;
+    CancelIoEx(directory, &overlapped);
+    GetOverlappedResult(directory, &overlapped, &ignored, TRUE);
+    return false;
+  }
+
+  bytes = 0;
+  return GetOverlappedResult(directory, &overlapped, &bytes, FALSE) != FALSE;
+}
+
+// Description:
+//   Waits for the directory of the file to be created, watching the directory above it.
+//
+// Params:
+//   overlapped   The overlapped structure of the reads, with a manual-reset event
+//
+// Returns:
+//   The directory of the file, or INVALID_HANDLE_VALUE if stop was called or the directory
+//     above it cannot be watched either.
+HANDLE ConfigWatcher::waitForDirectory(OVERLAPPED &overlapped)
+{
+  // _directory ends with a backslash; the parent is what comes before the one preceding it.
+  const size_t end = _directory.find_last_of('\\', _directory.size() >= 2 ? _directory.size() - 2 : 0);
+  HANDLE parent = end == std::string::npos ? INVALID_HANDLE_VALUE : openDirectory(_directory.substr(0, end + 1));
+  if (parent == INVALID_HANDLE_VALUE)
+  {
+    logMessage(LOG_WARNING, "Cannot watch %s for changes\n", _directory.c_str());
+    return INVALID_HANDLE_VALUE;
+  }
+  logMessage(LOG_WARNING, "%s does not exist, its files are watched once it is created\n", _directory.c_str());
+
+  DWORD buffer[256];
+  DWORD bytes;
+  HANDLE directory = openDirectory(_directory);
+  while (directory == INVALID_HANDLE_VALUE && waitForChanges(parent, overlapped, buffer, sizeof(buffer), FILE_NOTIFY_CHANGE_DIR_NAME, bytes))
+  {
+    directory = openDirectory(_directory);
+  }
+
+  CloseHandle(parent);
+  return directory;
+}
+
+// Description:
+//   The watcher thread body. Waits for changes in the directory of the file and calls the
+//     callback when one of them concerns the file. A directory that does not exist yet is
+//     waited for, and the callback is called once it is created, as it may already hold files.
+void ConfigWatcher::run()
+{
+  OVERLAPPED overlapped;
+  ZeroMemory(&overlapped, sizeof(overlapped));
+  overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+  HANDLE directory = openDirectory(_directory);
+  if (directory == INVALID_HANDLE_VALUE)
+  {
+    directory = waitForDirectory(overlapped);
+    if (directory == INVALID_HANDLE_VALUE)
+    {
+      CloseHandle(overlapped.hEvent);
+      return;
+    }
+    _onChange();
+  }
+
+  DWORD buffer[2048];  // FILE_NOTIFY_INFORMATION entries must be DWORD aligned.
+  const DWORD FILTER = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE;
+
+  while (true)
+  {
+    DWORD bytes = 0;
+    if (!waitForChanges(directory, overlapped, buffer, sizeof(buffer), FILTER, bytes))
+    {
+      break;
+    }
+
+    // No data means the change buffer overflowed, so the file may have changed.
+    bool changed = bytes == 0;
+    for (BYTE *entry = (BYTE*)buffer; bytes != 0 && !changed;)
+    {
+      const FILE_NOTIFY_INFORMATION &info = *(const FILE_NOTIFY_INFORMATION*)entry;
+      changed = matches(info);
+      if (info.NextEntryOffset == 0)
+      {
+        break;
+      }
+      entry += info.NextEntryOffset;
+    }
+
+    if (changed)
+    {
+      // Changes made while settling are reported by the next read and cause another reload.
+      if (WaitForSingleObject(_stop, SETTLE_TIME) == WAIT_OBJECT_0)
+      {
+        break;
+      }
+      _onChange();
+    }
+  }
+
+  CloseHandle(overlapped.hEvent);
+  CloseHandle(directory);
+}
+
+// Description:
+//   Tells whether a change notification is about the watched file.
+//
+// Params:
+//   entry  The notification to check
+//
+// Returns:
+//   true if the entry names the watched file, or ends in its extension, ignoring case.
+bool ConfigWatcher::matches(const FILE_NOTIFY_INFORMATION &entry) const
+{
+  const int length = (int)(entry.FileNameLength / sizeof(WCHAR));
+  if (!_fileName.empty() && _fileName[0] == L'*')
+  {
+    // Names are only compared on their end, so *.ini does not match notes.ini.bak.
+    const int extension = (int)_fileName.size() - 1;
+    return length > extension
+      && CompareStringOrdinal(entry.FileName + length - extension, extension, _fileName.c_str() + 1, extension, TRUE) == CSTR_EQUAL;
+  }
+
+  return CompareStringOrdinal(entry.FileName, length, _fileName.c_str(), (int)_fileName.size(), TRUE) == CSTR_EQUAL;
+}
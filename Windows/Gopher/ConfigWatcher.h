@@ -0,0 +1,44 @@
+#pragma once
+
+#include <windows.h>
+#include <functional>
+#include <string>
+
+// Watches a file for changes with ReadDirectoryChangesW on a background thread. The callback
+// runs on the watcher thread once the file has been quiet for SETTLE_TIME, so an editor that
+// saves in several steps triggers one reload. A file name of the form *.ext watches every file
+// of the directory whose name ends in exactly .ext. A directory that does not exist yet is
+// watched from the moment it is created.
+class ConfigWatcher
+{
+private:
+  static const DWORD SETTLE_TIME = 100;  // milliseconds
+
+  std::string _directory;       // Directory holding the watched file.
+  std::wstring _fileName;       // Name of the watched file within the directory, or *.ext.
+  std::function<void()> _onChange;
+  HANDLE _thread;
+  HANDLE _stop;                 // Manual-reset event that ends the watcher thread.
+
+public:
+  ConfigWatcher();
+  ~ConfigWatcher();
+
+  bool start(const std::string &path, std::function<void()> onChange);
+
+  void stop();
+
+private:
+  static DWORD WINAPI threadProc(LPVOID param);
+
+  void run();
+
+  bool waitForChanges(HANDLE directory, OVERLAPPED &overlapped, DWORD *buffer, DWORD size, DWORD filter, DWORD &bytes);
+
+  HANDLE waitForDirectory(OVERLAPPED &overlapped);
+
+  bool matches(const FILE_NOTIFY_INFORMATION &entry) const;
+
+  ConfigWatcher(const ConfigWatcher&) = delete;
+  ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+};
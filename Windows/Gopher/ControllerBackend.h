@@ -0,0 +1,56 @@
+#pragma once
+
+#include <windows.h>
+#include <xinput.h>
+
+#include "IController.h"
+
+// A source of controller states for the polling thread. Every backend presents its pads as
+// XUSER_MAX_COUNT XInput style slots, so the mapping engine does not know which one it reads.
+// ControllerManager polls XInput; HidBackend receives raw HID reports as they arrive and lets
+// the polling thread sleep until one does.
+class ControllerBackend
+{
+public:
+  virtual ~ControllerBackend() {}
+
+  // Description:
+  //   Reads the latest state of every slot.
+  //
+  // Params:
+  //   states   Receives the state of each connected controller
+  //   now      The current performance counter value
+  //
+  // Returns:
+  //   A mask with bit n set when the controller in slot n is connected.
+  virtual DWORD poll(XINPUT_STATE states[XUSER_MAX_COUNT], LONGLONG now) = 0;
+
+  // Description:
+  //   Gets the controller of a slot, to vibrate it.
+  //
+  // Params:
+  //   index  The slot, 0 to XUSER_MAX_COUNT - 1
+  virtual IController *getController(DWORD index) const = 0;
+
+  // Description:
+  //   Gets an event signalled whenever a controller state changes or a controller comes or goes.
+  //
+  // Returns:
+  //   The event, or NULL when the backend has to be polled to find changes.
+  virtual HANDLE getInputEvent() const
+  {
+    return NULL;
+  }
+
+  // Description:
+  //   Gets when the newest report read by the last poll arrived, of the pads whose state changed
+  //     since the poll before.
+  //
+  // Returns:
+  //   Its performance counter value, or 0 when no pad brought a new report or the backend does
+  //     not time its reports, and the time of the poll stands in for it.
+  virtual LONGLONG getReportTime() const
+  {
+    return 0;
+  }
+};
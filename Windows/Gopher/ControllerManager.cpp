@@ -0,0 +1,204 @@
+#include "ControllerManager.h"
+
+#include <algorithm>
+
+// Device interface classes that announce a new game controller: XUSB for Xbox 360 style pads
+// and HID for pads that are exposed to XInput through the HID stack.
+static const GUID CONTROLLER_INTERFACES[] =
+{
+  { 0xEC87F1E3, 0xC13B, 0x4100, { 0xB5, 0xF7, 0x8B, 0x84, 0xD5, 0x42, 0x60, 0xCB } },  // GUID_DEVINTERFACE_XUSB
+  { 0x4D1E55B2, 0xF16F, 0x11CF, { 0x88, 0xCB, 0x00, 0x11, 0x11, 0x00, 0x00, 0x30 } },  // GUID_DEVINTERFACE_HID
+};
+
+// CM_Register_Notification is only available from Windows 8, so it is loaded at runtime.
+typedef CONFIGRET (WINAPI *RegisterNotificationFn)(PCM_NOTIFY_FILTER, PVOID, PCM_NOTIFY_CALLBACK, PHCMNOTIFICATION);
+typedef CONFIGRET (WINAPI *UnregisterNotificationFn)(HCMNOTIFICATION);
+
+ControllerManager::ControllerManager()
+  : _frequency(1)
+  , _deviceArrived(false)
+  , _cfgmgr(NULL)
+{
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  _frequency = frequency.QuadPart;
+
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+  {
+    _controllers[i].reset(new CXBOXController(i + 1));
+    _connected[i] = false;
+    _nextProbe[i] = 0;
+    _probeInterval[i] = PROBE_INTERVAL_MIN;
+  }
+
+  for (int i = 0; i < NOTIFICATION_COUNT; ++i)
+  {
+    _notifications[i] = NULL;
+  }
+
+  registerNotifications();
+}
+
+ControllerManager::~ControllerManager()
+{
+  unregisterNotifications();
+}
+
+// Description:
+//   Reads every connected controller, and every empty slot that is due to be probed.
+//
+// Params:
+//   states   Receives the state of each connected controller
+//   now      The current performance counter value
+//
+// Returns:
+//   A mask with bit n set when the controller in slot n is connected.
+DWORD ControllerManager::poll(XINPUT_STATE states[XUSER_MAX_COUNT], LONGLONG now)
+{
+  DWORD connected = 0;
+
+  // A device just appeared, so probe every empty slot now instead of waiting out the back-off.
+  if (_deviceArrived.exchange(false, std::memory_order_acquire))
+  {
+    for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+    {
+      _nextProbe[i] = 0;
+      _probeInterval[i] = PROBE_INTERVAL_MIN;
+    }
+  }
+
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+  {
+    if (!_connected[i] && now < _nextProbe[i])
+    {
+      ZeroMemory(&states[i], sizeof(XINPUT_STATE));
+      continue;
+    }
+
+    DWORD result = _controllers[i]->Poll(states[i]);
+    if (result == ERROR_SUCCESS)
+    {
+      _connected[i] = true;
+      _probeInterval[i] = PROBE_INTERVAL_MIN;
+      connected |= 1 << i;
+      continue;
+    }
+
+    // ERROR_DEVICE_NOT_CONNECTED is the normal result for an empty slot. Any other error is
+    // treated the same way so a failing slot cannot be read at the full poll rate.
+    if (_connected[i])
+    {
+      _probeInterval[i] = PROBE_INTERVAL_MIN;
+    }
+    else
+    {
+      _probeInterval[i] = (std::min)(_probeInterval[i] * 2, PROBE_INTERVAL_MAX);
+    }
+
+    _connected[i] = false;
+    _nextProbe[i] = now + _frequency * _probeInterval[i] / 1000;
+  }
+
+  return connected;
+}
+
+// Description:
+//   Gets the controller of a slot.
+//
+// Params:
+//   index  The XInput user index, 0 to XUSER_MAX_COUNT - 1
+//
+// Returns:
+//   The controller of the slot.
+IController *ControllerManager::getController(DWORD index) const
+{
+  return _controllers[index].get();
+}
+
+// Description:
+//   Replaces the controller of a slot, e.g. with a simulated one. Must be called before the
+//     slot is polled or handed to a Gopher instance.
+//
+// Params:
+//   index        The XInput user index, 0 to XUSER_MAX_COUNT - 1
+//   controller   The controller to read the slot from
+void ControllerManager::setController(DWORD index, std::unique_ptr<IController> controller)
+{
+  _controllers[index] = std::move(controller);
+  _connected[index] = false;
+  _nextProbe[index] = 0;
+  _probeInterval[index] = PROBE_INTERVAL_MIN;
+}
+
+// Description:
+//   Subscribes to controller arrival notifications. Does nothing on systems without
+//     CM_Register_Notification, where new pads are found by the periodic probe alone.
+void ControllerManager::registerNotifications()
+{
+  _cfgmgr = LoadLibrary(TEXT("cfgmgr32.dll"));
+  if (_cfgmgr == NULL)
+  {
+    return;
+  }
+
+  RegisterNotificationFn registerNotification =
+    (RegisterNotificationFn)GetProcAddress(_cfgmgr, "CM_Register_Notification");
+  if (registerNotification == NULL)
+  {
+    return;
+  }
+
+  for (int i = 0; i < NOTIFICATION_COUNT; ++i)
+  {
+    CM_NOTIFY_FILTER filter;
+    ZeroMemory(&filter, sizeof(filter));
+    filter.cbSize = sizeof(filter);
+    filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+    filter.u.DeviceInterface.ClassGuid = CONTROLLER_INTERFACES[i];
+
+    if (registerNotification(&filter, this, onDeviceNotification, &_notifications[i]) != CR_SUCCESS)
+    {
+      _notifications[i] = NULL;
+    }
+  }
+}
+
+// Description:
+//   Removes the arrival notifications registered by registerNotifications. Unregistering waits
+//     for callbacks in flight, so this object is not used after it returns.
+void ControllerManager::unregisterNotifications()
+{
+  if (_cfgmgr == NULL)
+  {
+    return;
+  }
+
+  UnregisterNotificationFn unregisterNotification =
+    (UnregisterNotificationFn)GetProcAddress(_cfgmgr, "CM_Unregister_Notification");
+
+  for (int i = 0; i < NOTIFICATION_COUNT; ++i)
+  {
+    if (_notifications[i] != NULL && unregisterNotification != NULL)
+    {
+      unregisterNotification(_notifications[i]);
+    }
+    _notifications[i] = NULL;
+  }
+
+  FreeLibrary(_cfgmgr);
+  _cfgmgr = NULL;
+}
+
+// Description:
+//   Called on a system thread when a controller interface appears or disappears. Only flags the
+//     arrival; the slots are probed by the polling thread.
+DWORD CALLBACK ControllerManager::onDeviceNotification(HCMNOTIFICATION notification, PVOID context, CM_NOTIFY_ACTION action,
+                                                       PCM_NOTIFY_EVENT_DATA eventData, DWORD eventDataSize)
+{
+  if (action == CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL)
+  {
+    ControllerManager *manager = (ControllerManager*)context;
+    manager->_deviceArrived.store(true, std::memory_order_release);
+  }
+  return ERROR_SUCCESS;
+}
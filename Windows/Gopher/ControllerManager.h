@@ -0,0 +1,53 @@
+#pragma once
+
+#include <windows.h>
+#include <xinput.h>
+#include <cfgmgr32.h>
+#include <atomic>
+#include <memory>
+
+#include "ControllerBackend.h"
+#include "CXBOXController.h"
+
+// The XInput backend. Owns one controller per XInput slot and polls all of them in a single
+// pass. Reading an empty slot with XInputGetState is expensive, so empty slots are probed with
+// an exponential back-off from PROBE_INTERVAL_MIN up to PROBE_INTERVAL_MAX milliseconds. Where
+// the system supports device notifications, a device arrival resets the back-off so a new pad
+// is picked up on the next poll.
+class ControllerManager : public ControllerBackend
+{
+private:
+  static const int PROBE_INTERVAL_MIN = 250;   // milliseconds
+  static const int PROBE_INTERVAL_MAX = 8000;  // milliseconds
+  static const int NOTIFICATION_COUNT = 2;
+
+  std::unique_ptr<IController> _controllers[XUSER_MAX_COUNT];
+  bool _connected[XUSER_MAX_COUNT];     // Result of the last read of each slot.
+  LONGLONG _nextProbe[XUSER_MAX_COUNT]; // Performance counter value at which an empty slot is read again.
+  int _probeInterval[XUSER_MAX_COUNT];  // Current back-off of each empty slot, in milliseconds.
+  LONGLONG _frequency;                  // Performance counter ticks per second.
+
+  std::atomic<bool> _deviceArrived;     // Set from the notification callback, cleared by poll.
+  HMODULE _cfgmgr;
+  HCMNOTIFICATION _notifications[NOTIFICATION_COUNT];
+
+public:
+  ControllerManager();
+  ~ControllerManager();
+
+  DWORD poll(XINPUT_STATE states[XUSER_MAX_COUNT], LONGLONG now) override;
+
+  IController *getController(DWORD index) const override;
+
+  void setController(DWORD index, std::unique_ptr<IController> controller);
+
+private:
+  void registerNotifications();
+  void unregisterNotifications();
+
+  static DWORD CALLBACK onDeviceNotification(HCMNOTIFICATION notification, PVOID context, CM_NOTIFY_ACTION action,
+                                             PCM_NOTIFY_EVENT_DATA eventData, DWORD eventDataSize);
+
+  ControllerManager(const ControllerManager&) = delete;
+  ControllerManager& operator=(const ControllerManager&) = delete;
+};
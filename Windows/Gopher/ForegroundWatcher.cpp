@@ -0,0 +1,220 @@
+#include "ForegroundWatcher.h"
+
+ForegroundWatcher *ForegroundWatcher::_instance = nullptr;
+
+ForegroundWatcher::ForegroundWatcher()
+  : _lock(SRWLOCK_INIT)
+  , _nextEntry(0)
+  , _match(-1)
+  , _thread(NULL)
+  , _threadId(0)
+  , _started(CreateEvent(NULL, TRUE, FALSE, NULL))
+{
+}
+
+ForegroundWatcher::~ForegroundWatcher()
+{
+  stop();
+  CloseHandle(_started);
+}
+
+// Description:
+//   Starts following the foreground window. Does nothing if the watcher is already running.
+//
+// Params:
+//   onChange   Called on the watcher thread when the foreground window moves to a program with
+//                another match
+//
+// Returns:
+//   false if the watcher thread could not be started.
+bool ForegroundWatcher::start(std::function<void()> onChange)
+{
+  if (_thread != NULL)
+  {
+    return true;
+  }
+
+  _onChange = onChange;
+  ResetEvent(_started);
+  _thread = CreateThread(NULL, 0, threadProc, this, 0, &_threadId);
+  if (_thread == NULL)
+  {
+    return false;
+  }
+
+  // WM_QUIT can only be posted once the thread has a message queue.
+  WaitForSingleObject(_started, INFINITE);
+  return true;
+}
+
+// Description:
+//   Stops the watcher thread and waits for it to exit.
+void ForegroundWatcher::stop()
+{
+  if (_thread == NULL)
+  {
+    return;
+  }
+
+  PostThreadMessage(_threadId, WM_QUIT, 0, 0);
+  WaitForSingleObject(_thread, INFINITE);
+  CloseHandle(_thread);
+  _thread = NULL;
+}
+
+// Description:
+//   Sets the executables to match the foreground window against, and matches the current one
+//     right away. Called from any thread.
+//
+// Params:
+//   processes  Executable names such as notepad.exe, in lower case
+void ForegroundWatcher::setProcesses(const std::vector<std::string> &processes)
+{
+  AcquireSRWLockExclusive(&_lock);
+  _processes = processes;
+  _match.store(find(_current), std::memory_order_release);
+  ReleaseSRWLockExclusive(&_lock);
+}
+
+DWORD WINAPI ForegroundWatcher::threadProc(LPVOID param)
+{
+  static_cast<ForegroundWatcher*>(param)->run();
+  return 0;
+}
+
+void CALLBACK ForegroundWatcher::eventProc(HWINEVENTHOOK hook, DWORD event, HWND window, LONG object, LONG child, DWORD thread, DWORD time)
+{
+  if (_instance != nullptr && event == EVENT_SYSTEM_FOREGROUND && window != NULL)
+  {
+    _instance->update(window);
+  }
+}
+
+// Description:
+//   The watcher thread body. Out of context WinEvent hooks are called from the message loop of
+//     the thread that set them.
+void ForegroundWatcher::run()
+{
+  MSG msg;
+  PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);  // Creates the message queue.
+
+  _instance = this;
+  HWINEVENTHOOK hook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, NULL, eventProc, 0, 0,
+                                       WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+  SetEvent(_started);
+
+  if (hook != NULL)
+  {
+    update(GetForegroundWindow());
+  }
+
+  while (GetMessage(&msg, NULL, 0, 0) > 0)
+  {
+    DispatchMessage(&msg);
+  }
+
+  if (hook != NULL)
+  {
+    UnhookWinEvent(hook);
+  }
+  _instance = nullptr;
+}
+
+// Description:
+//   Matches a new foreground window.
+//
+// Params:
+//   window   The foreground window
+void ForegroundWatcher::update(HWND window)
+{
+  DWORD processId = 0;
+  const DWORD threadId = GetWindowThreadProcessId(window, &processId);
+  if (threadId == 0)
+  {
+    return;
+  }
+
+  AcquireSRWLockExclusive(&_lock);
+  _current = lookup(processId, threadId);
+  const int match = find(_current);
+  const int previous = _match.exchange(match, std::memory_order_acq_rel);
+  ReleaseSRWLockExclusive(&_lock);
+
+  if (match != previous && _onChange)
+  {
+    _onChange();
+  }
+}
+
+// Description:
+//   Gets the executable name of a window's process, from the cache if it was seen recently.
+//     Must be called with the lock held.
+//
+// Params:
+//   processId  The process owning the window
+//   threadId   The thread owning the window
+//
+// Returns:
+//   The lower case executable name, or an empty string if the process cannot be opened, e.g.
+//     because it runs elevated.
+const std::string &ForegroundWatcher::lookup(DWORD processId, DWORD threadId)
+{
+  for (const CacheEntry &entry : _cache)
+  {
+    if (entry.processId == processId && entry.threadId == threadId)
+    {
+      return entry.process;
+    }
+  }
+
+  CacheEntry &entry = _cache[_nextEntry];
+  _nextEntry = (_nextEntry + 1) % CACHE_SIZE;
+  entry.processId = processId;
+  entry.threadId = threadId;
+  entry.process.clear();
+
+  HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId);
+  if (process != NULL)
+  {
+    char path[MAX_PATH];
+    DWORD length = MAX_PATH;
+    if (QueryFullProcessImageNameA(process, 0, path, &length))
+    {
+      const char *name = path;
+      for (DWORD i = 0; i < length; ++i)
+      {
+        if (path[i] == '\\')
+        {
+          name = path + i + 1;
+        }
+      }
+      entry.process.assign(name, path + length - name);
+      CharLowerBuffA(&entry.process[0], (DWORD)entry.process.size());
+    }
+    CloseHandle(process);
+  }
+
+  return entry.process;
+}
+
+// Description:
+//   Finds an executable in the list to match. Must be called with the lock held.
+//
+// Returns:
+//   Its index, or -1 if it is not in the list.
+int ForegroundWatcher::find(const std::string &process) const
+{
+  if (process.empty())
+  {
+    return -1;
+  }
+
+  for (size_t i = 0; i < _processes.size(); ++i)
+  {
+    if (_processes[i] == process)
+    {
+      return (int)i;
+    }
+  }
+  return -1;
+}
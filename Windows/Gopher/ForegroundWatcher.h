@@ -0,0 +1,74 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Follows the foreground window with an EVENT_SYSTEM_FOREGROUND hook on a thread of its own and
+// tells which of a list of executables it belongs to. Nothing is polled: the hook runs only when
+// the foreground window changes. The executable of recently seen windows is cached by their
+// process and thread, so switching back and forth between programs does not open them again.
+class ForegroundWatcher
+{
+private:
+  static const size_t CACHE_SIZE = 16;
+
+  struct CacheEntry
+  {
+    DWORD processId = 0;
+    DWORD threadId = 0;         // Thread owning the window. Together with the process, never reused while the window exists.
+    std::string process;        // Lower case executable name.
+  };
+
+  SRWLOCK _lock;                        // Guards everything below but _match.
+  std::vector<std::string> _processes;  // Lower case executable names to match.
+  CacheEntry _cache[CACHE_SIZE];
+  size_t _nextEntry;                    // Cache entry replaced by the next lookup.
+  std::string _current;                 // Executable of the foreground window.
+  std::atomic<int> _match;              // Index in _processes of _current, -1 when there is none.
+
+  std::function<void()> _onChange;
+  HANDLE _thread;
+  DWORD _threadId;
+  HANDLE _started;                      // Set once the hook thread is ready for WM_QUIT.
+
+  static ForegroundWatcher *_instance;  // WinEvent callbacks carry no context; there is one watcher.
+
+public:
+  ForegroundWatcher();
+  ~ForegroundWatcher();
+
+  bool start(std::function<void()> onChange);
+
+  void stop();
+
+  void setProcesses(const std::vector<std::string> &processes);
+
+  // Description:
+  //   Gets the executable the foreground window belongs to. Safe to call from any thread.
+  //
+  // Returns:
+  //   Its index in the list given to setProcesses, or -1 when it is not in the list.
+  int getMatch() const
+  {
+    return _match.load(std::memory_order_acquire);
+  }
+
+private:
+  static DWORD WINAPI threadProc(LPVOID param);
+
+  static void CALLBACK eventProc(HWINEVENTHOOK hook, DWORD event, HWND window, LONG object, LONG child, DWORD thread, DWORD time);
+
+  void run();
+
+  void update(HWND window);
+
+  const std::string &lookup(DWORD processId, DWORD threadId);
+
+  int find(const std::string &process) const;
+
+  ForegroundWatcher(const ForegroundWatcher&) = delete;
+  ForegroundWatcher& operator=(const ForegroundWatcher&) = delete;
+};
@@ -1,358 +1,672 @@
 #include "Gopher.h"
-#include "ConfigFile.h"
+
+#include <algorithm>
 
 // Description:
-//   Send a keyboard input to the system based on the key value
+//   Queue a keyboard input for this frame based on the key value
 //     and its event type.
 //
 // Params:
 //   cmd    The value of the key to send(see http://msdn.microsoft.com/en-us/library/windows/desktop/dd375731%28v=vs.85%29.aspx)
 //   flag   The KEYEVENT for the key
-void inputKeyboard(std::vector<WORD> cmds, DWORD flag)
+void Gopher::inputKeyboard(const KeyChord &cmds, DWORD flag)
 {
-  std::vector<INPUT> inputs;
   for (const WORD cmd : cmds)
   {
-    INPUT input;
-    input.type = INPUT_KEYBOARD;
-    input.ki.wScan = 0;
-    input.ki.time = 0;
-    input.ki.dwExtraInfo = 0;
-    input.ki.wVk = cmd;
-    input.ki.dwFlags = flag;
-    inputs.push_back(input);
+    _batch.keyboard(cmd, flag);
   }
-  SendInput(inputs.size(), inputs.data(), sizeof(INPUT));
 }
 
 // Description:
-//   Send a keyboard input based on the key value with the "pressed down" event.
+//   Queue a keyboard input based on the key value with the "pressed down" event.
 //
 // Params:
 //   cmd    The value of the keys to send
-void inputKeyboardDown(std::vector<WORD> cmds)
+void Gopher::inputKeyboardDown(const KeyChord &cmds)
 {
   inputKeyboard(cmds, 0);
 }
 
 // Description:
-//   Send a keyboard input based on the key value with the "released" event
+//   Queue a keyboard input based on the key value with the "released" event
 //
 // Params:
 //   cmds    The value of the keys to send
-void inputKeyboardUp(std::vector<WORD> cmds)
+void Gopher::inputKeyboardUp(const KeyChord &cmds)
 {
   inputKeyboard(cmds, KEYEVENTF_KEYUP);
 }
 
 // Description:
-//   Send a mouse input based on a mouse event type.
+//   Queue a mouse input for this frame based on a mouse event type.
 //   See https://msdn.microsoft.com/en-us/library/windows/desktop/ms646310(v=vs.85).aspx
 //
 // Params:
 //   dwFlags    The mouse event to send
 //   mouseData  Additional information needed for certain mouse events (Optional)
-void mouseEvent(DWORD dwFlags, DWORD mouseData = 0)
+void Gopher::mouseEvent(DWORD dwFlags, DWORD mouseData)
 {
-  INPUT input;
-  input.type = INPUT_MOUSE;
+  _batch.mouse(dwFlags, mouseData);
+}
 
-  // Only set mouseData when using a supported dwFlags type
-  if (dwFlags == MOUSEEVENTF_WHEEL ||
-      dwFlags == MOUSEEVENTF_XUP   ||
-      dwFlags == MOUSEEVENTF_XDOWN ||
-      dwFlags == MOUSEEVENTF_HWHEEL)
-  {
-    input.mi.mouseData = mouseData;
-  }
-  else
+Gopher::Gopher(ControllerBackend * controllers, InputSink * sink)
+  : _controllers(controllers)
+  , _sink(sink)
+  , _poller(controllers, &_stats)
+  , _recordingSink(sink, &_recorder)
+  , _batch(&_recordingSink)
+{
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
   {
-    input.mi.mouseData = 0;
+    _pads[i].controller = controllers->getController(i);
+    for (int id = 0; id < BINDING_COUNT; ++id)
+    {
+      _pads[i].gestures[id].timer.cookie = i * BINDING_COUNT + id;
+    }
   }
 
-  input.mi.dwFlags = dwFlags;
-  input.mi.time = 0;
-  SendInput(1, &input, sizeof(INPUT));
+  // Frames are handled with the default settings until config.ini is loaded.
+  _profileSet.profiles.emplace_back(new ConfigProfile());
+  _profile = _profileSet.profiles[0].get();
+  _profile->compile();
+  _config = &_profile->config;
 }
 
-std::vector<WORD> stringsToShorts(const std::vector<std::string> &strings)
+Gopher::~Gopher()
 {
-  std::vector<WORD> shorts;
-  for (const std::string &string : strings) shorts.push_back(std::stoi(string.c_str(), 0, 0));
-  return shorts;
+  _foreground.stop();
+  _osk.stop();
+  _watcher.stop();
+  _profileWatcher.stop();
+  _poller.stop();
+  delete _pendingProfiles.exchange(nullptr);
 }
 
-Gopher::Gopher(CXBOXController * controller)
-  : _controller(controller)
+// Description:
+//   Prints the problems found in a config file.
+//
+// Params:
+//   path         The config file
+//   diagnostics  The problems to print
+static void printConfigDiagnostics(const char *path, const std::vector<ConfigDiagnostic> &diagnostics)
 {
+  for (const ConfigDiagnostic &diagnostic : diagnostics)
+  {
+    if (diagnostic.line == 0)
+    {
+      logMessage(LOG_WARNING, "CFG: %s: %s\n", path, diagnostic.message.c_str());
+    }
+    else
+    {
+      logMessage(LOG_WARNING, "CFG: %s line %u: %s\n", path, (unsigned int)diagnostic.line, diagnostic.message.c_str());
+    }
+  }
 }
 
 // Description:
-//   Reads and parses the configuration file, assigning values to the 
-//     configuration variables.
-void Gopher::loadConfigFile()
+//   Reads config.ini and every per-program profile, and compiles them.
+//
+// Params:
+//   profiles       Receives the profiles. config.ini is always the first one.
+//   createDefault  Whether to generate a default config.ini if it does not exist
+//   cached         Whether to go through the config caches. false parses every file and
+//                    writes none.
+//
+// Returns:
+//   false if config.ini could not be read.
+static bool loadProfiles(ProfileSet &profiles, bool createDefault, bool cached)
 {
-  ConfigFile cfg("config.ini");
-  
-  //--------------------------------
-  // Configuration bindings
-  //--------------------------------
-  CONFIG_MOUSE_LEFT = stringsToShorts(cfg.getValuesOfKey("CONFIG_MOUSE_LEFT")).front();
-  CONFIG_MOUSE_RIGHT = stringsToShorts(cfg.getValuesOfKey("CONFIG_MOUSE_RIGHT")).front();
-  CONFIG_MOUSE_MIDDLE = stringsToShorts(cfg.getValuesOfKey("CONFIG_MOUSE_MIDDLE")).front();
-  CONFIG_HIDE = stringsToShorts(cfg.getValuesOfKey("CONFIG_HIDE")).front();
-  CONFIG_DISABLE = stringsToShorts(cfg.getValuesOfKey("CONFIG_DISABLE")).front();
-  CONFIG_DISABLE_VIBRATION = stringsToShorts(cfg.getValuesOfKey("CONFIG_DISABLE_VIBRATION")).front();
-  CONFIG_SPEED_CHANGE = stringsToShorts(cfg.getValuesOfKey("CONFIG_SPEED_CHANGE")).front();
-  CONFIG_OSK = stringsToShorts(cfg.getValuesOfKey("CONFIG_OSK")).front();
+  ConfigProfile *base = new ConfigProfile();
+  profiles.profiles.emplace_back(base);
+
+  std::vector<ConfigDiagnostic> diagnostics;
+  const bool loaded = cached ? base->config.loadCached("config.ini", diagnostics, createDefault)
+                             : base->config.load("config.ini", diagnostics, createDefault);
+  printConfigDiagnostics("config.ini", diagnostics);
+  base->compile();
+
+  WIN32_FIND_DATAA entry;
+  HANDLE search = FindFirstFileA("profiles\\*.ini", &entry);
+  if (search == INVALID_HANDLE_VALUE)
+  {
+    return loaded;
+  }
 
-  //--------------------------------
-  // Controller bindings
-  //--------------------------------
-  GAMEPAD_DPAD_UP = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_DPAD_UP"));
-  GAMEPAD_DPAD_DOWN = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_DPAD_DOWN"));
-  GAMEPAD_DPAD_LEFT = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_DPAD_LEFT"));
-  GAMEPAD_DPAD_RIGHT = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_DPAD_RIGHT"));
-  GAMEPAD_START = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_START"));
-  GAMEPAD_BACK = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_BACK"));
-  GAMEPAD_LEFT_THUMB = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_LEFT_THUMB"));
-  GAMEPAD_RIGHT_THUMB = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_RIGHT_THUMB"));
-  GAMEPAD_LEFT_SHOULDER = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_LEFT_SHOULDER"));
-  GAMEPAD_RIGHT_SHOULDER = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_RIGHT_SHOULDER"));
-  GAMEPAD_A = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_A"));
-  GAMEPAD_B = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_B"));
-  GAMEPAD_X = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_X"));
-  GAMEPAD_Y = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_Y"));
-  GAMEPAD_TRIGGER_LEFT = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_TRIGGER_LEFT"));
-  GAMEPAD_TRIGGER_RIGHT = stringsToShorts(cfg.getValuesOfKey("GAMEPAD_TRIGGER_RIGHT"));
+  do
+  {
+    // The pattern also matches longer extensions through their short names.
+    std::string name = entry.cFileName;
+    if ((entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || name.size() <= 4 || _stricmp(name.c_str() + name.size() - 4, ".ini") != 0)
+    {
+      continue;
+    }
+
+    std::unique_ptr<ConfigProfile> profile(new ConfigProfile());
+    const std::string path = "profiles\\" + name;
+    diagnostics.clear();
+    bool profileLoaded = cached ? profile->config.loadCached(path, diagnostics, false) : profile->config.load(path, diagnostics, false);
+    printConfigDiagnostics(path.c_str(), diagnostics);
+    if (!profileLoaded)
+    {
+      continue;
+    }
+
+    profile->process = name.substr(0, name.size() - 4);
+    CharLowerBuffA(&profile->process[0], (DWORD)profile->process.size());
+    profile->compile();
+    profiles.profiles.push_back(std::move(profile));
+  } while (FindNextFileA(search, &entry));
+  FindClose(search);
+
+  return loaded;
+}
+
+// Description:
+//   Reads and parses the configuration file and the per-program profiles, and applies them.
+//     Settings that could not be read are reported and keep their defaults.
+//
+// Params:
+//   session  false to use only the mapping settings, e.g. in a benchmark: no file is created,
+//              and TRACE_FILE, LOG_FILE, LOG_ETW and the scheduling settings are ignored
+void Gopher::loadConfigFile(bool session)
+{
+  _session = session;
+  ProfileSet profiles;
+  loadProfiles(profiles, session, session);
+  applyProfiles(profiles);
 
-  //--------------------------------
-  // Advanced settings
-  //--------------------------------
+  // Set the initial window visibility
+  setWindowVisibility(_hidden);
+}
+
+// Description:
+//   Opens the state file and restores the cursor speeds, toggles and stick calibration of the
+//     previous session. Called once after loadConfigFile, before the first frame; without it
+//     every session starts from the defaults.
+//
+// Params:
+//   path   The state file, created if it does not exist
+void Gopher::loadState(const std::string &path)
+{
+  if (!_state.open(path))
+  {
+    logMessage(LOG_WARNING, "Cannot open %s. Speeds, toggles and stick calibration will not be kept.\n", path.c_str());
+  }
 
-  // Acceleration factor
-  acceleration_factor = strtof(cfg.getValuesOfKey("ACCELERATION_FACTOR").at(0).c_str(), 0);
+  for (std::unique_ptr<ConfigProfile> &profile : _profileSet.profiles)
+  {
+    restoreSpeed(*profile);
+  }
 
-  // Dead zones
-  DEAD_ZONE = strtol(cfg.getValuesOfKey("DEAD_ZONE").at(0).c_str(), 0, 0);
-  if (DEAD_ZONE == 0)
+  _state.getToggles(_disabled, _vibrationDisabled, _hidden);
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
   {
-    DEAD_ZONE = 6000;
+    _calibrator.setCalibration(i, _state.getCalibration(i));
   }
 
-  SCROLL_DEAD_ZONE = strtol(cfg.getValuesOfKey("SCROLL_DEAD_ZONE").at(0).c_str(), 0, 0);
-  if (SCROLL_DEAD_ZONE == 0)
+  if (_disabled)
   {
-    SCROLL_DEAD_ZONE = 5000;
+    logMessage(LOG_INFO, "Gopher is disabled. Press the disable button to enable it.\n");
   }
+  setWindowVisibility(_hidden);
+}
 
-  SCROLL_SPEED = strtof(cfg.getValuesOfKey("SCROLL_SPEED").at(0).c_str(), 0);
-  if (SCROLL_SPEED < 0.00001f)
+// Description:
+//   Parses the configuration file and the per-program profiles into new profiles and hands them
+//     to the main loop. Called on the watcher threads of config.ini and of the profiles
+//     directory, so the main loop keeps running while the files are parsed. A config.ini that
+//     cannot be read, such as one being replaced by an editor, keeps the current profiles.
+void Gopher::reloadConfigFile()
+{
+  // Both watchers write the same config caches.
+  AcquireSRWLockExclusive(&_reloadLock);
+  ProfileSet *profiles = new ProfileSet();
+  const bool loaded = loadProfiles(*profiles, false, _session);
+  ReleaseSRWLockExclusive(&_reloadLock);
+  if (!loaded)
   {
-    SCROLL_SPEED = 0.1f;
+    delete profiles;
+    return;
   }
 
-  // Variable cursor speeds
-  std::istringstream cursor_speed = std::istringstream(cfg.getValuesOfKey("CURSOR_SPEED").at(0).c_str());
-  int cur_speed_idx = 1;
-  const float CUR_SPEED_MIN = 0.0001f;
-  const float CUR_SPEED_MAX = 1.0f;
-  for (std::string cur_speed; std::getline(cursor_speed, cur_speed, ',');)
+  // Profiles that were never picked up are replaced by the newer ones.
+  delete _pendingProfiles.exchange(profiles, std::memory_order_acq_rel);
+  _poller.wake();
+}
+
+// Description:
+//   Switches to newly loaded profiles between two frames, then to the one of the program in
+//     the foreground.
+//
+// Params:
+//   profiles   The profiles to use. Its contents are moved out.
+void Gopher::applyProfiles(ProfileSet &profiles)
+{
+  // Keep the selected cursor speed of every program if its new config still has it.
+  for (std::unique_ptr<ConfigProfile> &profile : profiles.profiles)
   {
-    std::istringstream cursor_speed_entry = std::istringstream(cur_speed);
-    std::string cur_name, cur_speed_s;
-    // Check to see if we are at the string that includes the equals sign.
-    if (cur_speed.find_first_of('=') != std::string::npos)
+    if (restoreSpeed(*profile))
     {
-      std::getline(cursor_speed_entry, cur_name, '=');
+      continue;
     }
-    else
+
+    for (const std::unique_ptr<ConfigProfile> &previous : _profileSet.profiles)
     {
-      std::ostringstream tmp_name;
-      tmp_name << cur_speed_idx++;
-      cur_name = tmp_name.str();
+      if (previous->process == profile->process && previous->speedIndex < profile->config.speeds.size())
+      {
+        profile->speedIndex = previous->speedIndex;
+        profile->compileCursor();
+      }
     }
-    std::getline(cursor_speed_entry, cur_speed_s);
-    float cur_speedf = strtof(cur_speed_s.c_str(), 0);
-    // Ignore speeds that are not within the allowed range.
-    if (cur_speedf > CUR_SPEED_MIN && cur_speedf <= CUR_SPEED_MAX)
+  }
+
+  // Session recording is set by config.ini alone. A trace that is already being recorded keeps going.
+  const GopherConfig &base = profiles.profiles[0]->config;
+  if (base.TRACE_FILE == "0" || !_session)
+  {
+    _recorder.stop();
+  }
+  else if (base.TRACE_FILE != _profileSet.profiles[0]->config.TRACE_FILE || !_recorder.isStarted())
+  {
+    // The file is opened by the helper thread of the recorder, which logs the outcome.
+    const ULONGLONG capacity = (ULONGLONG)base.TRACE_SIZE * 1024 * 1024;
+    if (capacity > (SIZE_T)-1 || !_recorder.start(base.TRACE_FILE, (SIZE_T)capacity))
     {
-      speeds.push_back(cur_speedf);
-      speed_names.push_back(cur_name);
+      logMessage(LOG_ERROR, "Cannot record input trace to %s\n", base.TRACE_FILE.c_str());
     }
   }
 
-  // If no cursor speeds were defined, add a set of default speeds.
-  if (speeds.size() == 0)
+  // So is logging.
+  setLogLevel((LogLevel)base.LOG_LEVEL);
+  if (_session)
   {
-    speeds.push_back(0.005f);
-    speeds.push_back(0.015f);
-    speeds.push_back(0.025f);
-    speeds.push_back(0.004f);
-    speed_names.push_back("ULTRALOW");
-    speed_names.push_back("LOW");
-    speed_names.push_back("MED");
-    speed_names.push_back("HIGH");
+    setLogFile(base.LOG_FILE);
+    setLogEtw(base.LOG_ETW != 0);
   }
-  speed = speeds[0];  // Initialize the speed to the first speed stored. TODO: Set the speed to a saved speed that was last used when the application was closed last.
 
-  // Swap stick functions
-  SWAP_THUMBSTICKS = strtol(cfg.getValuesOfKey("SWAP_THUMBSTICKS").at(0).c_str(), 0, 0);
+  // And the scheduling of the process and its input threads, which may be applied to a thread
+  // other than this one, e.g. before loop runs the first time.
+  if (_session)
+  {
+    if (!ThreadTuning::applyProcess(base.PROCESS_PRIORITY, base.NO_POWER_THROTTLING != 0))
+    {
+      logMessage(LOG_WARNING, "Cannot apply PROCESS_PRIORITY or NO_POWER_THROTTLING\n");
+    }
+    ThreadSettings pollSettings;
+    pollSettings.mmcssTask = base.MMCSS_TASK;
+    pollSettings.affinity = base.POLL_AFFINITY;
+    pollSettings.noPowerThrottling = base.NO_POWER_THROTTLING != 0;
+    _poller.setThreadSettings(pollSettings);
+    _loopSettings = pollSettings;
+    _loopSettings.affinity = base.LOOP_AFFINITY;
+    _loopRetune = true;
+  }
 
-  // Set the initial window visibility
-  setWindowVisibility(_hidden);
+  // The old profiles are freed once nothing points into them.
+  ProfileSet previous = std::move(_profileSet);
+  _profileSet = std::move(profiles);
+  _foreground.setProcesses(_profileSet.getProcesses());
+  switchProfile(_foreground.getMatch());
 }
 
 // Description:
-//   The main program loop. Handles the gamepad inputs and converts them
-//     to system inputs based on the mapping provided by the configuration
-//     file.
-void Gopher::loop()
+//   Selects the cursor speed saved for a profile, this session or an earlier one.
+//
+// Params:
+//   profile  The profile
+//
+// Returns:
+//   false if no speed was saved for the profile, or its config no longer has it.
+bool Gopher::restoreSpeed(ConfigProfile &profile) const
 {
-  Sleep(SLEEP_AMOUNT);
-
-  _currentState = _controller->GetState();
-
-  // Disable Gopher
-  handleDisableButton();
-  if (_disabled)
+  unsigned int speedIndex;
+  if (!_state.getSpeedIndex(profile.process, speedIndex) || speedIndex >= profile.config.speeds.size())
   {
-    return;
+    return false;
   }
 
-  // Vibration
-  handleVibrationButton();
-
-  // Mouse functions
-  handleMouseMovement();
-  handleScrolling();
-
-  if (CONFIG_MOUSE_LEFT)
-  {
-    mapMouseClick(CONFIG_MOUSE_LEFT, MOUSEEVENTF_LEFTDOWN, MOUSEEVENTF_LEFTUP);
-  }
-  if (CONFIG_MOUSE_RIGHT)
+  if (speedIndex != profile.speedIndex)
   {
-    mapMouseClick(CONFIG_MOUSE_RIGHT, MOUSEEVENTF_RIGHTDOWN, MOUSEEVENTF_RIGHTUP);
+    profile.speedIndex = speedIndex;
+    profile.compileCursor();
   }
-  if (CONFIG_MOUSE_MIDDLE)
+  return true;
+}
+
+// Description:
+//   Switches to a profile between two frames. Keys held under the old bindings are released
+//     first; buttons still held are pressed again under the new bindings.
+//
+// Params:
+//   index    The profile to use, or -1 for config.ini
+void Gopher::switchProfile(int index)
+{
+  for (PadState &pad : _pads)
   {
-    mapMouseClick(CONFIG_MOUSE_MIDDLE, MOUSEEVENTF_MIDDLEDOWN, MOUSEEVENTF_MIDDLEUP);
+    releasePad(pad);
   }
+  _batch.flush();
 
-  // Hides the console
-  if (CONFIG_HIDE)
+  _profileIndex = index;
+  _profile = _profileSet.profiles[index >= 0 && index < (int)_profileSet.profiles.size() ? index : 0].get();
+  _config = &_profile->config;
+
+  _poller.setRates(_config->FPS, _config->IDLE_FPS, _config->IDLE_TIMEOUT);
+  _filter.configure(_config->FILTER_MIN_CUTOFF, _config->FILTER_BETA, _timers.getFrequency());
+
+  // Leftover wheel fractions may not line up with the new step size.
+  _wheelRestX = 0.0f;
+  _wheelRestY = 0.0f;
+}
+
+// Description:
+//   Starts the polling, config watcher, foreground and On-Screen Keyboard threads. Called once
+//     after loadConfigFile and loadState, before the first call to loop.
+void Gopher::start()
+{
+  _poller.start();
+  _watcher.start("config.ini", [this]() { reloadConfigFile(); });
+  _profileWatcher.start("profiles\\*.ini", [this]() { reloadConfigFile(); });
+  _foreground.start([this]() { _poller.wake(); });
+  _osk.start();
+}
+
+// Description:
+//   Asks the thread calling loop to stop: a pending or the next loop returns, and isRunning
+//     becomes false. Can be called from any thread.
+void Gopher::stop()
+{
+  _running = false;
+  _poller.wake();
+}
+
+// Description:
+//   Tells whether loop should keep being called.
+//
+// Returns:
+//   false once stop was called.
+bool Gopher::isRunning() const
+{
+  return _running;
+}
+
+// Description:
+//   Releases every key and mouse button the pads hold down, e.g. before exiting. Must be called
+//     on the thread calling loop, once it stopped calling it.
+void Gopher::releaseAll()
+{
+  for (PadState &pad : _pads)
   {
-    setXboxClickState(CONFIG_HIDE);
-    if (_xboxClickIsDown[CONFIG_HIDE])
-    {
-      toggleWindowVisibility();
-    }
+    releasePad(pad);
   }
+  _batch.flush();
+}
 
-  // Toggle the on-screen keyboard
-  if (CONFIG_OSK)
+// Description:
+//   The main program loop. Handles the gamepad inputs and converts them
+//     to system inputs based on the mapping provided by the configuration
+//     file. Each iteration handles one sample from the polling thread, so
+//     a slow iteration delays samples instead of losing them.
+void Gopher::loop()
+{
+  // Switch to reloaded profiles between two frames.
+  ProfileSet *profiles = _pendingProfiles.exchange(nullptr, std::memory_order_acquire);
+  if (profiles != nullptr)
   {
-    setXboxClickState(CONFIG_OSK);
-    if (_xboxClickIsDown[CONFIG_OSK])
-    {
-      // Get the otk window
-      HWND otk_win = getOskWindow();
-      if (otk_win == NULL)
-      {
-        printf("Please start the On-screen keyboard first\n");
-      }
-      else if(IsIconic(otk_win))
-      {
-        ShowWindow(otk_win, SW_RESTORE);
-      }
-      else
-      {
-        ShowWindow(otk_win, SW_MINIMIZE);
-      }
-    }
+    applyProfiles(*profiles);
+    delete profiles;
+    logMessage(LOG_INFO, "Reloaded config.ini\n");
   }
 
-  // Will change between the current speed values
-  setXboxClickState(CONFIG_SPEED_CHANGE);
-  if (_xboxClickIsDown[CONFIG_SPEED_CHANGE])
+  // Only this thread can join MMCSS or change its own power throttling. Settings that fail are
+  // tried again on the next reload rather than on every frame.
+  if (_loopRetune)
   {
-    const int CHANGE_SPEED_VIBRATION_INTENSITY = 65000;   // Speed of the vibration motors when changing cursor speed.
-    const int CHANGE_SPEED_VIBRATION_DURATION = 450;      // Duration of the cursor speed change vibration in milliseconds.
-
-    speed_idx++;
-    if (speed_idx >= speeds.size())
+    _loopRetune = false;
+    if (!_loopTuning.apply(_loopSettings))
     {
-      speed_idx = 0;
+      logMessage(LOG_WARNING, "Cannot apply all the scheduling settings to the input thread\n");
     }
-    speed = speeds[speed_idx];
-    printf("Setting speed to %f (%s)...\n", speed, speed_names[speed_idx].c_str());
-    pulseVibrate(CHANGE_SPEED_VIBRATION_DURATION, CHANGE_SPEED_VIBRATION_INTENSITY, CHANGE_SPEED_VIBRATION_INTENSITY);
   }
 
-  // Update all controller keys.
-  handleTriggers(GAMEPAD_TRIGGER_LEFT, GAMEPAD_TRIGGER_RIGHT);
-  if (!GAMEPAD_DPAD_UP.empty())
+  // Follow the program in the foreground. Its profile is already compiled.
+  const int match = _foreground.getMatch();
+  if (match != _profileIndex)
   {
-    mapKeyboard(XINPUT_GAMEPAD_DPAD_UP, GAMEPAD_DPAD_UP);
+    switchProfile(match);
+    logMessage(LOG_INFO, "Using profile %s\n", _profile->process.empty() ? "config.ini" : _profile->process.c_str());
   }
-  if (!GAMEPAD_DPAD_DOWN.empty())
-  {
-    mapKeyboard(XINPUT_GAMEPAD_DPAD_DOWN, GAMEPAD_DPAD_DOWN);
-  }
-  if (!GAMEPAD_DPAD_LEFT.empty())
+
+  InputSample sample;
+  if (_poller.waitForSample(sample))
   {
-    mapKeyboard(XINPUT_GAMEPAD_DPAD_LEFT, GAMEPAD_DPAD_LEFT);
+    handleSample(sample);
   }
-  if (!GAMEPAD_DPAD_RIGHT.empty())
+}
+
+// Description:
+//   Maps one sample of every controller to system inputs and sends them to the sink.
+//     Called by loop for live input, or directly to replay recorded samples.
+//
+// Params:
+//   sample   The controller states to handle
+void Gopher::handleSample(const InputSample &sample)
+{
+  const LONGLONG mappingStart = _poller.now();
+  if (_recorder.isRecording())
   {
-    mapKeyboard(XINPUT_GAMEPAD_DPAD_RIGHT, GAMEPAD_DPAD_RIGHT);
+    _recorder.recordSample(sample);
   }
-  if (!GAMEPAD_START.empty())
+  _currentTimestamp = sample.timestamp;
+  _frameDx = 0.0f;
+  _frameDy = 0.0f;
+  _frameWheelX = 0.0f;
+  _frameWheelY = 0.0f;
+
+  // Release whatever a pad was holding when it was unplugged, so no key or button stays down.
+  const DWORD disconnected = _connectedPads & ~sample.connected;
+  _connectedPads = sample.connected;
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
   {
-    mapKeyboard(XINPUT_GAMEPAD_START, GAMEPAD_START);
+    if (disconnected & (1 << i))
+    {
+      handleDisconnect(_pads[i]);
+      _calibrator.reset(i);
+      _filter.reset(i);
+    }
   }
-  if (!GAMEPAD_BACK.empty())
+
+  // Gestures whose time ran out since the last frame act before this frame's buttons.
+  _timers.advance(sample.timestamp, [this](WheelTimer &timer) { handleGestureTimer(timer); });
+
+  // Center the sticks before anything reads them, saving what was learnt about them.
+  const XINPUT_STATE *states = sample.states;
+  if (_config->STICK_CALIBRATION != 0)
   {
-    mapKeyboard(XINPUT_GAMEPAD_BACK, GAMEPAD_BACK);
+    memcpy(_filteredStates, sample.states, sizeof(_filteredStates));
+    const DWORD calibrated = _calibrator.apply(_filteredStates, sample.connected);
+    states = _filteredStates;
+    for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+    {
+      if (calibrated & (1 << i))
+      {
+        _state.setCalibration(i, _calibrator.getCalibration(i));
+      }
+    }
   }
-  if (!GAMEPAD_LEFT_THUMB.empty())
+
+  // Then smooth them.
+  bool settling = false;
+  if (_filter.isEnabled())
   {
-    mapKeyboard(XINPUT_GAMEPAD_LEFT_THUMB, GAMEPAD_LEFT_THUMB);
+    if (states != _filteredStates)
+    {
+      memcpy(_filteredStates, sample.states, sizeof(_filteredStates));
+    }
+    settling = _filter.apply(_filteredStates, sample.connected, sample.timestamp);
+    states = _filteredStates;
+    if (_filter.getLag() > 0.0f)
+    {
+      _stats.record(STAT_FILTER_LAG, (LONGLONG)(_filter.getLag() * 1000000.0f));
+    }
   }
-  if (!GAMEPAD_RIGHT_THUMB.empty())
+
+  // The sticks and triggers of every pad are processed together.
+  processAnalog(states, _profile->analog, _analog);
+
+  // Keep receiving unchanged states while a held stick or trigger is still moving the cursor or
+  // scrolling, or while a smoothed stick has not caught up with the actual one.
+  const bool active = (_analog.active & sample.connected) != 0 || settling;
+
+  // Map every connected pad. Their events all go into the same batch.
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
   {
-      mapKeyboard(XINPUT_GAMEPAD_RIGHT_THUMB, GAMEPAD_RIGHT_THUMB);
+    if (!(sample.connected & (1 << i)))
+    {
+      continue;
+    }
+
+    _pad = &_pads[i];
+    _padIndex = i;
+    _pad->state = states[i];
+
+    handleFrame();
   }
-  if (!GAMEPAD_LEFT_SHOULDER.empty())
+  // Pending gesture timers need frames to fire in as well.
+  _poller.setActive(active || !_timers.empty());
+
+  // Every event produced by the frame is sent with a single SendInput call.
+  handleCursor();
+  handleWheel();
+
+  const LONGLONG flushStart = _poller.now();
+  const bool injecting = _batch.size() > 0;
+  _batch.flush();
+  const LONGLONG flushEnd = _poller.now();
+
+  _stats.addFrame();
+  _stats.record(STAT_MAPPING, _poller.toMicroseconds(flushStart - mappingStart));
+  if (injecting)
   {
-      mapKeyboard(XINPUT_GAMEPAD_LEFT_SHOULDER, GAMEPAD_LEFT_SHOULDER);
+    _stats.record(STAT_FLUSH, _poller.toMicroseconds(flushEnd - flushStart));
+    _stats.record(STAT_END_TO_END, _poller.toMicroseconds(flushEnd - sample.timestamp));
   }
-  if (!GAMEPAD_RIGHT_SHOULDER.empty())
+}
+
+// Description:
+//   Maps the state of the current pad to system inputs, queueing them on the
+//     frame's input batch.
+void Gopher::handleFrame()
+{
+  // Update the press and release state of every binding in one pass.
+  _pad->bindings.update(_config->bindings, _pad->state.Gamepad.wButtons, _pad->previousButtons, _currentTimestamp);
+  _pad->previousButtons = _pad->state.Gamepad.wButtons;
+
+  // Disable Gopher
+  handleDisableButton();
+  if (_disabled)
   {
-      mapKeyboard(XINPUT_GAMEPAD_RIGHT_SHOULDER, GAMEPAD_RIGHT_SHOULDER);
+    return;
   }
-  if (!GAMEPAD_A.empty())
+
+  // Vibration
+  handleVibrationButton();
+
+  // Mouse functions
+  handleMouseMovement();
+  handleScrolling();
+
+  mapMouseClick(BINDING_MOUSE_LEFT, MOUSEEVENTF_LEFTDOWN, MOUSEEVENTF_LEFTUP);
+  mapMouseClick(BINDING_MOUSE_RIGHT, MOUSEEVENTF_RIGHTDOWN, MOUSEEVENTF_RIGHTUP);
+  mapMouseClick(BINDING_MOUSE_MIDDLE, MOUSEEVENTF_MIDDLEDOWN, MOUSEEVENTF_MIDDLEUP);
+
+  // Hides the console
+  if (_pad->bindings[BINDING_HIDE].isDown)
   {
-      mapKeyboard(XINPUT_GAMEPAD_A, GAMEPAD_A);
+    toggleWindowVisibility();
   }
-  if (!GAMEPAD_B.empty())
+
+  // Toggle the on-screen keyboard
+  if (_pad->bindings[BINDING_OSK].isDown)
   {
-      mapKeyboard(XINPUT_GAMEPAD_B, GAMEPAD_B);
+    // Get the otk window
+    HWND otk_win = getOskWindow();
+    if (otk_win == NULL)
+    {
+      if (_osk.launch())
+      {
+        logMessage(LOG_INFO, "Starting the On-screen keyboard\n");
+      }
+    }
+    else if(IsIconic(otk_win))
+    {
+      ShowWindowAsync(otk_win, SW_RESTORE);
+    }
+    else
+    {
+      ShowWindowAsync(otk_win, SW_MINIMIZE);
+    }
   }
-  if (!GAMEPAD_X.empty())
+
+  // Will change between the current speed values
+  if (_pad->bindings[BINDING_SPEED_CHANGE].isDown)
   {
-      mapKeyboard(XINPUT_GAMEPAD_X, GAMEPAD_X);
+    const int CHANGE_SPEED_VIBRATION_INTENSITY = 65000;   // Speed of the vibration motors when changing cursor speed.
+    const int CHANGE_SPEED_VIBRATION_DURATION = 450;      // Duration of the cursor speed change vibration in milliseconds.
+
+    _profile->speedIndex++;
+    if (_profile->speedIndex >= _config->speeds.size())
+    {
+      _profile->speedIndex = 0;
+    }
+    _profile->compileCursor();
+    _state.setSpeedIndex(_profile->process, _profile->speedIndex);
+    logMessage(LOG_INFO, "Setting speed to %f (%s)...\n", _profile->getSpeed(), _config->speed_names[_profile->speedIndex].c_str());
+    pulseVibrate(CHANGE_SPEED_VIBRATION_DURATION, CHANGE_SPEED_VIBRATION_INTENSITY, CHANGE_SPEED_VIBRATION_INTENSITY);
   }
-  if (!GAMEPAD_Y.empty())
+
+  // Update all controller keys.
+  handleTriggers(_config->GAMEPAD_TRIGGER_LEFT, _config->GAMEPAD_TRIGGER_RIGHT);
+  for (int id = BINDING_FIRST_KEYBOARD; id < BINDING_COUNT; ++id)
   {
-    mapKeyboard(XINPUT_GAMEPAD_Y, GAMEPAD_Y);
+    mapKeyboard((BindingId)id);
   }
 }
 
+// Description:
+//   Gets the rate the main loop is currently polling at.
+//
+// Returns:
+//   The current number of loop iterations per second.
+int Gopher::getCurrentRate() const
+{
+  return _poller.getCurrentRate();
+}
+
+// Description:
+//   Gets the rate the main loop drops to while the controller is idle.
+//
+// Returns:
+//   The idle number of loop iterations per second.
+int Gopher::getIdleRate() const
+{
+  return _config->IDLE_FPS;
+}
+
+// Description:
+//   Gets the latency instrumentation of the input pipeline.
+//
+// Returns:
+//   The stats recorded so far.
+const Stats &Gopher::getStats() const
+{
+  return _stats;
+}
+
 // Description:
 //   Sends a vibration pulse to the controller for a duration of time.
-//     This is a BLOCKING call. Any inputs during the vibration will be IGNORED.
+//     The pulse is played by the controller's haptics engine, so this
+//     returns immediately and replaces any pulse still playing.
 //
 // Params:
 //   duration   The length of time in milliseconds to vibrate for
@@ -362,9 +676,7 @@ void Gopher::pulseVibrate(const int duration, const int l, const int r) const
 {
   if(!_vibrationDisabled)
   {
-    _controller->Vibrate(l, r);
-    Sleep(duration);
-    _controller->Vibrate(0, 0);
+    _pad->controller->Vibrate(HapticEffect(duration, l, r));
   }
 }
 
@@ -372,8 +684,7 @@ void Gopher::pulseVibrate(const int duration, const int l, const int r) const
 //   Toggles the controller mapping after checking for the disable configuration command.
 void Gopher::handleDisableButton()
 {
-  setXboxClickState(CONFIG_DISABLE);
-  if (_xboxClickIsDown[CONFIG_DISABLE])
+  if (_pad->bindings[BINDING_DISABLE].isDown)
   {
     int duration = 0;   // milliseconds
     int intensity = 0;  // vibration intensity
@@ -386,33 +697,11 @@ void Gopher::handleDisableButton()
       duration = 400;
       intensity = 10000;
 
-      // Release all keys currently pressed by the Gopher mapping.
-      std::vector<WORD> keyboardEvents;
-      while (!_pressedKeys.empty())
+      // Release all keys currently pressed by the Gopher mapping, on every pad.
+      for (PadState &pad : _pads)
       {
-        WORD keyEvent = _pressedKeys.front();
-
-        // Handle mouse buttons
-        // TODO: support mouse X1 and X2 buttons
-        switch (keyEvent)
-        {
-        case VK_LBUTTON:
-          mouseEvent(MOUSEEVENTF_LEFTUP);
-          break;
-        case VK_RBUTTON:
-          mouseEvent(MOUSEEVENTF_RIGHTUP);
-          break;
-        case VK_MBUTTON:
-          mouseEvent(MOUSEEVENTF_MIDDLEUP);
-          break;
-        default:
-          keyboardEvents.push_back(keyEvent);
-        }
-
-        _pressedKeys.pop_front();
+        releasePressedKeys(pad);
       }
-
-      if (!keyboardEvents.empty()) inputKeyboardUp(keyboardEvents);
     }
     else
     {
@@ -420,21 +709,108 @@ void Gopher::handleDisableButton()
       intensity = 65000;
     }
 
+    _state.setToggles(_disabled, _vibrationDisabled, _hidden);
     pulseVibrate(duration, intensity, intensity);
   }
 }
 
+// Description:
+//   Resets the mapping state of a pad that was unplugged, and stops its vibration.
+//
+// Params:
+//   pad  The pad that was disconnected
+void Gopher::handleDisconnect(PadState &pad)
+{
+  releasePad(pad);
+  pad.controller->StopVibration();
+}
+
+// Description:
+//   Releases the held keys, mouse buttons and trigger keys of a pad and resets its binding
+//     state, so the buttons it still holds count as new presses on the next frame.
+//
+// Params:
+//   pad  The pad to reset
+void Gopher::releasePad(PadState &pad)
+{
+  releasePressedKeys(pad);
+
+  if (pad.lTriggerPrevious)
+  {
+    inputKeyboardUp(_config->GAMEPAD_TRIGGER_LEFT);
+  }
+  if (pad.rTriggerPrevious)
+  {
+    inputKeyboardUp(_config->GAMEPAD_TRIGGER_RIGHT);
+  }
+
+  pad.lTriggerPrevious = false;
+  pad.rTriggerPrevious = false;
+  pad.previousButtons = 0;
+  pad.bindings.reset();
+}
+
+// Description:
+//   Releases every key and mouse button a pad is holding down.
+//
+// Params:
+//   pad  The pad whose pressed keys to release
+void Gopher::releasePressedKeys(PadState &pad)
+{
+  // Gestures still waiting to send keys are dropped.
+  for (GestureState &gesture : pad.gestures)
+  {
+    _timers.cancel(gesture.timer);
+    gesture.phase = GESTURE_IDLE;
+  }
+
+  // Handle mouse buttons
+  // TODO: support mouse X1 and X2 buttons
+  for (const WORD key : pad.pressedKeys)
+  {
+    switch (key)
+    {
+    case VK_LBUTTON:
+      mouseEvent(MOUSEEVENTF_LEFTUP);
+      break;
+    case VK_RBUTTON:
+      mouseEvent(MOUSEEVENTF_RIGHTUP);
+      break;
+    case VK_MBUTTON:
+      mouseEvent(MOUSEEVENTF_MIDDLEUP);
+      break;
+    }
+  }
+
+  for (const WORD key : pad.pressedKeys)
+  {
+    if (key != VK_LBUTTON && key != VK_RBUTTON && key != VK_MBUTTON)
+    {
+      _batch.keyboard(key, KEYEVENTF_KEYUP);
+    }
+  }
+
+  pad.pressedKeys.clear();
+}
+
 // Description:
 //   Toggles the vibration support after checking for the diable vibration command. 
-//   This function will BLOCK to prevent rapidly toggling the vibration.
+//   Presses within a second of the last toggle are ignored to prevent rapidly toggling the vibration.
 void Gopher::handleVibrationButton()
 {
-  setXboxClickState(CONFIG_DISABLE_VIBRATION);
-  if (_xboxClickIsDown[CONFIG_DISABLE_VIBRATION])
+  const LONGLONG TOGGLE_INTERVAL = 1000000;  // microseconds
+
+  if (_pad->bindings[BINDING_DISABLE_VIBRATION].isDown &&
+      _poller.toMicroseconds(_currentTimestamp - _vibrationToggleTime) >= TOGGLE_INTERVAL)
   {
+    _vibrationToggleTime = _currentTimestamp;
     _vibrationDisabled = !_vibrationDisabled;
-    printf("Vibration %s\n", _vibrationDisabled ? "Disabled" : "Enabled");
-    Sleep(1000);
+    if (_vibrationDisabled)
+    {
+      _pad->controller->StopVibration();
+    }
+    _state.setToggles(_disabled, _vibrationDisabled, _hidden);
+    logMessage(LOG_INFO, "Vibration %s\n", _vibrationDisabled ? "Disabled" : "Enabled");
   }
 }
 
@@ -443,7 +819,8 @@ void Gopher::handleVibrationButton()
 void Gopher::toggleWindowVisibility()
 {
   _hidden = !_hidden;
-  printf("Window %s\n", _hidden ? "hidden" : "unhidden");
+  _state.setToggles(_disabled, _vibrationDisabled, _hidden);
+  logMessage(LOG_INFO, "Window %s\n", _hidden ? "hidden" : "unhidden");
   setWindowVisibility(_hidden);
 }
 
@@ -465,140 +842,133 @@ int sgn(T val)
 }
 
 // Description:
-//   Determines if the thumbstick value is valid and converts it to a float.
-//
-// Params:
-//   t  Analog thumbstick value to check and convert
-//
-// Returns:
-//   If the value is valid, t will be returned as-is as a float. If the value is 
-//     invalid, 0 will be returned.
-float Gopher::getDelta(short t)
+//   Adds the current pad's cursor motion to the frame, as computed by the analog kernel.
+void Gopher::handleMouseMovement()
 {
-  //filter non-32768 and 32767, wireless ones can glitch sometimes and send it to the edge of the screen, it'll toss out some HUGE integer even when it's centered
-  if (t > 32767) t = 0;
-  if (t < -32768) t = 0;
-
-  return t;
+  _frameDx += _analog.cursorX[_padIndex];
+  _frameDy += _analog.cursorY[_padIndex];
 }
 
 // Description:
-//   Calculates a multiplier for an analog thumbstick based on the update rate.
-//
-// Params:
-//   tValue     The thumbstick value
-//   deadzone   The dead zone to use for this thumbstick
-//   accel      An exponent to use to create an input curve (Optional). 0 to use a linear input
-//   
-// Returns:
-//   Multiplier used to properly scale the given thumbstick value.
-float Gopher::getMult(float lengthsq, float deadzone, float accel = 0.0f)
+//   Moves the cursor by the motion all pads requested during the frame.
+void Gopher::handleCursor()
 {
-  // Normalize the thumbstick value.
-  float mult = (sqrt(lengthsq) - deadzone) / (MAXSHORT - deadzone);
-
-  // Apply a curve to the normalized thumbstick value.
-  if (accel > 0.0001f)
+  if (_frameDx == 0.0f && _frameDy == 0.0f)
   {
-    mult = pow(mult, accel);
+    return;
   }
-  return mult / FPS;
-}
 
-// Description:
-//   Controls the mouse cursor movement by reading the left thumbstick.
-void Gopher::handleMouseMovement()
-{
-  POINT cursor;
-  GetCursorPos(&cursor);
-
-  short tx;
-  short ty;
-
-  if (SWAP_THUMBSTICKS == 0)
+  if (_config->CURSOR_MODE == 1)
   {
-    // Use left stick
-    tx = _currentState.Gamepad.sThumbLX;
-    ty = _currentState.Gamepad.sThumbLY;
-  }
-  else
-  {
-    // Use right stick
-    tx = _currentState.Gamepad.sThumbRX;
-    ty = _currentState.Gamepad.sThumbRY;
+    // Relative mode: accumulate sub-pixel motion and only send whole pixels.
+    float x = _xRest + _frameDx;
+    float y = _yRest - _frameDy;
+    int moveX = (int)x;
+    int moveY = (int)y;
+    _xRest = x - moveX;
+    _yRest = y - moveY;
+
+    if (moveX != 0 || moveY != 0)
+    {
+      _batch.move(moveX, moveY, _config->CURSOR_NOCOALESCE ? MOUSEEVENTF_MOVE_NOCOALESCE : 0);
+    }
+    return;
   }
 
+  // Absolute mode: position the cursor relative to where it currently is.
+  POINT cursor;
+  _sink->getCursorPos(cursor);
+
   float x = cursor.x + _xRest;
   float y = cursor.y + _yRest;
 
-  float dx = 0;
-  float dy = 0;
-
-  // Handle dead zone
-  float lengthsq = tx * tx + ty * ty;
-  if (lengthsq > DEAD_ZONE * DEAD_ZONE)
-  {
-    float mult = speed * getMult(lengthsq, DEAD_ZONE, acceleration_factor);
-
-    dx = getDelta(tx) * mult;
-    dy = getDelta(ty) * mult;
-  }
-
-  x += dx;
+  x += _frameDx;
   _xRest = x - (float)((int)x);
 
-  y -= dy;
+  y -= _frameDy;
   _yRest = y - (float)((int)y);
 
-  SetCursorPos((int)x, (int)y); //after all click input processing
+  if ((int)x != cursor.x || (int)y != cursor.y)
+  {
+    _batch.moveTo((int)x, (int)y);
+  }
 }
 
 // Description:
-//   Controls the scroll wheel movement by reading the right thumbstick.
+//   Adds the current pad's scrolling to the frame, as computed by the analog kernel from the
+//     scroll stick and the triggers used for scrolling.
 void Gopher::handleScrolling()
 {
-  float tx;
-  float ty;
-  
-  if (SWAP_THUMBSTICKS == 0)
+  _frameWheelX += _analog.wheelX[_padIndex];
+  _frameWheelY += _analog.wheelY[_padIndex];
+}
+
+// Description:
+//   Scrolls by the wheel motion all pads requested during the frame. Fractions of a wheel
+//     step are carried over to the next frame while the scrolling goes on, so slow scrolling
+//     still moves and frames below a step send nothing.
+void Gopher::handleWheel()
+{
+  // Leftovers of a scroll that ended would otherwise send a whole notch on the next nudge.
+  if (_frameWheelY == 0.0f)
   {
-    // Use right stick
-    tx = getDelta(_currentState.Gamepad.sThumbRX);
-    ty = getDelta(_currentState.Gamepad.sThumbRY);
+    _wheelRestY = 0.0f;
   }
-  else
+  if (_frameWheelX == 0.0f)
   {
-    // Use left stick
-    tx = getDelta(_currentState.Gamepad.sThumbLX);
-    ty = getDelta(_currentState.Gamepad.sThumbLY);
+    _wheelRestX = 0.0f;
   }
 
-  // Handle dead zone
-  float magnitude = sqrt(tx * tx + ty * ty);
+  emitWheel(MOUSEEVENTF_WHEEL, _frameWheelY, _wheelRestY);
+  emitWheel(MOUSEEVENTF_HWHEEL, _frameWheelX, _wheelRestX);
+}
 
-  if (magnitude > SCROLL_DEAD_ZONE)
+// Description:
+//   Adds motion to one wheel axis and sends the whole steps accumulated.
+//
+// Params:
+//   flag     MOUSEEVENTF_WHEEL or MOUSEEVENTF_HWHEEL
+//   amount   Wheel units requested this frame
+//   rest     The fraction of a step carried over on this axis
+void Gopher::emitWheel(DWORD flag, float amount, float &rest)
+{
+  // A change of direction drops what was left over from the other way.
+  if ((amount > 0.0f && rest < 0.0f) || (amount < 0.0f && rest > 0.0f))
+  {
+    rest = 0.0f;
+  }
+
+  // Notched mode only sends whole WHEEL_DELTA notches, for programs that ignore partial ones.
+  const float step = _config->SCROLL_NOTCHED ? (float)WHEEL_DELTA : 1.0f;
+  const float total = rest + amount;
+  const int steps = (int)(total / step);
+  rest = total - steps * step;
+
+  if (steps != 0)
   {
-    mouseEvent(MOUSEEVENTF_HWHEEL, tx * getMult(tx * tx, SCROLL_DEAD_ZONE) * SCROLL_SPEED);
-    mouseEvent(MOUSEEVENTF_WHEEL, ty * getMult(ty * ty, SCROLL_DEAD_ZONE) * SCROLL_SPEED);
+    mouseEvent(flag, (DWORD)(steps * (int)step));
   }
 }
 
 // Description:
 //   Handles the trigger-to-key mapping. The triggers are handled separately since
-//     they are analog instead of a simple button press.
+//     they are analog instead of a simple button press. A trigger is pressed above
+//     TRIGGER_DEAD_ZONE and only released again at or below TRIGGER_RELEASE_ZONE.
 //
 // Params:
 //   lKey   The mapped key for the left trigger
 //   rKey   The mapped key for the right trigger
-void Gopher::handleTriggers(std::vector<WORD> lKey, std::vector<WORD> rKey)
+void Gopher::handleTriggers(const KeyChord &lKey, const KeyChord &rKey)
 {
-  bool lTriggerIsDown = _currentState.Gamepad.bLeftTrigger > TRIGGER_DEAD_ZONE;
-  bool rTriggerIsDown = _currentState.Gamepad.bRightTrigger > TRIGGER_DEAD_ZONE;
+  const BYTE lThreshold = _pad->lTriggerPrevious ? _config->TRIGGER_RELEASE_ZONE : _config->TRIGGER_DEAD_ZONE;
+  const BYTE rThreshold = _pad->rTriggerPrevious ? _config->TRIGGER_RELEASE_ZONE : _config->TRIGGER_DEAD_ZONE;
+  bool lTriggerIsDown = _pad->state.Gamepad.bLeftTrigger > lThreshold;
+  bool rTriggerIsDown = _pad->state.Gamepad.bRightTrigger > rThreshold;
 
   // Handle left trigger
-  if (lTriggerIsDown != _lTriggerPrevious)
+  if (lTriggerIsDown != _pad->lTriggerPrevious)
   {
-    _lTriggerPrevious = lTriggerIsDown;
+    _pad->lTriggerPrevious = lTriggerIsDown;
     if (lTriggerIsDown)
     {
       inputKeyboardDown(lKey);
@@ -610,9 +980,9 @@ void Gopher::handleTriggers(std::vector<WORD> lKey, std::vector<WORD> rKey)
   }
 
   // Handle right trigger
-  if (rTriggerIsDown != _rTriggerPrevious)
+  if (rTriggerIsDown != _pad->rTriggerPrevious)
   {
-    _rTriggerPrevious = rTriggerIsDown;
+    _pad->rTriggerPrevious = rTriggerIsDown;
     if (rTriggerIsDown)
     {
       inputKeyboardDown(rKey);
@@ -625,129 +995,179 @@ void Gopher::handleTriggers(std::vector<WORD> lKey, std::vector<WORD> rKey)
 }
 
 // Description:
-//   Handles the state of a controller button press.
+//   Presses or releases the keys of a keyboard binding. A binding with hold or double tap
+//     keys waits until its gesture is known; a binding in TURBO_BUTTONS starts repeating.
 //
 // Params:
-//   STATE  The Gopher state, or command, to update
-void Gopher::setXboxClickState(DWORD STATE)
+//   id     The keyboard binding to trigger key events for
+void Gopher::mapKeyboard(BindingId id)
 {
-  _xboxClickIsDown[STATE] = false;
-  _xboxClickIsUp[STATE] = false;
+  const Binding &binding = _pad->bindings[id];
+  GestureState &gesture = _pad->gestures[id];
+  const LONGLONG frequency = _timers.getFrequency();
 
-  if (!this->xboxClickStateExists(STATE))
+  if (binding.isDown)
   {
-    _xboxClickStateLastIteration[STATE] = false;
+    if (gesture.phase == GESTURE_TAPPED)
+    {
+      // Second tap within DOUBLE_TAP_TIME.
+      _timers.cancel(gesture.timer);
+      pressKeys(_config->doubleKeys[id]);
+      gesture.phase = GESTURE_DOUBLE;
+    }
+    else if (!_config->holdKeys[id].empty() || !_config->doubleKeys[id].empty())
+    {
+      gesture.phase = GESTURE_PRESSED;
+      if (!_config->holdKeys[id].empty())
+      {
+        _timers.schedule(gesture.timer, _currentTimestamp + frequency * _config->HOLD_TIME / 1000);
+      }
+    }
+    else
+    {
+      pressKeys(_config->bindingKeys[id]);
+      gesture.phase = GESTURE_DOWN;
+      if (_config->bindings.getMask(id) & _config->TURBO_BUTTONS)
+      {
+        _timers.schedule(gesture.timer, _currentTimestamp + frequency / _config->TURBO_RATE);
+      }
+    }
   }
 
-  bool isDown = (_currentState.Gamepad.wButtons & STATE) == STATE;
-
-  // Detect if the button has been pressed.
-  if (isDown && !_xboxClickStateLastIteration[STATE])
+  if (binding.isUp)
   {
-    _xboxClickStateLastIteration[STATE] = true;
-    _xboxClickIsDown[STATE] = true;
-    _xboxClickDownLength[STATE] = 0;
-    _xboxClickIsDownLong[STATE] = false;
+    _timers.cancel(gesture.timer);
+
+    switch (gesture.phase)
+    {
+    case GESTURE_DOWN:
+      releaseKeys(_config->bindingKeys[id]);
+      gesture.phase = GESTURE_IDLE;
+      break;
+    case GESTURE_PRESSED:
+      // Released before HOLD_TIME. Wait for a second tap if there is anything to send for it.
+      if (!_config->doubleKeys[id].empty())
+      {
+        gesture.phase = GESTURE_TAPPED;
+        _timers.schedule(gesture.timer, _currentTimestamp + frequency * _config->DOUBLE_TAP_TIME / 1000);
+      }
+      else
+      {
+        inputKeyboardDown(_config->bindingKeys[id]);
+        inputKeyboardUp(_config->bindingKeys[id]);
+        gesture.phase = GESTURE_IDLE;
+      }
+      break;
+    case GESTURE_HOLDING:
+      releaseKeys(_config->holdKeys[id]);
+      gesture.phase = GESTURE_IDLE;
+      break;
+    case GESTURE_DOUBLE:
+      releaseKeys(_config->doubleKeys[id]);
+      gesture.phase = GESTURE_IDLE;
+      break;
+    default:
+      break;
+    }
   }
+}
 
-  // Detect if the button has been held as a long press.
-  if (isDown && _xboxClickStateLastIteration[STATE])
+// Description:
+//   Handles an expired gesture timer: a hold reaching HOLD_TIME, a single tap that was not
+//     followed by a second one, or the next turbo repeat.
+//
+// Params:
+//   timer  The timer of the gesture, identifying its pad and binding
+void Gopher::handleGestureTimer(WheelTimer &timer)
+{
+  _pad = &_pads[timer.cookie / BINDING_COUNT];
+  const BindingId id = (BindingId)(timer.cookie % BINDING_COUNT);
+  GestureState &gesture = _pad->gestures[id];
+
+  switch (gesture.phase)
   {
-    const int LONG_PRESS_TIME = 200;  // milliseconds
+  case GESTURE_PRESSED:
+    pressKeys(_config->holdKeys[id]);
+    gesture.phase = GESTURE_HOLDING;
+    break;
+  case GESTURE_TAPPED:
+    inputKeyboardDown(_config->bindingKeys[id]);
+    inputKeyboardUp(_config->bindingKeys[id]);
+    gesture.phase = GESTURE_IDLE;
+    break;
+  case GESTURE_DOWN:
+  {
+    inputKeyboardUp(_config->bindingKeys[id]);
+    inputKeyboardDown(_config->bindingKeys[id]);
 
-    ++_xboxClickDownLength[STATE];
-    if (_xboxClickDownLength[STATE] * SLEEP_AMOUNT > LONG_PRESS_TIME)
+    // Repeats keep to the rate even when a frame is late; repeats skipped by a long stall are dropped.
+    const LONGLONG period = _timers.getFrequency() / _config->TURBO_RATE;
+    LONGLONG next = timer.deadline + period;
+    if (next <= _currentTimestamp)
     {
-      _xboxClickIsDownLong[STATE] = true;
+      next = _currentTimestamp + period;
     }
+    _timers.schedule(timer, next);
+    break;
   }
-
-  // Detect if the button has been released.
-  if (!isDown && _xboxClickStateLastIteration[STATE])
-  {
-    _xboxClickStateLastIteration[STATE] = false;
-    _xboxClickIsUp[STATE] = true;
-    _xboxClickIsDownLong[STATE] = false;
+  default:
+    break;
   }
-
-  _xboxClickStateLastIteration[STATE] = isDown;
 }
 
 // Description:
-//   Check to see if a controller state exists in Gopher's button map.
+//   Presses keys and adds them to the keys held by the current pad.
 //
 // Params:
-//   xinput   The Gopher state, or command, to search for
-//
-// Returns:
-//   true if the state is present in the map.
-bool Gopher::xboxClickStateExists(DWORD STATE)
+//   keys   The keys to press
+void Gopher::pressKeys(const KeyChord &keys)
 {
-  auto it = _xboxClickStateLastIteration.find(STATE);
-  if (it == _xboxClickStateLastIteration.end())
-  {
-    return false;
-  }
-
-  return true;
+  inputKeyboardDown(keys);
+  for (const WORD key : keys) _pad->pressedKeys.push_back(key);
 }
 
 // Description:
-//   Presses or releases a key based on a mapped Gopher state.
+//   Releases keys and removes them from the keys held by the current pad.
 //
 // Params:
-//   STATE  The Gopher state, or command, to trigger a key event
-//   key    The key value to input to the system
-void Gopher::mapKeyboard(DWORD STATE, std::vector<WORD> keys)
+//   keys   The keys to release
+void Gopher::releaseKeys(const KeyChord &keys)
 {
-  setXboxClickState(STATE);
-  if (_xboxClickIsDown[STATE])
-  {
-    inputKeyboardDown(keys);
-
-    // Add key to the list of pressed keys.
-    for (const WORD key : keys) _pressedKeys.push_back(key);
-  }
-
-  if (_xboxClickIsUp[STATE])
-  {
-    inputKeyboardUp(keys);
-
-    // Remove key from the list of pressed keys.
-    for (const WORD key : keys) erasePressedKey(key);
-  }
+  inputKeyboardUp(keys);
+  for (const WORD key : keys) erasePressedKey(key);
 }
 
 // Description:
-//   Presses or releases a mouse button based on a mapped Gopher state
+//   Presses or releases a mouse button based on a mouse binding
 //
 // Params:
-//   STATE    The Gopher state, or command, to trigger a mouse event
+//   id       The mouse binding to trigger a mouse event for
 //   keyDown  The button down event for a mouse event
 //   keyUp    The button up event for a mouse event
-void Gopher::mapMouseClick(DWORD STATE, DWORD keyDown, DWORD keyUp)
+void Gopher::mapMouseClick(BindingId id, DWORD keyDown, DWORD keyUp)
 {
-  setXboxClickState(STATE);
-  if (_xboxClickIsDown[STATE])
+  const Binding &binding = _pad->bindings[id];
+
+  if (binding.isDown)
   {
     mouseEvent(keyDown);
 
     // Add key to the list of pressed keys.
     if (keyDown == MOUSEEVENTF_LEFTDOWN)
     {
-      _pressedKeys.push_back(VK_LBUTTON);
+      _pad->pressedKeys.push_back(VK_LBUTTON);
     }
     else if (keyDown == MOUSEEVENTF_RIGHTDOWN)
     {
-      _pressedKeys.push_back(VK_RBUTTON);
+      _pad->pressedKeys.push_back(VK_RBUTTON);
     }
     else if (keyDown == MOUSEEVENTF_MIDDLEDOWN)
     {
-      _pressedKeys.push_back(VK_MBUTTON);
+      _pad->pressedKeys.push_back(VK_MBUTTON);
     }
   }
 
-  if (_xboxClickIsUp[STATE])
+  if (binding.isUp)
   {
     mouseEvent(keyUp);
 
@@ -765,35 +1185,6 @@ void Gopher::mapMouseClick(DWORD STATE, DWORD keyDown, DWORD keyUp)
       erasePressedKey(VK_MBUTTON);
     }
   }
-
-  /*if (_xboxClickIsDownLong[STATE])
-  {
-    mouseEvent(keyDown | keyUp);
-    mouseEvent(keyDown | keyUp);
-  }*/
-}
-
-// Description:
-//   Callback function used for the EnumWindows call to determine if we
-//     have found the On-Screen Keyboard window.
-//
-// Params:
-//   curWnd   The current window to check
-//   lParam   A callback parameter used to store the window if it is found
-//
-// Returns:
-//   FALSE when the the desired window is found.
-static BOOL CALLBACK EnumWindowsProc(HWND curWnd, LPARAM lParam)
-{
-  TCHAR title[256];
-  // Check to see if the window title matches what we are looking for.
-  if (GetWindowText(curWnd, title, 256) && !_tcscmp(title, _T("On-Screen Keyboard")))
-  {
-    *(HWND*)lParam = curWnd;
-    return FALSE;  // Correct window found, stop enumerating through windows.
-  }
-
-  return TRUE;
 }
 
 // Description:
@@ -803,9 +1194,7 @@ static BOOL CALLBACK EnumWindowsProc(HWND curWnd, LPARAM lParam)
 //   If found, the handle to the On-Screen Keyboard handle. Otherwise, returns NULL.
 HWND Gopher::getOskWindow()
 {
-  HWND ret = NULL;
-  EnumWindows(EnumWindowsProc, (LPARAM)&ret);
-  return ret;
+  return _osk.getWindow();
 }
 
 // Description:
@@ -818,16 +1207,5 @@ HWND Gopher::getOskWindow()
 //   True if the given key was found and removed from the list.
 bool Gopher::erasePressedKey(WORD key)
 {
-  for (std::list<WORD>::iterator it = _pressedKeys.begin();
-       it != _pressedKeys.end();
-       ++it)
-  {
-    if (*it == key)
-    {
-      _pressedKeys.erase(it);
-      return true;
-    }
-  }
-
-  return false;
+  return _pad->pressedKeys.erase(key);
 }
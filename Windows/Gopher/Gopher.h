@@ -1,7 +1,7 @@
 #include <windows.h> // for Beep()
 #include <iostream>
 #include <vector>
-#include <list>
+#include <atomic>
 #include <xinput.h> // controller
 #include <stdio.h> // for printf
 #include <cmath> // for abs()
@@ -10,104 +10,152 @@
 #include <tchar.h>
 #include <ShlObj.h>
 
-#include <map>
-
-#include "CXBOXController.h"
+#include "AnalogKernel.h"
+#include "BindingTable.h"
+#include "ConfigProfile.h"
+#include "ConfigWatcher.h"
+#include "ControllerBackend.h"
+#include "ForegroundWatcher.h"
+#include "GopherConfig.h"
+#include "InputBatch.h"
+#include "InputPoller.h"
+#include "InputSink.h"
+#include "KeyList.h"
+#include "Log.h"
+#include "OskTracker.h"
+#include "ResponseCurve.h"
+#include "RuntimeState.h"
+#include "Stats.h"
+#include "StickCalibrator.h"
+#include "StickFilter.h"
+#include "ThreadTuning.h"
+#include "TimerWheel.h"
+#include "TraceRecorder.h"
 
 #pragma once
+
+// Keys and mouse buttons held down by one pad. A key held by two bindings is listed twice. Large
+// enough for every binding to hold a full chord, so it never fills up.
+typedef KeyList<BINDING_COUNT * CHORD_CAPACITY> PressedKeys;
+
+// Where a keyboard binding is in recognizing a tap, hold, double tap or turbo press.
+enum GesturePhase
+{
+  GESTURE_IDLE,       // Not pressed.
+  GESTURE_DOWN,       // Pressed; its keys are held, and repeat when the button is a turbo button.
+  GESTURE_PRESSED,    // Pressed; waiting to see whether it is a tap or a hold.
+  GESTURE_HOLDING,    // Held past HOLD_TIME; its hold keys are held.
+  GESTURE_TAPPED,     // Tapped once; waiting for a second tap.
+  GESTURE_DOUBLE,     // Tapped twice; its double tap keys are held.
+};
+
+struct GestureState
+{
+  GesturePhase phase = GESTURE_IDLE;
+  WheelTimer timer;                   // Hold deadline, end of the double tap time or next turbo repeat.
+};
+
+// Mapping state of one controller. Every connected pad is mapped independently; their output
+// is merged into the same frame.
+struct PadState
+{
+  IController* controller = nullptr;
+  XINPUT_STATE state;                 // State of the pad in the frame being handled.
+  BindingState bindings;              // What the pad pressed of the bindings of the profile in use.
+  WORD previousButtons = 0;           // wButtons of the last handled frame.
+  bool lTriggerPrevious = false;      // Previous state of the left trigger.
+  bool rTriggerPrevious = false;      // Previous state of the right trigger.
+  PressedKeys pressedKeys;            // Keys and mouse buttons currently held down by this pad.
+  GestureState gestures[BINDING_COUNT];  // Gestures of the keyboard bindings.
+};
+
 class Gopher
 {
 private:
-  int DEAD_ZONE = 6000;                 // Thumbstick dead zone to use for mouse movement. Absolute maximum shall be 65534.
-  int SCROLL_DEAD_ZONE = 5000;          // Thumbstick dead zone to use for scroll wheel movement. Absolute maximum shall be 65534.
-  int TRIGGER_DEAD_ZONE = 0;            // Dead zone for the left and right triggers to detect a trigger press. 0 means that any press to trigger will be read as a button press.
-  float SCROLL_SPEED = 0.1f;             // Speed at which you scroll.
-  const int FPS = 150;                  // Update rate of the main Gopher loop. Interpreted as cycles-per-second.
-  const int SLEEP_AMOUNT = 1000 / FPS;  // Number of milliseconds to sleep per iteration.
-  int SWAP_THUMBSTICKS = 0;             // Swaps the function of the thumbsticks when not equal to 0.
-
-  XINPUT_STATE _currentState;
-
-  // Cursor speed settings
-  const float SPEED_ULTRALOW = 0.005f;
-  const float SPEED_LOW = 0.015f;
-  const float SPEED_MED = 0.025f;
-  const float SPEED_HIGH = 0.04f;
-  float speed = SPEED_MED;
-  float acceleration_factor = 0.0f;
+  ProfileSet _profileSet;                         // config.ini and the per-program profiles.
+  ConfigProfile* _profile = nullptr;              // The profile in use.
+  const GopherConfig* _config = nullptr;          // Settings of the profile in use.
+  int _profileIndex = -1;                         // Foreground match _profile was chosen for. -1 for config.ini.
+  std::atomic<ProfileSet*> _pendingProfiles{ nullptr };  // Reloaded profiles waiting for the next frame boundary.
+  std::atomic<bool> _running{ true };             // Cleared by stop to end the loop.
+  bool _session = true;                           // false when loadConfigFile was asked for the mapping settings only.
+  SRWLOCK _reloadLock = SRWLOCK_INIT;             // Keeps the two config watchers from reloading at the same time.
+
+  PadState _pads[XUSER_MAX_COUNT];
+  PadState* _pad = nullptr;         // The pad whose state is being handled.
+  DWORD _padIndex = 0;              // Slot of _pad.
+  DWORD _connectedPads = 0;         // Connected mask of the last handled sample.
+  LONGLONG _currentTimestamp = 0;   // Performance counter value at which the current frame was polled.
+  float _frameDx = 0.0f;            // Cursor motion requested by all pads during the current frame.
+  float _frameDy = 0.0f;
+  float _frameWheelX = 0.0f;        // Wheel motion requested by all pads during the current frame.
+  float _frameWheelY = 0.0f;
+
+  AnalogFrame _analog;                // Stick and trigger outputs of every pad in the current frame.
+  StickCalibrator _calibrator;        // Centers the sticks when STICK_CALIBRATION is set.
+  StickFilter _filter;                // Smooths the sticks when FILTER_MIN_CUTOFF is set.
+  XINPUT_STATE _filteredStates[XUSER_MAX_COUNT];  // The current sample with calibrated and smoothed sticks.
 
   float _xRest = 0.0f;
   float _yRest = 0.0f;
+  float _wheelRestX = 0.0f;         // Fractions of a wheel step not sent yet.
+  float _wheelRestY = 0.0f;
 
   bool _disabled = false;           // Disables the Gopher controller mapping.
   bool _vibrationDisabled = false;  // Prevents Gopher from producing controller vibrations. 
   bool _hidden = false;             // Gopher main window visibility.
-  bool _lTriggerPrevious = false;   // Previous state of the left trigger.
-  bool _rTriggerPrevious = false;   // Previous state of the right trigger.
-
-  std::vector<float> speeds;	            // Contains actual speeds to choose
-  std::vector<std::string> speed_names;   // Contains display names of speeds to display
-  unsigned int speed_idx = 0;
-
-  // Mouse Clicks
-  WORD CONFIG_MOUSE_LEFT = NULL;
-  WORD CONFIG_MOUSE_RIGHT = NULL;
-  WORD CONFIG_MOUSE_MIDDLE = NULL;
-  
-  // Gopher Settings
-  WORD CONFIG_HIDE = NULL;
-  WORD CONFIG_DISABLE = NULL;
-  WORD CONFIG_DISABLE_VIBRATION = NULL;
-  WORD CONFIG_SPEED_CHANGE = NULL;
-  WORD CONFIG_OSK = NULL;
-
-  // Gamepad bindings
-  std::vector<WORD> GAMEPAD_DPAD_UP = {};
-  std::vector<WORD> GAMEPAD_DPAD_DOWN = {};
-  std::vector<WORD> GAMEPAD_DPAD_LEFT = {};
-  std::vector<WORD> GAMEPAD_DPAD_RIGHT = {};
-  std::vector<WORD> GAMEPAD_START = {};
-  std::vector<WORD> GAMEPAD_BACK = {};
-  std::vector<WORD> GAMEPAD_LEFT_THUMB = {};
-  std::vector<WORD> GAMEPAD_RIGHT_THUMB = {};
-  std::vector<WORD> GAMEPAD_LEFT_SHOULDER = {};
-  std::vector<WORD> GAMEPAD_RIGHT_SHOULDER = {};
-  std::vector<WORD> GAMEPAD_A = {};
-  std::vector<WORD> GAMEPAD_B = {};
-  std::vector<WORD> GAMEPAD_X = {};
-  std::vector<WORD> GAMEPAD_Y = {};
-  std::vector<WORD> GAMEPAD_TRIGGER_LEFT = {};
-  std::vector<WORD> GAMEPAD_TRIGGER_RIGHT = {};
-
-  // Button press state logic variables
-  std::map<DWORD, bool> _xboxClickStateLastIteration;
-  std::map<DWORD, bool> _xboxClickIsDown;
-  std::map<DWORD, bool> _xboxClickIsDownLong;
-  std::map<DWORD, int> _xboxClickDownLength;
-  std::map<DWORD, bool> _xboxClickIsUp;
-
-  std::list<WORD> _pressedKeys;
-
-  CXBOXController* _controller;
+  LONGLONG _vibrationToggleTime = 0; // Time of the last vibration toggle, used to ignore rapid toggling.
+
+  ControllerBackend* _controllers;
+  InputSink* _sink;                 // Receives the generated inputs.
+  Stats _stats;                     // Latency of every stage of the input pipeline.
+  InputPoller _poller;              // Reads the controller on its own thread.
+  TraceRecorder _recorder;          // Records the session when TRACE_FILE is set.
+  RecordingSink _recordingSink;     // Records the generated inputs on their way to _sink.
+  InputBatch _batch;                // System inputs produced by the current frame.
+  TimerWheel _timers;               // Gesture timers of every pad.
+  ConfigWatcher _watcher;           // Reloads config.ini when it changes.
+  ConfigWatcher _profileWatcher;    // Reloads the profiles when one of them changes.
+  ForegroundWatcher _foreground;    // Picks the profile of the program in the foreground.
+  OskTracker _osk;                  // Finds and launches the On-Screen Keyboard.
+  RuntimeState _state;              // Speeds, toggles and calibration kept across sessions.
+  ThreadSettings _loopSettings;     // Scheduling of the thread running loop, applied by its next iteration.
+  bool _loopRetune = false;         // Set when _loopSettings should be applied, or what failed retried.
+  ThreadTuning _loopTuning;         // Only used by the thread running loop.
 
 public:
 
-  Gopher(CXBOXController* controller);
+  Gopher(ControllerBackend* controllers, InputSink* sink);
+  ~Gopher();
+
+  void loadConfigFile(bool session = true);
+
+  void loadState(const std::string &path);
+
+  void start();
+
+  void stop();
+
+  bool isRunning() const;
 
-  void loadConfigFile();
+  void releaseAll();
 
   void loop();
 
+  void handleSample(const InputSample &sample);
+
+  int getCurrentRate() const;
+
+  int getIdleRate() const;
+
+  const Stats &getStats() const;
+
   void pulseVibrate(const int duration, const int l, const int r) const;
 
   void toggleWindowVisibility();
 
   void setWindowVisibility(const bool& hidden) const;
 
-  float getDelta(short tx);
-
-  float getMult(float length, float deadzone, float accel);
-
   void handleMouseMovement();
 
   void handleDisableButton();
@@ -116,19 +164,51 @@ public:
 
   void handleScrolling();
 
-  void handleTriggers(std::vector<WORD> lKey, std::vector<WORD> rKey);
-
-  bool xboxClickStateExists(DWORD xinput);
-
-  void mapKeyboard(DWORD STATE, std::vector<WORD> keys);
+  void handleTriggers(const KeyChord &lKey, const KeyChord &rKey);
 
-  void mapMouseClick(DWORD STATE, DWORD keyDown, DWORD keyUp);
+  void mapKeyboard(BindingId id);
 
-  void setXboxClickState(DWORD state);
+  void mapMouseClick(BindingId id, DWORD keyDown, DWORD keyUp);
 
   HWND getOskWindow();
 
 private:
 
+  void handleFrame();
+
+  void handleCursor();
+
+  void handleWheel();
+
+  void emitWheel(DWORD flag, float amount, float &rest);
+
+  void reloadConfigFile();
+
+  void applyProfiles(ProfileSet &profiles);
+
+  bool restoreSpeed(ConfigProfile &profile) const;
+
+  void switchProfile(int index);
+
+  void releasePad(PadState &pad);
+
+  void releasePressedKeys(PadState &pad);
+
+  void handleDisconnect(PadState &pad);
+
+  void handleGestureTimer(WheelTimer &timer);
+
+  void pressKeys(const KeyChord &keys);
+
+  void releaseKeys(const KeyChord &keys);
+
+  void inputKeyboard(const KeyChord &cmds, DWORD flag);
+
+  void inputKeyboardDown(const KeyChord &cmds);
+
+  void inputKeyboardUp(const KeyChord &cmds);
+
+  void mouseEvent(DWORD dwFlags, DWORD mouseData = 0);
+
   bool erasePressedKey(WORD key);
 };
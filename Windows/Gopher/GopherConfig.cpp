@@ -0,0 +1,364 @@
+#include "GopherConfig.h"
+#include "ConfigCache.h"
+
+#include <xinput.h>
+
+// Description:
+//   Builds the keys of a binding from the config file. Keys set to 0 are left out, and keys
+//     past CHORD_CAPACITY are ignored.
+//
+// Params:
+//   keys   The key codes from the config file
+//
+// Returns:
+//   The keys to send.
+static KeyChord wordsToChord(const std::vector<WORD> &keys)
+{
+  KeyChord chord;
+  for (const WORD key : keys)
+  {
+    if (key != 0)
+    {
+      chord.push_back(key);
+    }
+  }
+  return chord;
+}
+
+// Config keys of the Gopher command bindings.
+static const struct CommandBinding
+{
+  BindingId id;
+  const char *key;
+} COMMAND_BINDINGS[] = {
+  { BINDING_MOUSE_LEFT, "CONFIG_MOUSE_LEFT" },
+  { BINDING_MOUSE_RIGHT, "CONFIG_MOUSE_RIGHT" },
+  { BINDING_MOUSE_MIDDLE, "CONFIG_MOUSE_MIDDLE" },
+  { BINDING_HIDE, "CONFIG_HIDE" },
+  { BINDING_DISABLE, "CONFIG_DISABLE" },
+  { BINDING_DISABLE_VIBRATION, "CONFIG_DISABLE_VIBRATION" },
+  { BINDING_SPEED_CHANGE, "CONFIG_SPEED_CHANGE" },
+  { BINDING_OSK, "CONFIG_OSK" },
+};
+
+// Controller buttons and config keys of the keyboard bindings.
+static const struct KeyboardBinding
+{
+  BindingId id;
+  WORD buttons;
+  const char *key;
+} KEYBOARD_BINDINGS[] = {
+  { BINDING_DPAD_UP, XINPUT_GAMEPAD_DPAD_UP, "GAMEPAD_DPAD_UP" },
+  { BINDING_DPAD_DOWN, XINPUT_GAMEPAD_DPAD_DOWN, "GAMEPAD_DPAD_DOWN" },
+  { BINDING_DPAD_LEFT, XINPUT_GAMEPAD_DPAD_LEFT, "GAMEPAD_DPAD_LEFT" },
+  { BINDING_DPAD_RIGHT, XINPUT_GAMEPAD_DPAD_RIGHT, "GAMEPAD_DPAD_RIGHT" },
+  { BINDING_START, XINPUT_GAMEPAD_START, "GAMEPAD_START" },
+  { BINDING_BACK, XINPUT_GAMEPAD_BACK, "GAMEPAD_BACK" },
+  { BINDING_LEFT_THUMB, XINPUT_GAMEPAD_LEFT_THUMB, "GAMEPAD_LEFT_THUMB" },
+  { BINDING_RIGHT_THUMB, XINPUT_GAMEPAD_RIGHT_THUMB, "GAMEPAD_RIGHT_THUMB" },
+  { BINDING_LEFT_SHOULDER, XINPUT_GAMEPAD_LEFT_SHOULDER, "GAMEPAD_LEFT_SHOULDER" },
+  { BINDING_RIGHT_SHOULDER, XINPUT_GAMEPAD_RIGHT_SHOULDER, "GAMEPAD_RIGHT_SHOULDER" },
+  { BINDING_A, XINPUT_GAMEPAD_A, "GAMEPAD_A" },
+  { BINDING_B, XINPUT_GAMEPAD_B, "GAMEPAD_B" },
+  { BINDING_X, XINPUT_GAMEPAD_X, "GAMEPAD_X" },
+  { BINDING_Y, XINPUT_GAMEPAD_Y, "GAMEPAD_Y" },
+};
+
+// Description:
+//   Reads and parses a configuration file, assigning values to the
+//     configuration variables. Settings missing from the file or set to invalid values keep
+//     their defaults.
+//
+// Params:
+//   path           The config file to read
+//   diagnostics    Receives the problems found in the file
+//   createDefault  Whether to generate a default file if it does not exist
+//
+// Returns:
+//   true if the file was read, false if every setting was left at its default.
+bool GopherConfig::load(const std::string &path, std::vector<ConfigDiagnostic> &diagnostics, bool createDefault)
+{
+  ConfigFile cfg(path, createDefault);
+
+  //--------------------------------
+  // Configuration bindings
+  //--------------------------------
+  bindings.clear();
+  for (const CommandBinding &command : COMMAND_BINDINGS)
+  {
+    // Several values make a sequence of chords pressed one after the other.
+    const std::vector<WORD> steps = cfg.getWords(command.key);
+    bindings.bindSequence(command.id, steps.data(), steps.size());
+  }
+
+  //--------------------------------
+  // Controller bindings
+  //--------------------------------
+  for (const KeyboardBinding &keyboard : KEYBOARD_BINDINGS)
+  {
+    const KeyChord &keys = bindingKeys[keyboard.id] = wordsToChord(cfg.getWords(keyboard.key));
+
+    // Gestures of the same button
+    const std::string key = keyboard.key;
+    const KeyChord &hold = holdKeys[keyboard.id] = wordsToChord(cfg.getWords(key + "_HOLD"));
+    const KeyChord &twice = doubleKeys[keyboard.id] = wordsToChord(cfg.getWords(key + "_DOUBLE"));
+
+    // Buttons set to 0 in the config are left unbound.
+    bindings.bind(keyboard.id, keys.empty() && hold.empty() && twice.empty() ? 0 : keyboard.buttons);
+  }
+
+  GAMEPAD_TRIGGER_LEFT = wordsToChord(cfg.getWords("GAMEPAD_TRIGGER_LEFT"));
+  GAMEPAD_TRIGGER_RIGHT = wordsToChord(cfg.getWords("GAMEPAD_TRIGGER_RIGHT"));
+
+  //--------------------------------
+  // Advanced settings
+  //--------------------------------
+
+  // Acceleration factor
+  acceleration_factor = cfg.getFloat("ACCELERATION_FACTOR");
+
+  // Dead zones
+  DEAD_ZONE = cfg.getInt("DEAD_ZONE");
+  if (DEAD_ZONE == 0)
+  {
+    DEAD_ZONE = 6000;
+  }
+
+  SCROLL_DEAD_ZONE = cfg.getInt("SCROLL_DEAD_ZONE");
+  if (SCROLL_DEAD_ZONE == 0)
+  {
+    SCROLL_DEAD_ZONE = 5000;
+  }
+
+  SCROLL_SPEED = cfg.getFloat("SCROLL_SPEED");
+  if (SCROLL_SPEED < 0.00001f)
+  {
+    SCROLL_SPEED = 0.1f;
+  }
+  SCROLL_NOTCHED = cfg.getInt("SCROLL_NOTCHED");
+
+  // Variable cursor speeds
+  speeds.clear();
+  speed_names.clear();
+  std::string_view cursor_speed = cfg.getString("CURSOR_SPEED");
+  int cur_speed_idx = 1;
+  const float CUR_SPEED_MIN = 0.0001f;
+  const float CUR_SPEED_MAX = 1.0f;
+  while (!cursor_speed.empty())
+  {
+    size_t comma = cursor_speed.find(',');
+    std::string_view cur_speed = cursor_speed.substr(0, comma);
+    cursor_speed.remove_prefix(comma == std::string_view::npos ? cursor_speed.size() : comma + 1);
+
+    std::string cur_name;
+    // Check to see if we are at the string that includes the equals sign.
+    size_t equals = cur_speed.find('=');
+    if (equals != std::string_view::npos)
+    {
+      cur_name = cur_speed.substr(0, equals);
+      cur_speed.remove_prefix(equals + 1);
+    }
+    else
+    {
+      cur_name = std::to_string(cur_speed_idx++);
+    }
+    float cur_speedf;
+    // Ignore speeds that are not numbers or not within the allowed range.
+    if (ConfigFile::parseFloat(cur_speed, cur_speedf) && cur_speedf > CUR_SPEED_MIN && cur_speedf <= CUR_SPEED_MAX)
+    {
+      speeds.push_back(cur_speedf);
+      speed_names.push_back(cur_name);
+    }
+  }
+
+  // If no cursor speeds were defined, add a set of default speeds.
+  if (speeds.size() == 0)
+  {
+    speeds.push_back(0.005f);
+    speeds.push_back(0.015f);
+    speeds.push_back(0.025f);
+    speeds.push_back(0.004f);
+    speed_names.push_back("ULTRALOW");
+    speed_names.push_back("LOW");
+    speed_names.push_back("MED");
+    speed_names.push_back("HIGH");
+  }
+
+  // Update rate
+  FPS = cfg.getInt("FPS");
+  if (FPS <= 0)
+  {
+    FPS = 150;
+  }
+
+  // Idle polling
+  IDLE_FPS = cfg.getInt("IDLE_FPS");
+  if (IDLE_FPS <= 0)
+  {
+    IDLE_FPS = 10;
+  }
+  if (IDLE_FPS > FPS)
+  {
+    IDLE_FPS = FPS;
+  }
+
+  IDLE_TIMEOUT = cfg.getInt("IDLE_TIMEOUT");
+  if (IDLE_TIMEOUT <= 0)
+  {
+    IDLE_TIMEOUT = 5000;
+  }
+
+  // Button sequences
+  SEQUENCE_TIME = cfg.getInt("SEQUENCE_TIME");
+  if (SEQUENCE_TIME <= 0)
+  {
+    SEQUENCE_TIME = 300;
+  }
+  setSequenceWindow();
+
+  // Gestures
+  HOLD_TIME = cfg.getInt("HOLD_TIME");
+  if (HOLD_TIME <= 0)
+  {
+    HOLD_TIME = 500;
+  }
+
+  DOUBLE_TAP_TIME = cfg.getInt("DOUBLE_TAP_TIME");
+  if (DOUBLE_TAP_TIME <= 0)
+  {
+    DOUBLE_TAP_TIME = 250;
+  }
+
+  TURBO_BUTTONS = (WORD)cfg.getInt("TURBO_BUTTONS");
+  TURBO_RATE = cfg.getInt("TURBO_RATE");
+  if (TURBO_RATE <= 0)
+  {
+    TURBO_RATE = 10;
+  }
+
+  // Custom response curves
+  cursorCurvePoints = ResponseCurve::parsePoints(std::string(cfg.getString("CURSOR_CURVE")));
+  scrollCurvePoints = ResponseCurve::parsePoints(std::string(cfg.getString("SCROLL_CURVE")));
+  triggerCurvePoints = ResponseCurve::parsePoints(std::string(cfg.getString("TRIGGER_CURVE")));
+
+  // Triggers. A release value below the press value keeps a trigger resting near the threshold
+  // from toggling every frame.
+  TRIGGER_DEAD_ZONE = cfg.getInt("TRIGGER_DEAD_ZONE");
+  if (TRIGGER_DEAD_ZONE < 0 || TRIGGER_DEAD_ZONE > 254)
+  {
+    TRIGGER_DEAD_ZONE = 0;
+  }
+
+  TRIGGER_RELEASE_ZONE = cfg.getInt("TRIGGER_RELEASE_ZONE", -1);
+  if (TRIGGER_RELEASE_ZONE < 0 || TRIGGER_RELEASE_ZONE > TRIGGER_DEAD_ZONE)
+  {
+    TRIGGER_RELEASE_ZONE = TRIGGER_DEAD_ZONE;
+  }
+
+  TRIGGER_LEFT_MODE = cfg.getInt("TRIGGER_LEFT_MODE");
+  TRIGGER_RIGHT_MODE = cfg.getInt("TRIGGER_RIGHT_MODE");
+  TRIGGER_CURSOR_SPEED = cfg.getFloat("TRIGGER_CURSOR_SPEED");
+  if (TRIGGER_CURSOR_SPEED <= 0.0f)
+  {
+    TRIGGER_CURSOR_SPEED = 0.25f;
+  }
+
+  // Cursor output mode
+  CURSOR_MODE = cfg.getInt("CURSOR_MODE");
+  CURSOR_NOCOALESCE = cfg.getInt("CURSOR_NOCOALESCE");
+
+  // Stick smoothing
+  FILTER_MIN_CUTOFF = cfg.getFloat("FILTER_MIN_CUTOFF");
+  if (FILTER_MIN_CUTOFF < 0.0f)
+  {
+    FILTER_MIN_CUTOFF = 0.0f;
+  }
+
+  FILTER_BETA = cfg.getFloat("FILTER_BETA", 5.0f);
+  if (FILTER_BETA < 0.0f)
+  {
+    FILTER_BETA = 5.0f;
+  }
+  STICK_CALIBRATION = cfg.getInt("STICK_CALIBRATION");
+
+  // Swap stick functions
+  SWAP_THUMBSTICKS = cfg.getInt("SWAP_THUMBSTICKS");
+
+  // Session recording
+  TRACE_FILE = cfg.getString("TRACE_FILE");
+  // Larger traces would not fit the address space of a 32-bit process next to everything else.
+  TRACE_SIZE = (SIZE_T)cfg.getInt("TRACE_SIZE", 64, 1, MAX_TRACE_SIZE);
+
+  // Logging
+  LOG_LEVEL = cfg.getInt("LOG_LEVEL", 1);
+  if (LOG_LEVEL < 0 || LOG_LEVEL > 3)
+  {
+    LOG_LEVEL = 1;
+  }
+  LOG_FILE = cfg.getString("LOG_FILE");
+  LOG_ETW = cfg.getInt("LOG_ETW");
+
+  // Scheduling
+  PROCESS_PRIORITY = cfg.getInt("PROCESS_PRIORITY");
+  if (PROCESS_PRIORITY < 0 || PROCESS_PRIORITY > 2)
+  {
+    PROCESS_PRIORITY = 0;
+  }
+  MMCSS_TASK = cfg.getString("MMCSS_TASK");
+  POLL_AFFINITY = (DWORD)cfg.getInt("POLL_AFFINITY");
+  LOOP_AFFINITY = (DWORD)cfg.getInt("LOOP_AFFINITY");
+  NO_POWER_THROTTLING = cfg.getInt("NO_POWER_THROTTLING");
+
+  diagnostics = cfg.getDiagnostics();
+  return cfg.isLoaded();
+}
+
+// Description:
+//   Loads a configuration file through its binary cache. The text is parsed only when the file
+//     changed since the cache was written; a config parsed without problems is cached for
+//     the next load.
+//
+// Params:
+//   path           The config file to read. The cache is the same path with .cache appended.
+//   diagnostics    Receives the problems found in the file, if it is parsed
+//   createDefault  Whether to generate a default file if it does not exist
+//
+// Returns:
+//   true if the config was read from the cache or the file.
+bool GopherConfig::loadCached(const std::string &path, std::vector<ConfigDiagnostic> &diagnostics, bool createDefault)
+{
+  const std::string cachePath = path + ".cache";
+
+  // Stamp the file before parsing it, so a change made while parsing is picked up next time.
+  ConfigStamp stamp;
+  bool stamped = getConfigStamp(path, stamp);
+  if (stamped && readConfigCache(cachePath, stamp, *this))
+  {
+    return true;
+  }
+
+  if (!load(path, diagnostics, createDefault))
+  {
+    return false;
+  }
+
+  // A file generated by load had no stamp yet.
+  if (!stamped)
+  {
+    stamped = getConfigStamp(path, stamp);
+  }
+  if (stamped && diagnostics.empty())
+  {
+    writeConfigCache(cachePath, stamp, *this);
+  }
+  return true;
+}
+
+// Description:
+//   Converts SEQUENCE_TIME to the performance counter ticks used by the bindings.
+void GopherConfig::setSequenceWindow()
+{
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  bindings.setSequenceWindow(frequency.QuadPart * SEQUENCE_TIME / 1000);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+#include "BindingTable.h"
+#include "ConfigFile.h"
+#include "KeyList.h"
+#include "ResponseCurve.h"
+
+// Continuous outputs a trigger can drive besides its keys.
+enum TriggerAxisMode
+{
+  TRIGGER_AXIS_NONE = 0,
+  TRIGGER_AXIS_SCROLL = 1,          // Scrolls, up for the left trigger and down for the right one.
+  TRIGGER_AXIS_CURSOR_SPEED = 2,    // Scales the cursor speed towards TRIGGER_CURSOR_SPEED.
+};
+
+// Largest TRACE_SIZE in megabytes. A view that size still fits the address space of a 32-bit process.
+const long MAX_TRACE_SIZE = 256;
+
+// Every setting read from config.ini. A config is parsed into a fresh object, which can be done
+// on any thread, and then handed to Gopher as a whole so a running loop never sees a
+// half-loaded config.
+struct GopherConfig
+{
+  int DEAD_ZONE = 6000;                 // Thumbstick dead zone to use for mouse movement. Absolute maximum shall be 65534.
+  int SCROLL_DEAD_ZONE = 5000;          // Thumbstick dead zone to use for scroll wheel movement. Absolute maximum shall be 65534.
+  int TRIGGER_DEAD_ZONE = 0;            // Dead zone for the left and right triggers to detect a trigger press. 0 means that any press to trigger will be read as a button press.
+  int TRIGGER_RELEASE_ZONE = 0;         // Trigger value at or below which a pressed trigger is released. At most TRIGGER_DEAD_ZONE.
+  int TRIGGER_LEFT_MODE = TRIGGER_AXIS_NONE;   // TriggerAxisMode of the left trigger.
+  int TRIGGER_RIGHT_MODE = TRIGGER_AXIS_NONE;  // TriggerAxisMode of the right trigger.
+  float TRIGGER_CURSOR_SPEED = 0.25f;   // Cursor speed multiplier at full press in TRIGGER_AXIS_CURSOR_SPEED. Below 1 for precision, above 1 for a boost.
+  float SCROLL_SPEED = 0.1f;             // Speed at which you scroll.
+  int SCROLL_NOTCHED = 0;               // Scrolls in whole WHEEL_DELTA notches instead of smoothly when not equal to 0.
+  int FPS = 150;                        // Update rate of the main Gopher loop. Interpreted as cycles-per-second.
+  int IDLE_FPS = 10;                    // Update rate used once the controller has been left alone for IDLE_TIMEOUT.
+  int IDLE_TIMEOUT = 5000;              // Milliseconds without a new controller packet before dropping to IDLE_FPS.
+  int SEQUENCE_TIME = 300;              // Milliseconds allowed between two steps of a button sequence.
+  int HOLD_TIME = 500;                  // Milliseconds a button is held before it counts as a long press.
+  int DOUBLE_TAP_TIME = 250;            // Milliseconds allowed between the two taps of a double tap.
+  int TURBO_RATE = 10;                  // Key repeats per second of the buttons in TURBO_BUTTONS.
+  WORD TURBO_BUTTONS = 0;               // Buttons whose keys repeat while held.
+  int SWAP_THUMBSTICKS = 0;             // Swaps the function of the thumbsticks when not equal to 0.
+  int CURSOR_MODE = 0;                  // 0 positions the cursor absolutely, 1 sends relative mouse motion.
+  int CURSOR_NOCOALESCE = 0;            // Asks the system not to coalesce relative motion events when not equal to 0.
+  float FILTER_MIN_CUTOFF = 0.0f;       // Cutoff frequency in Hz of the stick smoothing at rest. 0 disables the smoothing.
+  float FILTER_BETA = 5.0f;             // Increase of the smoothing cutoff with the stick speed.
+  int STICK_CALIBRATION = 0;            // Centers resting sticks and hides their noise as measured when not equal to 0.
+  std::string TRACE_FILE = "0";         // File to record the session to. "0" when not recording.
+  SIZE_T TRACE_SIZE = 64;               // Megabytes to preallocate for the trace, 1 to MAX_TRACE_SIZE.
+  int LOG_LEVEL = 1;                    // Lowest level of the messages logged: 0 debug, 1 info, 2 warning, 3 error.
+  std::string LOG_FILE = "0";           // File messages are appended to. "0" when not logging to a file.
+  int LOG_ETW = 0;                      // Writes messages as ETW events too when not equal to 0.
+  int PROCESS_PRIORITY = 0;             // Priority class of the process: 0 normal, 1 above normal, 2 high.
+  std::string MMCSS_TASK = "0";         // MMCSS task the polling and loop threads join, such as "Games". "0" for none.
+  DWORD POLL_AFFINITY = 0;              // Cores the polling thread may run on, one bit per core. 0 for any.
+  DWORD LOOP_AFFINITY = 0;              // Cores the thread mapping and sending the inputs may run on. 0 for any.
+  int NO_POWER_THROTTLING = 0;          // Opts the process and its input threads out of EcoQoS when not equal to 0.
+
+  float acceleration_factor = 0.0f;
+  std::vector<float> speeds;	            // Contains actual speeds to choose
+  std::vector<std::string> speed_names;   // Contains display names of speeds to display
+
+  // Thumbstick response curves
+  std::vector<CurvePoint> cursorCurvePoints;  // Custom cursor curve. Empty to use acceleration_factor.
+  std::vector<CurvePoint> scrollCurvePoints;  // Custom scroll curve. Empty for a linear curve.
+  std::vector<CurvePoint> triggerCurvePoints; // Custom curve of the trigger outputs. Empty for a linear curve.
+
+  // Button bindings
+  BindingTable bindings;                      // Controller buttons of every binding.
+  KeyChord bindingKeys[BINDING_COUNT];        // Keys sent by the keyboard bindings.
+  KeyChord holdKeys[BINDING_COUNT];           // Keys sent instead when a keyboard binding is held for HOLD_TIME.
+  KeyChord doubleKeys[BINDING_COUNT];         // Keys sent instead when a keyboard binding is tapped twice.
+
+  // Trigger bindings
+  KeyChord GAMEPAD_TRIGGER_LEFT;
+  KeyChord GAMEPAD_TRIGGER_RIGHT;
+
+  bool load(const std::string &path, std::vector<ConfigDiagnostic> &diagnostics, bool createDefault = true);
+
+  bool loadCached(const std::string &path, std::vector<ConfigDiagnostic> &diagnostics, bool createDefault = true);
+
+  void setSequenceWindow();
+};
@@ -0,0 +1,145 @@
+#include "Haptics.h"
+
+HapticsEngine::HapticsEngine(DWORD userIndex)
+  : _userIndex(userIndex)
+  , _frequency(1)
+  , _lock(SRWLOCK_INIT)
+  , _wake(CreateEvent(NULL, FALSE, FALSE, NULL))
+  , _thread(NULL)
+  , _running(false)
+{
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  _frequency = frequency.QuadPart;
+}
+
+HapticsEngine::~HapticsEngine()
+{
+  if (_thread != NULL)
+  {
+    _running = false;
+    SetEvent(_wake);
+    WaitForSingleObject(_thread, INFINITE);
+    CloseHandle(_thread);
+  }
+
+  CloseHandle(_wake);
+}
+
+// Description:
+//   Queues a vibration effect. Returns immediately; the effect is played on the
+//     engine's thread.
+//
+// Params:
+//   effect   The effect to play
+void HapticsEngine::play(const HapticEffect &effect)
+{
+  if (effect.duration <= 0)
+  {
+    return;
+  }
+
+  AcquireSRWLockExclusive(&_lock);
+  if (!effect.merge)
+  {
+    _effects.clear();
+  }
+  _effects.push_back({ effect, now() });
+  ReleaseSRWLockExclusive(&_lock);
+
+  if (_thread == NULL)
+  {
+    _running = true;
+    _thread = CreateThread(NULL, 0, threadProc, this, 0, NULL);
+  }
+  SetEvent(_wake);
+}
+
+// Description:
+//   Stops all playing effects.
+void HapticsEngine::cancel()
+{
+  AcquireSRWLockExclusive(&_lock);
+  _effects.clear();
+  ReleaseSRWLockExclusive(&_lock);
+
+  SetEvent(_wake);
+}
+
+DWORD WINAPI HapticsEngine::threadProc(LPVOID param)
+{
+  static_cast<HapticsEngine*>(param)->run();
+  return 0;
+}
+
+// Description:
+//   The engine thread body. Evaluates the envelope of every playing effect, drives the
+//     motors at the strongest level and sleeps until the next change is due.
+void HapticsEngine::run()
+{
+  WORD currentLeft = 0;
+  WORD currentRight = 0;
+
+  while (_running)
+  {
+    DWORD timeout = INFINITE;
+    float left = 0.0f;
+    float right = 0.0f;
+    LONGLONG time = now();
+
+    AcquireSRWLockExclusive(&_lock);
+    for (std::vector<ActiveEffect>::iterator it = _effects.begin(); it != _effects.end();)
+    {
+      const HapticEffect &effect = it->effect;
+      int elapsed = (int)((time - it->start) * 1000 / _frequency);
+      if (elapsed >= effect.duration)
+      {
+        it = _effects.erase(it);
+        continue;
+      }
+
+      // Shape the intensity with the attack and release ramps.
+      float gain = 1.0f;
+      DWORD wait = (DWORD)(effect.duration - effect.release - elapsed);
+      if (elapsed < effect.attack)
+      {
+        gain = (float)elapsed / effect.attack;
+        wait = ENVELOPE_STEP;
+      }
+      else if (elapsed >= effect.duration - effect.release)
+      {
+        gain = (float)(effect.duration - elapsed) / effect.release;
+        wait = ENVELOPE_STEP;
+      }
+
+      if (gain * effect.left > left) left = gain * effect.left;
+      if (gain * effect.right > right) right = gain * effect.right;
+      if (wait < timeout) timeout = wait;
+      ++it;
+    }
+    ReleaseSRWLockExclusive(&_lock);
+
+    if ((WORD)left != currentLeft || (WORD)right != currentRight)
+    {
+      XINPUT_VIBRATION vibration;
+      vibration.wLeftMotorSpeed = currentLeft = (WORD)left;
+      vibration.wRightMotorSpeed = currentRight = (WORD)right;
+      XInputSetState(_userIndex, &vibration);
+    }
+
+    WaitForSingleObject(_wake, timeout);
+  }
+
+  if (currentLeft != 0 || currentRight != 0)
+  {
+    XINPUT_VIBRATION vibration = { 0, 0 };
+    XInputSetState(_userIndex, &vibration);
+  }
+}
+
+LONGLONG HapticsEngine::now() const
+{
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return counter.QuadPart;
+}
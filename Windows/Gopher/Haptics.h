@@ -0,0 +1,63 @@
+#pragma once
+
+#include <windows.h>
+#include <xinput.h>
+#include <atomic>
+#include <vector>
+
+// Description of a single vibration effect.
+struct HapticEffect
+{
+  int duration;   // Total length of the effect in milliseconds.
+  WORD left;      // Peak intensity of the left (low frequency) motor.
+  WORD right;     // Peak intensity of the right (high frequency) motor.
+  int attack;     // Milliseconds to ramp from 0 up to the peak intensity.
+  int release;    // Milliseconds to ramp from the peak intensity down to 0 at the end of the effect.
+  bool merge;     // Mixes with the effects already playing instead of replacing them.
+
+  HapticEffect(int duration, WORD left, WORD right, int attack = 0, int release = 0, bool merge = false)
+    : duration(duration), left(left), right(right), attack(attack), release(release), merge(merge)
+  {
+  }
+};
+
+// Plays queued vibration effects for one controller on a background thread so the caller
+// never has to wait for an effect to finish. Overlapping effects are either replaced or
+// merged, in which case each motor runs at the strongest level requested by any effect.
+class HapticsEngine
+{
+private:
+  static const DWORD ENVELOPE_STEP = 10;  // Milliseconds between motor updates while an effect is ramping.
+
+  struct ActiveEffect
+  {
+    HapticEffect effect;
+    LONGLONG start;   // Performance counter value at which the effect started.
+  };
+
+  DWORD _userIndex;                   // XInput user index of the controller to vibrate.
+  LONGLONG _frequency;                // Performance counter ticks per second.
+  std::vector<ActiveEffect> _effects; // Effects currently playing. Guarded by _lock.
+  SRWLOCK _lock;
+  HANDLE _wake;                       // Auto-reset event signalled when the effect list changes.
+  HANDLE _thread;                     // Created on the first effect.
+  std::atomic<bool> _running;
+
+public:
+  HapticsEngine(DWORD userIndex);
+  ~HapticsEngine();
+
+  void play(const HapticEffect &effect);
+
+  void cancel();
+
+private:
+  static DWORD WINAPI threadProc(LPVOID param);
+
+  void run();
+
+  LONGLONG now() const;
+
+  HapticsEngine(const HapticsEngine&) = delete;
+  HapticsEngine& operator=(const HapticsEngine&) = delete;
+};
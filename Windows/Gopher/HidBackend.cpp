@@ -0,0 +1,528 @@
+#include "HidBackend.h"
+
+#include <algorithm>
+#include <string.h>
+#include <wchar.h>
+
+#pragma comment(lib, "hid") // for HidP_*()
+
+// Positions of the axes in Pad::axes.
+enum
+{
+  AXIS_X,
+  AXIS_Y,
+  AXIS_Z,
+  AXIS_RX,
+  AXIS_RY,
+  AXIS_RZ,
+  AXIS_HAT
+};
+
+// XInput buttons of HID buttons 1 to 12, in the DualShock 4 order: square, cross, circle,
+// triangle, L1, R1, L2, R2, share, options, L3, R3. L2 and R2 also report as axes.
+static const WORD HID_BUTTONS[] =
+{
+  XINPUT_GAMEPAD_X,
+  XINPUT_GAMEPAD_A,
+  XINPUT_GAMEPAD_B,
+  XINPUT_GAMEPAD_Y,
+  XINPUT_GAMEPAD_LEFT_SHOULDER,
+  XINPUT_GAMEPAD_RIGHT_SHOULDER,
+  0,
+  0,
+  XINPUT_GAMEPAD_BACK,
+  XINPUT_GAMEPAD_START,
+  XINPUT_GAMEPAD_LEFT_THUMB,
+  XINPUT_GAMEPAD_RIGHT_THUMB,
+};
+static const USAGE BUTTON_LEFT_TRIGGER = 7;
+static const USAGE BUTTON_RIGHT_TRIGGER = 8;
+
+// D-pad buttons of the eight hat switch positions, clockwise from up.
+static const WORD HAT_BUTTONS[] =
+{
+  XINPUT_GAMEPAD_DPAD_UP,
+  XINPUT_GAMEPAD_DPAD_UP | XINPUT_GAMEPAD_DPAD_RIGHT,
+  XINPUT_GAMEPAD_DPAD_RIGHT,
+  XINPUT_GAMEPAD_DPAD_DOWN | XINPUT_GAMEPAD_DPAD_RIGHT,
+  XINPUT_GAMEPAD_DPAD_DOWN,
+  XINPUT_GAMEPAD_DPAD_DOWN | XINPUT_GAMEPAD_DPAD_LEFT,
+  XINPUT_GAMEPAD_DPAD_LEFT,
+  XINPUT_GAMEPAD_DPAD_UP | XINPUT_GAMEPAD_DPAD_LEFT,
+};
+
+static const TCHAR WINDOW_CLASS[] = TEXT("Gopher360Hid");
+
+// Description:
+//   Reads the position of an axis in a report.
+//
+// Params:
+//   usage      The HID usage of the axis
+//   minimum    Logical minimum of the axis
+//   maximum    Logical maximum of the axis
+//   bits       Size of the axis value in the report
+//   preparsed  HIDP_PREPARSED_DATA of the device
+//   report     The report
+//   length     Length of the report in bytes
+//
+// Returns:
+//   The position from 0 to 1, or -1 if the report does not carry the axis.
+static float readAxis(USAGE usage, LONG minimum, LONG maximum, USHORT bits, PHIDP_PREPARSED_DATA preparsed, PCHAR report, ULONG length)
+{
+  ULONG raw = 0;
+  if (HidP_GetUsageValue(HidP_Input, HID_USAGE_PAGE_GENERIC, 0, usage, &raw, preparsed, report, length) != HIDP_STATUS_SUCCESS)
+  {
+    return -1.0f;
+  }
+
+  LONG value = (LONG)raw;
+  if (minimum < 0 && bits > 0 && bits < 32 && (raw & (1UL << (bits - 1))))
+  {
+    value = (LONG)(raw | ~((1UL << bits) - 1));  // Sign extended.
+  }
+
+  const float position = (float)(value - minimum) / (float)(maximum - minimum);
+  return (std::min)((std::max)(position, 0.0f), 1.0f);
+}
+
+// Description:
+//   Converts an axis position to a thumbstick axis.
+//
+// Params:
+//   position   From 0 to 1
+//   inverted   true for the vertical axes, which grow downwards in HID and upwards in XInput
+static SHORT toStick(float position, bool inverted)
+{
+  if (inverted)
+  {
+    position = 1.0f - position;
+  }
+  const LONG value = (LONG)(position * 65535.0f + 0.5f) - 32768;
+  return (SHORT)(std::min)((std::max)(value, (LONG)-32768), (LONG)32767);
+}
+
+HidBackend::HidBackend()
+  : _lock(SRWLOCK_INIT)
+  , _reportTime(0)
+  , _packetNumbers()
+  , _input(CreateEvent(NULL, FALSE, FALSE, NULL))
+  , _thread(NULL)
+  , _threadId(0)
+  , _started(CreateEvent(NULL, TRUE, FALSE, NULL))
+{
+  _thread = CreateThread(NULL, 0, threadProc, this, 0, &_threadId);
+  if (_thread != NULL)
+  {
+    // Reports are timed as the input thread receives them, so it must not wait behind others.
+    SetThreadPriority(_thread, THREAD_PRIORITY_HIGHEST);
+    WaitForSingleObject(_started, INFINITE);
+  }
+}
+
+HidBackend::~HidBackend()
+{
+  if (_thread != NULL)
+  {
+    PostThreadMessage(_threadId, WM_QUIT, 0, 0);
+    WaitForSingleObject(_thread, INFINITE);
+    CloseHandle(_thread);
+  }
+  CloseHandle(_started);
+  CloseHandle(_input);
+}
+
+// Description:
+//   Gets the latest state of every slot. A slot is connected from the moment its pad is
+//     plugged in.
+//
+// Params:
+//   states   Receives the state of each connected controller
+//   now      The current performance counter value
+//
+// Returns:
+//   A mask with bit n set when the controller in slot n is connected.
+DWORD HidBackend::poll(XINPUT_STATE states[XUSER_MAX_COUNT], LONGLONG now)
+{
+  DWORD connected = 0;
+  _reportTime = 0;
+
+  AcquireSRWLockShared(&_lock);
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+  {
+    if (_pads[i].device == NULL)
+    {
+      ZeroMemory(&states[i], sizeof(XINPUT_STATE));
+      continue;
+    }
+
+    states[i] = _pads[i].state;
+    connected |= 1 << i;
+
+    // Pads that sent nothing new since the last poll must not date the sample.
+    if (states[i].dwPacketNumber != _packetNumbers[i])
+    {
+      _packetNumbers[i] = states[i].dwPacketNumber;
+      _reportTime = (std::max)(_reportTime, _pads[i].reportTime);
+    }
+  }
+  ReleaseSRWLockShared(&_lock);
+
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+  {
+    _controllers[i].update(states[i], (connected & (1 << i)) != 0);
+  }
+  return connected;
+}
+
+// Description:
+//   Gets the controller of a slot.
+//
+// Params:
+//   index  The slot, 0 to XUSER_MAX_COUNT - 1
+IController *HidBackend::getController(DWORD index) const
+{
+  return &_controllers[index];
+}
+
+DWORD WINAPI HidBackend::threadProc(LPVOID param)
+{
+  static_cast<HidBackend*>(param)->run();
+  return 0;
+}
+
+// Description:
+//   The input thread body. Raw input is delivered to a message-only window of the thread, and
+//     read from the message loop as soon as it is queued.
+void HidBackend::run()
+{
+  MSG msg;
+  PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);  // Creates the message queue.
+
+  const HINSTANCE instance = GetModuleHandle(NULL);
+  WNDCLASSEX windowClass;
+  ZeroMemory(&windowClass, sizeof(windowClass));
+  windowClass.cbSize = sizeof(windowClass);
+  windowClass.lpfnWndProc = DefWindowProc;  // Cleans up after WM_INPUT.
+  windowClass.hInstance = instance;
+  windowClass.lpszClassName = WINDOW_CLASS;
+  RegisterClassEx(&windowClass);
+  HWND window = CreateWindowEx(0, WINDOW_CLASS, NULL, 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, instance, NULL);
+
+  // Game pads, and the joysticks many pads report themselves as. Reports keep coming while
+  // another program has the focus, and arrivals and removals are announced.
+  RAWINPUTDEVICE devices[2];
+  devices[0].usUsagePage = HID_USAGE_PAGE_GENERIC;
+  devices[0].usUsage = HID_USAGE_GENERIC_GAMEPAD;
+  devices[0].dwFlags = RIDEV_INPUTSINK | RIDEV_DEVNOTIFY;
+  devices[0].hwndTarget = window;
+  devices[1] = devices[0];
+  devices[1].usUsage = HID_USAGE_GENERIC_JOYSTICK;
+  const bool registered = window != NULL && RegisterRawInputDevices(devices, 2, sizeof(RAWINPUTDEVICE));
+  SetEvent(_started);
+
+  while (GetMessage(&msg, NULL, 0, 0) > 0)
+  {
+    if (msg.message == WM_INPUT)
+    {
+      onInput((HRAWINPUT)msg.lParam);
+    }
+    else if (msg.message == WM_INPUT_DEVICE_CHANGE)
+    {
+      onDeviceChange(msg.wParam, (HANDLE)msg.lParam);
+    }
+    DispatchMessage(&msg);
+  }
+
+  if (registered)
+  {
+    for (RAWINPUTDEVICE &device : devices)
+    {
+      device.dwFlags = RIDEV_REMOVE;
+      device.hwndTarget = NULL;
+    }
+    RegisterRawInputDevices(devices, 2, sizeof(RAWINPUTDEVICE));
+  }
+  if (window != NULL)
+  {
+    DestroyWindow(window);
+  }
+  UnregisterClass(WINDOW_CLASS, instance);
+}
+
+// Description:
+//   Reads a raw input packet. A change of the pad state is stored with the time the packet
+//     was received, and signalled.
+//
+// Params:
+//   input  The packet handle of WM_INPUT
+void HidBackend::onInput(HRAWINPUT input)
+{
+  LARGE_INTEGER received;
+  QueryPerformanceCounter(&received);
+
+  UINT size = sizeof(_buffer);
+  if (GetRawInputData(input, RID_INPUT, _buffer, &size, sizeof(RAWINPUTHEADER)) == (UINT)-1)
+  {
+    return;
+  }
+
+  const RAWINPUT *raw = (const RAWINPUT*)_buffer;
+  if (raw->header.dwType != RIM_TYPEHID || raw->data.hid.dwCount == 0)
+  {
+    return;
+  }
+
+  Pad *pad = addDevice(raw->header.hDevice);
+  if (pad == NULL)
+  {
+    return;
+  }
+
+  // A packet may carry several reports, which are in order; the last one is the current state.
+  const DWORD reportSize = raw->data.hid.dwSizeHid;
+  PCHAR report = (PCHAR)raw->data.hid.bRawData + (raw->data.hid.dwCount - 1) * reportSize;
+  XINPUT_GAMEPAD gamepad;
+  readReport(*pad, report, reportSize, gamepad);
+  if (memcmp(&gamepad, &pad->state.Gamepad, sizeof(gamepad)) == 0)
+  {
+    return;  // Most pads repeat their state at a fixed rate whether it changed or not.
+  }
+
+  AcquireSRWLockExclusive(&_lock);
+  pad->state.Gamepad = gamepad;
+  ++pad->state.dwPacketNumber;
+  pad->reportTime = received.QuadPart;
+  ReleaseSRWLockExclusive(&_lock);
+  SetEvent(_input);
+}
+
+// Description:
+//   Handles a pad being plugged in or removed.
+//
+// Params:
+//   change   GIDC_ARRIVAL or GIDC_REMOVAL
+//   device   The raw input device
+void HidBackend::onDeviceChange(WPARAM change, HANDLE device)
+{
+  if (change == GIDC_ARRIVAL)
+  {
+    addDevice(device);
+  }
+  else if (change == GIDC_REMOVAL)
+  {
+    removeDevice(device);
+  }
+}
+
+// Description:
+//   Finds the slot of a device, and gives it the first free slot if it has none yet.
+//
+// Returns:
+//   The slot, or NULL if the device is not read or all slots are taken.
+HidBackend::Pad *HidBackend::addDevice(HANDLE device)
+{
+  Pad *free = NULL;
+  for (Pad &pad : _pads)
+  {
+    if (pad.device == device)
+    {
+      return &pad;
+    }
+    if (pad.device == NULL && free == NULL)
+    {
+      free = &pad;
+    }
+  }
+
+  if (free == NULL || std::find(_ignored.begin(), _ignored.end(), device) != _ignored.end())
+  {
+    return NULL;
+  }
+
+  Pad opened;
+  if (!openDevice(device, opened))
+  {
+    _ignored.push_back(device);
+    return NULL;
+  }
+
+  AcquireSRWLockExclusive(&_lock);
+  *free = std::move(opened);
+  ReleaseSRWLockExclusive(&_lock);
+  SetEvent(_input);
+  return free;
+}
+
+// Description:
+//   Frees the slot of a removed device.
+void HidBackend::removeDevice(HANDLE device)
+{
+  _ignored.erase(std::remove(_ignored.begin(), _ignored.end(), device), _ignored.end());
+
+  for (Pad &pad : _pads)
+  {
+    if (pad.device == device)
+    {
+      AcquireSRWLockExclusive(&_lock);
+      pad = Pad();
+      ReleaseSRWLockExclusive(&_lock);
+      SetEvent(_input);
+    }
+  }
+}
+
+// Description:
+//   Reads the report layout of a device.
+//
+// Params:
+//   device   The raw input device
+//   pad      Receives the device and its layout
+//
+// Returns:
+//   false if the device is not a pad to read: XInput pads, and devices without both axes of a
+//     stick.
+bool HidBackend::openDevice(HANDLE device, Pad &pad)
+{
+  // XInput pads are also HID devices, marked with IG_ in their name. Their HID reports merge
+  // both triggers into one axis, so they are better read through the XInput backend.
+  WCHAR name[256];
+  UINT nameLength = sizeof(name) / sizeof(name[0]);
+  if (GetRawInputDeviceInfoW(device, RIDI_DEVICENAME, name, &nameLength) == (UINT)-1 || wcsstr(name, L"IG_") != NULL)
+  {
+    return false;
+  }
+
+  UINT size = 0;
+  GetRawInputDeviceInfoW(device, RIDI_PREPARSEDDATA, NULL, &size);
+  if (size == 0)
+  {
+    return false;
+  }
+  pad.preparsed.resize(size);
+  if (GetRawInputDeviceInfoW(device, RIDI_PREPARSEDDATA, pad.preparsed.data(), &size) == (UINT)-1)
+  {
+    return false;
+  }
+  PHIDP_PREPARSED_DATA preparsed = (PHIDP_PREPARSED_DATA)pad.preparsed.data();
+
+  HIDP_CAPS caps;
+  if (HidP_GetCaps(preparsed, &caps) != HIDP_STATUS_SUCCESS || caps.NumberInputValueCaps == 0)
+  {
+    return false;
+  }
+
+  std::vector<HIDP_VALUE_CAPS> values(caps.NumberInputValueCaps);
+  USHORT valueCount = caps.NumberInputValueCaps;
+  if (HidP_GetValueCaps(HidP_Input, values.data(), &valueCount, preparsed) != HIDP_STATUS_SUCCESS)
+  {
+    return false;
+  }
+
+  for (USHORT i = 0; i < valueCount; ++i)
+  {
+    const HIDP_VALUE_CAPS &value = values[i];
+    if (value.UsagePage != HID_USAGE_PAGE_GENERIC)
+    {
+      continue;
+    }
+
+    const USAGE usage = value.IsRange ? value.Range.UsageMin : value.NotRange.Usage;
+    int axis;
+    if (usage >= HID_USAGE_GENERIC_X && usage <= HID_USAGE_GENERIC_RZ)
+    {
+      axis = AXIS_X + (usage - HID_USAGE_GENERIC_X);
+    }
+    else if (usage == HID_USAGE_GENERIC_HATSWITCH)
+    {
+      axis = AXIS_HAT;
+    }
+    else
+    {
+      continue;
+    }
+
+    Axis &target = pad.axes[axis];
+    target.present = true;
+    target.bits = value.BitSize;
+    target.minimum = value.LogicalMin;
+    target.maximum = value.LogicalMax;
+    // Some descriptors give an unsigned range that does not fit a LONG, such as 0 to 65535 in
+    // 16 bits stored as 0 to -1.
+    if (target.maximum <= target.minimum && target.bits > 0 && target.bits < 32)
+    {
+      target.minimum = 0;
+      target.maximum = (LONG)((1UL << target.bits) - 1);
+    }
+  }
+
+  if (!pad.axes[AXIS_X].present || !pad.axes[AXIS_Y].present)
+  {
+    return false;
+  }
+
+  pad.device = device;
+  return true;
+}
+
+// Description:
+//   Translates a HID report to an XInput gamepad state.
+//
+// Params:
+//   pad      The slot of the device
+//   report   The report
+//   length   Length of the report in bytes
+//   gamepad  Receives the state
+void HidBackend::readReport(const Pad &pad, PCHAR report, ULONG length, XINPUT_GAMEPAD &gamepad)
+{
+  ZeroMemory(&gamepad, sizeof(gamepad));
+  PHIDP_PREPARSED_DATA preparsed = (PHIDP_PREPARSED_DATA)pad.preparsed.data();
+
+  USAGE usages[128];
+  ULONG usageCount = sizeof(usages) / sizeof(usages[0]);
+  bool leftTrigger = false;
+  bool rightTrigger = false;
+  if (HidP_GetUsages(HidP_Input, HID_USAGE_PAGE_BUTTON, 0, usages, &usageCount, preparsed, report, length) == HIDP_STATUS_SUCCESS)
+  {
+    for (ULONG i = 0; i < usageCount; ++i)
+    {
+      const USAGE button = usages[i];
+      if (button >= 1 && button <= sizeof(HID_BUTTONS) / sizeof(HID_BUTTONS[0]))
+      {
+        gamepad.wButtons |= HID_BUTTONS[button - 1];
+      }
+      leftTrigger = leftTrigger || button == BUTTON_LEFT_TRIGGER;
+      rightTrigger = rightTrigger || button == BUTTON_RIGHT_TRIGGER;
+    }
+  }
+
+  // Every axis but the hat switch.
+  float positions[AXIS_HAT];
+  for (int i = AXIS_X; i < AXIS_HAT; ++i)
+  {
+    const Axis &axis = pad.axes[i];
+    positions[i] = axis.present ? readAxis((USAGE)(HID_USAGE_GENERIC_X + i), axis.minimum, axis.maximum, axis.bits, preparsed, report, length) : -1.0f;
+  }
+
+  gamepad.sThumbLX = positions[AXIS_X] < 0.0f ? 0 : toStick(positions[AXIS_X], false);
+  gamepad.sThumbLY = positions[AXIS_Y] < 0.0f ? 0 : toStick(positions[AXIS_Y], true);
+  gamepad.sThumbRX = positions[AXIS_Z] < 0.0f ? 0 : toStick(positions[AXIS_Z], false);
+  gamepad.sThumbRY = positions[AXIS_RZ] < 0.0f ? 0 : toStick(positions[AXIS_RZ], true);
+
+  // Pads without analog triggers only have the L2 and R2 buttons.
+  gamepad.bLeftTrigger = positions[AXIS_RX] >= 0.0f ? (BYTE)(positions[AXIS_RX] * 255.0f + 0.5f) : (leftTrigger ? 255 : 0);
+  gamepad.bRightTrigger = positions[AXIS_RY] >= 0.0f ? (BYTE)(positions[AXIS_RY] * 255.0f + 0.5f) : (rightTrigger ? 255 : 0);
+
+  // Positions past the eighth, usually the logical maximum plus one, mean the hat is centered.
+  if (pad.axes[AXIS_HAT].present)
+  {
+    ULONG hat = 0;
+    if (HidP_GetUsageValue(HidP_Input, HID_USAGE_PAGE_GENERIC, 0, HID_USAGE_GENERIC_HATSWITCH, &hat, preparsed, report, length) == HIDP_STATUS_SUCCESS)
+    {
+      const ULONG position = hat - (ULONG)pad.axes[AXIS_HAT].minimum;
+      if (position < sizeof(HAT_BUTTONS) / sizeof(HAT_BUTTONS[0]))
+      {
+        gamepad.wButtons |= HAT_BUTTONS[position];
+      }
+    }
+  }
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <windows.h>
+#include <xinput.h>
+#include <hidpi.h>
+#include <atomic>
+#include <vector>
+
+#include "ControllerBackend.h"
+
+// A slot of the HID backend. Its state is read for it by HidBackend::poll. HID has no standard
+// way to drive the motors of a pad, so vibration is ignored.
+class HidController : public IController
+{
+private:
+  XINPUT_STATE _state;
+  std::atomic<bool> _connected;
+
+public:
+  HidController()
+    : _state()
+    , _connected(false)
+  {
+  }
+
+  // Description:
+  //   Gets the state read by the last HidBackend::poll.
+  DWORD Poll(XINPUT_STATE &state) override
+  {
+    state = _state;
+    return IsConnected() ? ERROR_SUCCESS : ERROR_DEVICE_NOT_CONNECTED;
+  }
+
+  bool IsConnected() override
+  {
+    return _connected.load(std::memory_order_relaxed);
+  }
+
+  void Vibrate(const HapticEffect &effect) override
+  {
+  }
+
+  void StopVibration() override
+  {
+  }
+
+  void update(const XINPUT_STATE &state, bool connected)
+  {
+    _state = state;
+    _connected.store(connected, std::memory_order_relaxed);
+  }
+};
+
+// Reads game pads and joysticks through raw input on a thread of its own, for pads XInput does
+// not see, such as a DualShock 4 without a wrapper driver. Reports are handled the moment they
+// arrive and timed with the performance counter then, and the input event is signalled only
+// when the state of a pad changes, so the polling thread can sleep while the pads are left
+// alone. Buttons and axes follow the DirectInput layout of the DualShock 4, which most HID pads
+// share. Pads that XInput handles are left to the XInput backend.
+class HidBackend : public ControllerBackend
+{
+private:
+  static const size_t MAX_REPORT = 1024;  // Largest raw input packet read at once.
+
+  static const int AXIS_COUNT = 7;        // X, Y, Z, Rx, Ry, Rz and the hat switch.
+
+  // The logical range of one HID axis.
+  struct Axis
+  {
+    bool present = false;
+    USHORT bits = 0;
+    LONG minimum = 0;
+    LONG maximum = 0;
+  };
+
+  struct Pad
+  {
+    HANDLE device = NULL;                 // Raw input device handle, NULL while the slot is free.
+    std::vector<BYTE> preparsed;          // HIDP_PREPARSED_DATA of the device.
+    Axis axes[AXIS_COUNT];
+    XINPUT_STATE state = {};
+    LONGLONG reportTime = 0;              // Performance counter value at which the last change arrived.
+  };
+
+  // Slots are only changed by the input thread, which takes _lock to do so; the polling thread
+  // takes it to read them.
+  Pad _pads[XUSER_MAX_COUNT];
+  SRWLOCK _lock;
+  std::vector<HANDLE> _ignored;           // Devices that are not read, such as XInput pads. Only used by the input thread.
+  LONGLONG _reportTime;                   // Newest report time of the pads that changed in the last poll. Only used by the polling thread.
+  DWORD _packetNumbers[XUSER_MAX_COUNT];  // Packet number of every slot at the last poll. Only used by the polling thread.
+  mutable HidController _controllers[XUSER_MAX_COUNT];
+
+  HANDLE _input;                          // Auto-reset event signalled when a pad changes.
+  HANDLE _thread;
+  DWORD _threadId;
+  HANDLE _started;                        // Set once the input thread is ready for WM_QUIT.
+  alignas(8) BYTE _buffer[MAX_REPORT];    // A RAWINPUT. Only used by the input thread.
+
+public:
+  HidBackend();
+  ~HidBackend();
+
+  DWORD poll(XINPUT_STATE states[XUSER_MAX_COUNT], LONGLONG now) override;
+
+  IController *getController(DWORD index) const override;
+
+  HANDLE getInputEvent() const override
+  {
+    return _input;
+  }
+
+  LONGLONG getReportTime() const override
+  {
+    return _reportTime;
+  }
+
+private:
+  static DWORD WINAPI threadProc(LPVOID param);
+
+  void run();
+
+  void onInput(HRAWINPUT input);
+
+  void onDeviceChange(WPARAM change, HANDLE device);
+
+  Pad *addDevice(HANDLE device);
+
+  void removeDevice(HANDLE device);
+
+  static bool openDevice(HANDLE device, Pad &pad);
+
+  static void readReport(const Pad &pad, PCHAR report, ULONG length, XINPUT_GAMEPAD &gamepad);
+
+  HidBackend(const HidBackend&) = delete;
+  HidBackend& operator=(const HidBackend&) = delete;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <windows.h>
+#include <xinput.h>
+
+#include "Haptics.h"
+
+// A controller slot as seen by the mapping engine. CXBOXController reads a real XInput pad;
+// the benchmark substitutes controllers that do not touch the hardware.
+class IController
+{
+public:
+  virtual ~IController() {}
+
+  // Description:
+  //   Reads the current state of the controller.
+  //
+  // Params:
+  //   state  Receives the state. Zeroed when the controller is not connected.
+  //
+  // Returns:
+  //   ERROR_SUCCESS, or the XInput error code of the read.
+  virtual DWORD Poll(XINPUT_STATE &state) = 0;
+
+  // Description:
+  //   Tells whether the last read found a connected controller.
+  virtual bool IsConnected() = 0;
+
+  virtual void Vibrate(const HapticEffect &effect) = 0;
+
+  virtual void StopVibration() = 0;
+};
@@ -0,0 +1,118 @@
+#include "InputBatch.h"
+
+InputBatch::InputBatch(InputSink* sink)
+  : _sink(sink)
+  , _count(0)
+{
+}
+
+// Description:
+//   Adds a keyboard event to the batch.
+//
+// Params:
+//   key    The virtual key code to send (see http://msdn.microsoft.com/en-us/library/windows/desktop/dd375731%28v=vs.85%29.aspx)
+//   flags  The KEYEVENT flags for the key
+void InputBatch::keyboard(WORD key, DWORD flags)
+{
+  INPUT &input = next();
+  input.type = INPUT_KEYBOARD;
+  input.ki.wVk = key;
+  input.ki.dwFlags = flags;
+}
+
+// Description:
+//   Adds a mouse button or wheel event to the batch.
+//   See https://msdn.microsoft.com/en-us/library/windows/desktop/ms646310(v=vs.85).aspx
+//
+// Params:
+//   flags      The mouse event to send
+//   mouseData  Additional information needed for certain mouse events (Optional)
+void InputBatch::mouse(DWORD flags, DWORD mouseData)
+{
+  INPUT &input = next();
+  input.type = INPUT_MOUSE;
+  input.mi.dwFlags = flags;
+
+  // Only set mouseData when using a supported flags type
+  if (flags == MOUSEEVENTF_WHEEL ||
+      flags == MOUSEEVENTF_XUP   ||
+      flags == MOUSEEVENTF_XDOWN ||
+      flags == MOUSEEVENTF_HWHEEL)
+  {
+    input.mi.mouseData = mouseData;
+  }
+}
+
+// Description:
+//   Adds a relative mouse motion event to the batch. Relative motion is subject to the
+//     system pointer speed and acceleration settings, like a physical mouse.
+//
+// Params:
+//   dx     Horizontal motion in mickeys
+//   dy     Vertical motion in mickeys
+//   flags  Additional MOUSEEVENTF flags, e.g. MOUSEEVENTF_MOVE_NOCOALESCE (Optional)
+void InputBatch::move(int dx, int dy, DWORD flags)
+{
+  INPUT &input = next();
+  input.type = INPUT_MOUSE;
+  input.mi.dx = dx;
+  input.mi.dy = dy;
+  input.mi.dwFlags = MOUSEEVENTF_MOVE | flags;
+}
+
+// Description:
+//   Adds an absolute cursor move to the batch. Equivalent to SetCursorPos, but delivered
+//     in order with the rest of the frame's events.
+//
+// Params:
+//   x  The horizontal screen coordinate to move the cursor to
+//   y  The vertical screen coordinate to move the cursor to
+void InputBatch::moveTo(int x, int y)
+{
+  const LONGLONG left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+  const LONGLONG top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+  const LONGLONG width = GetSystemMetrics(SM_CXVIRTUALSCREEN);
+  const LONGLONG height = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+  if (width <= 0 || height <= 0)
+  {
+    return;
+  }
+
+  // Absolute coordinates are normalized to 0..65535 across the virtual desktop. Round up so
+  // the system maps the value back to exactly the requested pixel.
+  INPUT &input = next();
+  input.type = INPUT_MOUSE;
+  input.mi.dx = (LONG)(((x - left) * 65536 + width - 1) / width);
+  input.mi.dy = (LONG)(((y - top) * 65536 + height - 1) / height);
+  input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_VIRTUALDESK;
+}
+
+// Description:
+//   Hands every buffered event to the sink in one call and empties the batch.
+void InputBatch::flush()
+{
+  if (_count == 0)
+  {
+    return;
+  }
+
+  _sink->send(_inputs, _count);
+  _count = 0;
+}
+
+// Description:
+//   Reserves the next event slot, flushing first if the batch is full.
+//
+// Returns:
+//   A zeroed event to fill in.
+INPUT &InputBatch::next()
+{
+  if (_count == CAPACITY)
+  {
+    flush();
+  }
+
+  INPUT &input = _inputs[_count++];
+  ZeroMemory(&input, sizeof(INPUT));
+  return input;
+}
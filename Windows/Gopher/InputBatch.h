@@ -0,0 +1,38 @@
+#pragma once
+
+#include <windows.h>
+
+#include "InputSink.h"
+
+// Collects the keyboard and mouse events produced during one frame so they can be handed to the
+// sink in a single call, i.e. a single SendInput for the system sink. Events keep the order they were added in.
+class InputBatch
+{
+private:
+  static const UINT CAPACITY = 64;  // Events buffered before an early flush is forced.
+
+  InputSink* _sink;
+  INPUT _inputs[CAPACITY];
+  UINT _count;
+
+public:
+  InputBatch(InputSink* sink);
+
+  void keyboard(WORD key, DWORD flags);
+
+  void mouse(DWORD flags, DWORD mouseData = 0);
+
+  void move(int dx, int dy, DWORD flags = 0);
+
+  void moveTo(int x, int y);
+
+  void flush();
+
+  UINT size() const
+  {
+    return _count;
+  }
+
+private:
+  INPUT &next();
+};
@@ -0,0 +1,341 @@
+#include "InputPoller.h"
+
+#include "Log.h"
+
+#include <algorithm>
+
+InputPoller::InputPoller(ControllerBackend* controllers, Stats* stats)
+  : _controllers(controllers)
+  , _stats(stats)
+  , _thread(NULL)
+  , _available(CreateEvent(NULL, FALSE, FALSE, NULL))
+  , _activated(CreateEvent(NULL, FALSE, FALSE, NULL))
+  , _running(false)
+  , _woken(false)
+  , _active(false)
+  , _rate(150)
+  , _idleRate(10)
+  , _idleTimeout(5000)
+  , _currentRate(150)
+  , _dropped(0)
+  , _settingsLock(SRWLOCK_INIT)
+  , _retune(false)
+  , _scheduler(150)
+{
+}
+
+InputPoller::~InputPoller()
+{
+  stop();
+  CloseHandle(_available);
+  CloseHandle(_activated);
+}
+
+// Description:
+//   Starts the polling thread at an elevated priority.
+void InputPoller::start()
+{
+  if (_thread != NULL)
+  {
+    return;
+  }
+
+  _running = true;
+  _thread = CreateThread(NULL, 0, threadProc, this, 0, NULL);
+  SetThreadPriority(_thread, THREAD_PRIORITY_HIGHEST);
+}
+
+// Description:
+//   Stops the polling thread and waits for it to exit.
+void InputPoller::stop()
+{
+  if (_thread == NULL)
+  {
+    return;
+  }
+
+  _running = false;
+  SetEvent(_activated);
+  WaitForSingleObject(_thread, INFINITE);
+  CloseHandle(_thread);
+  _thread = NULL;
+}
+
+// Description:
+//   Sets the polling rates. Takes effect on the next tick of the polling thread.
+//
+// Params:
+//   rate         The full polling rate in polls per second
+//   idleRate     The polling rate once the controller has been idle
+//   idleTimeout  Milliseconds without a new packet before switching to idleRate
+void InputPoller::setRates(int rate, int idleRate, int idleTimeout)
+{
+  _rate = rate;
+  _idleRate = idleRate;
+  _idleTimeout = idleTimeout;
+}
+
+// Description:
+//   Tells the poller whether unchanged controller states still need to be handed over,
+//     e.g. because a held stick keeps moving the cursor.
+//
+// Params:
+//   active   true to keep delivering samples at the full rate
+void InputPoller::setActive(bool active)
+{
+  // A polling thread sleeping on the input event has to start ticking.
+  if (!_active.exchange(active, std::memory_order_relaxed) && active)
+  {
+    SetEvent(_activated);
+  }
+}
+
+// Description:
+//   Sets how the polling thread is scheduled. Takes effect on the next pass of the polling
+//     thread, which is woken for it if it is waiting for input.
+//
+// Params:
+//   settings   The MMCSS task, affinity and power throttling of the polling thread
+void InputPoller::setThreadSettings(const ThreadSettings &settings)
+{
+  AcquireSRWLockExclusive(&_settingsLock);
+  _threadSettings = settings;
+  ReleaseSRWLockExclusive(&_settingsLock);
+
+  // Applied even when unchanged, so that settings that failed before are tried again.
+  _retune = true;
+  SetEvent(_activated);
+}
+
+// Description:
+//   Takes the oldest pending sample, blocking until one is available.
+//
+// Params:
+//   sample   Receives the sample
+//   timeout  Maximum time to wait in milliseconds (Optional)
+//
+// Returns:
+//   false if no sample arrived within the timeout, or wake was called.
+bool InputPoller::waitForSample(InputSample &sample, DWORD timeout)
+{
+  while (!_samples.pop(sample))
+  {
+    if (_woken.exchange(false) || WaitForSingleObject(_available, timeout) != WAIT_OBJECT_0)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Description:
+//   Makes a pending or the next waitForSample return without a sample, e.g. so the consumer
+//     can apply a new config while the controllers are idle. Can be called from any thread.
+void InputPoller::wake()
+{
+  _woken = true;
+  SetEvent(_available);
+}
+
+// Description:
+//   Gets the rate the polling thread is currently running at.
+//
+// Returns:
+//   The current number of polls per second.
+int InputPoller::getCurrentRate() const
+{
+  return _currentRate;
+}
+
+// Description:
+//   Gets the number of samples discarded because the ring was full.
+//
+// Returns:
+//   The total number of dropped samples.
+unsigned long InputPoller::getDroppedSamples() const
+{
+  return _dropped;
+}
+
+// Description:
+//   Reads the performance counter on the same clock used to timestamp samples.
+//
+// Returns:
+//   The current performance counter value.
+LONGLONG InputPoller::now() const
+{
+  return _scheduler.now();
+}
+
+// Description:
+//   Converts an interval between two sample timestamps to microseconds.
+//
+// Params:
+//   ticks  The interval in performance counter ticks
+//
+// Returns:
+//   The interval in microseconds.
+LONGLONG InputPoller::toMicroseconds(LONGLONG ticks) const
+{
+  return _scheduler.toMicroseconds(ticks);
+}
+
+DWORD WINAPI InputPoller::threadProc(LPVOID param)
+{
+  static_cast<InputPoller*>(param)->run();
+  return 0;
+}
+
+// Description:
+//   The polling thread body. Reads the controllers once per scheduler tick, or as soon as the
+//     backend signals a change while the consumer is not active, and pushes every sample that
+//     carries a new packet, or any sample while the consumer is active.
+void InputPoller::run()
+{
+  const HANDLE inputEvent = _controllers->getInputEvent();
+  bool waited = false;
+  DWORD lastPacketNumbers[XUSER_MAX_COUNT] = {};
+  DWORD lastConnected = 0;
+  LONGLONG lastTimestamp = 0;
+  LONGLONG lastActivity = _scheduler.now();
+  bool idle = false;
+  unsigned long missedTicks = 0;
+  LONGLONG lastLateness = -1;             // Lateness of the previous tick, -1 when the previous pass was not a regular tick.
+
+  _scheduler.setRate(_rate);
+  _currentRate = _scheduler.getRate();
+
+  while (_running)
+  {
+    if (_retune.exchange(false))
+    {
+      AcquireSRWLockShared(&_settingsLock);
+      const ThreadSettings settings = _threadSettings;
+      ReleaseSRWLockShared(&_settingsLock);
+      if (!_tuning.apply(settings))
+      {
+        logMessage(LOG_WARNING, "Cannot apply all the scheduling settings to the polling thread\n");
+      }
+      lastLateness = -1;
+    }
+
+    if (inputEvent != NULL && !_active.load(std::memory_order_relaxed))
+    {
+      // Nothing happens until a controller changes, the consumer needs samples again or stop is called.
+      HANDLE events[2] = { inputEvent, _activated };
+      WaitForMultipleObjects(2, events, FALSE, INFINITE);
+      waited = true;
+      lastLateness = -1;
+      if (!_running)
+      {
+        break;
+      }
+    }
+    else
+    {
+      if (waited)
+      {
+        _scheduler.restart();
+        waited = false;
+      }
+      const LONGLONG lateness = _scheduler.waitForNextTick();
+      _stats->record(STAT_OVERSHOOT, lateness);
+
+      // Jitter is the change of lateness between two consecutive ticks at the same rate.
+      if (lastLateness >= 0 && _scheduler.getMissedTicks() == missedTicks)
+      {
+        _stats->record(STAT_JITTER, lateness > lastLateness ? lateness - lastLateness : lastLateness - lateness);
+      }
+      lastLateness = lateness;
+    }
+    if (_scheduler.getMissedTicks() != missedTicks)
+    {
+      _stats->addMissedDeadlines(_scheduler.getMissedTicks() - missedTicks);
+      missedTicks = _scheduler.getMissedTicks();
+      lastLateness = -1;
+    }
+
+    // Pick up rate changes made by the consumer thread.
+    int targetRate = idle ? _idleRate : _rate;
+    if (targetRate != _scheduler.getRate())
+    {
+      _scheduler.setRate(targetRate);
+      _currentRate = targetRate;
+      lastLateness = -1;
+    }
+
+    InputSample sample;
+    const LONGLONG started = _scheduler.now();
+    sample.timestamp = started;
+    sample.connected = _controllers->poll(sample.states, started);
+    LONGLONG polled = _scheduler.now();
+    _stats->record(STAT_POLL, _scheduler.toMicroseconds(polled - started));
+
+    // Connecting or disconnecting a controller counts as a change as well.
+    bool changed = sample.connected != lastConnected;
+    lastConnected = sample.connected;
+    for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+    {
+      if ((sample.connected & (1 << i)) && sample.states[i].dwPacketNumber != lastPacketNumbers[i])
+      {
+        lastPacketNumbers[i] = sample.states[i].dwPacketNumber;
+        changed = true;
+      }
+    }
+    _stats->record(STAT_DIFF, _scheduler.toMicroseconds(_scheduler.now() - polled));
+
+    if (changed)
+    {
+      // A new packet is dated by when it reached the backend, if the backend knows.
+      const LONGLONG reported = _controllers->getReportTime();
+      if (reported != 0 && reported <= started)
+      {
+        sample.timestamp = reported;
+      }
+
+      // Samples stay in order, even when a report arrived before the one dated by the last sample.
+      sample.timestamp = (std::max)(sample.timestamp, lastTimestamp);
+      lastTimestamp = sample.timestamp;
+
+      lastActivity = started;
+      if (idle)
+      {
+        idle = false;
+        _scheduler.setRate(_rate);
+        _currentRate = _scheduler.getRate();
+        lastLateness = -1;
+      }
+    }
+    else if (_active.load(std::memory_order_relaxed))
+    {
+      lastActivity = started;
+    }
+    else
+    {
+      // Nothing new to hand over. Drop to the idle rate once the controllers have been quiet long enough.
+      if (!idle && _scheduler.toMicroseconds(started - lastActivity) > (LONGLONG)_idleTimeout * 1000)
+      {
+        idle = true;
+        _scheduler.setRate(_idleRate);
+        _currentRate = _scheduler.getRate();
+        lastLateness = -1;
+      }
+      continue;
+    }
+
+    if (_samples.push(sample))
+    {
+      SetEvent(_available);
+    }
+    else
+    {
+      ++_dropped;
+      _stats->setDroppedSamples(_dropped);
+    }
+  }
+
+  // A restarted thread applies the settings again.
+  _tuning.reset();
+  _retune = true;
+}
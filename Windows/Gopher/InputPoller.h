@@ -0,0 +1,88 @@
+#pragma once
+
+#include <windows.h>
+#include <xinput.h>
+#include <atomic>
+
+#include "ControllerBackend.h"
+#include "RingBuffer.h"
+#include "Scheduler.h"
+#include "Stats.h"
+#include "ThreadTuning.h"
+
+// The states of every controller captured by one pass of the polling thread.
+struct InputSample
+{
+  XINPUT_STATE states[XUSER_MAX_COUNT];   // The polled controller states.
+  DWORD connected;                        // Bit n is set when the controller in slot n is connected.
+  LONGLONG timestamp;                     // Performance counter value at the time of the poll, or at which a new packet arrived if the backend times them.
+};
+
+// Polls all controllers on a dedicated, elevated-priority thread and hands the samples to a
+// single consumer thread through a lock-free ring. The poller also owns the adaptive polling
+// rate: it drops to the idle rate when no controller has changed for a while and returns to
+// the full rate on the first new packet. With a backend that signals its input, the thread
+// instead sleeps until a controller changes whenever the consumer does not need steady samples,
+// and hands the change over as soon as it arrives.
+class InputPoller
+{
+private:
+  static const size_t SAMPLE_CAPACITY = 512;  // About three seconds of samples at 150 Hz.
+
+  ControllerBackend* _controllers;
+  Stats* _stats;
+  SpscRing<InputSample, SAMPLE_CAPACITY> _samples;
+  HANDLE _thread;                         // The polling thread.
+  HANDLE _available;                      // Auto-reset event signalled after samples are pushed.
+  HANDLE _activated;                      // Auto-reset event signalled when the consumer becomes active.
+
+  std::atomic<bool> _running;
+  std::atomic<bool> _woken;               // Set by wake to end a waitForSample without a sample.
+  std::atomic<bool> _active;              // Set by the consumer while unchanged states still need handling.
+  std::atomic<int> _rate;                 // Full polling rate.
+  std::atomic<int> _idleRate;             // Polling rate used after the idle timeout.
+  std::atomic<int> _idleTimeout;          // Milliseconds without a new packet before dropping to the idle rate.
+  std::atomic<int> _currentRate;          // The rate the polling thread is running at.
+  std::atomic<unsigned long> _dropped;    // Samples lost because the consumer fell a whole ring behind.
+
+  ThreadSettings _threadSettings;         // Scheduling of the polling thread, guarded by _settingsLock.
+  SRWLOCK _settingsLock;
+  std::atomic<bool> _retune;              // Set when _threadSettings changed since the polling thread applied them.
+
+  Scheduler _scheduler;                   // Only used by the polling thread.
+  ThreadTuning _tuning;                   // Only used by the polling thread.
+
+public:
+  InputPoller(ControllerBackend* controllers, Stats* stats);
+  ~InputPoller();
+
+  void start();
+
+  void stop();
+
+  void setRates(int rate, int idleRate, int idleTimeout);
+
+  void setActive(bool active);
+
+  void setThreadSettings(const ThreadSettings &settings);
+
+  bool waitForSample(InputSample &sample, DWORD timeout = INFINITE);
+
+  void wake();
+
+  int getCurrentRate() const;
+
+  unsigned long getDroppedSamples() const;
+
+  LONGLONG now() const;
+
+  LONGLONG toMicroseconds(LONGLONG ticks) const;
+
+private:
+  static DWORD WINAPI threadProc(LPVOID param);
+
+  void run();
+
+  InputPoller(const InputPoller&) = delete;
+  InputPoller& operator=(const InputPoller&) = delete;
+};
@@ -0,0 +1,22 @@
+#include "InputSink.h"
+
+// Description:
+//   Injects the events into the system input stream with one SendInput call.
+//
+// Params:
+//   inputs   The events to inject
+//   count    Number of events in inputs
+void SystemInputSink::send(const INPUT *inputs, UINT count)
+{
+  SendInput(count, const_cast<INPUT*>(inputs), sizeof(INPUT));
+}
+
+// Description:
+//   Reads the position of the system cursor.
+//
+// Params:
+//   point  Receives the position in screen coordinates
+void SystemInputSink::getCursorPos(POINT &point)
+{
+  GetCursorPos(&point);
+}
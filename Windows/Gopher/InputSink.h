@@ -0,0 +1,35 @@
+#pragma once
+
+#include <windows.h>
+
+// Destination of the system inputs generated by Gopher. The cursor position is read through
+// the sink as well, so the whole mapping pipeline can run against a simulated desktop.
+class InputSink
+{
+public:
+  virtual ~InputSink() {}
+
+  // Description:
+  //   Delivers the events of one batch, in order.
+  //
+  // Params:
+  //   inputs   The events to deliver
+  //   count    Number of events in inputs
+  virtual void send(const INPUT *inputs, UINT count) = 0;
+
+  // Description:
+  //   Reads the current cursor position.
+  //
+  // Params:
+  //   point  Receives the position in screen coordinates
+  virtual void getCursorPos(POINT &point) = 0;
+};
+
+// Sends the inputs to the system with SendInput.
+class SystemInputSink : public InputSink
+{
+public:
+  void send(const INPUT *inputs, UINT count) override;
+
+  void getCursorPos(POINT &point) override;
+};
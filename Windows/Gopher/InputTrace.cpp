@@ -0,0 +1,56 @@
+#include "InputTrace.h"
+
+#include <fstream>
+
+// Description:
+//   Reads every controller sample of a trace file.
+//
+// Params:
+//   path       The trace file to read
+//   samples    Receives the samples in recording order
+//   frequency  Receives the counter frequency of the sample timestamps
+//
+// Returns:
+//   false if the file cannot be read or is not a trace. A truncated last record is ignored.
+//     Input records are skipped.
+bool loadTraceSamples(const std::string &path, std::vector<InputSample> &samples, LONGLONG &frequency)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    return false;
+  }
+
+  TraceFileHeader header;
+  if (!file.read((char*)&header, sizeof(header)) ||
+      header.magic != TraceFileHeader::MAGIC ||
+      header.version > TraceFileHeader::VERSION)
+  {
+    return false;
+  }
+  frequency = header.frequency;
+
+  TraceRecord record;
+  while (file.read((char*)&record, sizeof(record)) && record.type != TRACE_END)
+  {
+    if (record.type != TRACE_SAMPLE || record.size != sizeof(TraceSample))
+    {
+      file.seekg(record.size, std::ios::cur);
+      continue;
+    }
+
+    TraceSample payload;
+    if (!file.read((char*)&payload, sizeof(payload)))
+    {
+      break;
+    }
+
+    InputSample sample;
+    sample.timestamp = record.timestamp;
+    sample.connected = payload.connected;
+    memcpy(sample.states, payload.states, sizeof(sample.states));
+    samples.push_back(sample);
+  }
+
+  return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <windows.h>
+#include <xinput.h>
+#include <string>
+#include <vector>
+
+#include "InputPoller.h"
+
+// Binary input trace. A file starts with a TraceFileHeader and continues with records, each a
+// TraceRecord header followed by `size` bytes of payload. Readers skip record types they do
+// not know, so new types can be added without breaking older tools. A record of type
+// TRACE_END, e.g. the zeroed tail of a preallocated file, ends the trace.
+enum TraceRecordType
+{
+  TRACE_END = 0,
+  TRACE_SAMPLE = 1,   // Payload is a TraceSample.
+  TRACE_INPUT = 2,    // Payload is the INPUT array of one SendInput call.
+};
+
+struct TraceFileHeader
+{
+  static const DWORD MAGIC = 0x52543347;  // "G3TR"
+  static const DWORD VERSION = 1;
+
+  DWORD magic;
+  DWORD version;
+  LONGLONG frequency;   // Performance counter ticks per second of the record timestamps.
+};
+
+struct TraceRecord
+{
+  DWORD type;           // A TraceRecordType.
+  DWORD size;           // Bytes of payload following the record.
+  LONGLONG timestamp;   // Performance counter value of the event.
+};
+
+// The controller states of one poll.
+struct TraceSample
+{
+  DWORD connected;
+  XINPUT_STATE states[XUSER_MAX_COUNT];
+};
+
+bool loadTraceSamples(const std::string &path, std::vector<InputSample> &samples, LONGLONG &frequency);
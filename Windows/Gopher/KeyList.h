@@ -0,0 +1,96 @@
+#pragma once
+
+#include <windows.h>
+
+// Fixed-capacity list of virtual key codes stored inline, so key chords and the set of held
+// keys can be copied and edited every frame without touching the heap. Keys keep the order
+// they were added in.
+template<size_t Capacity>
+class KeyList
+{
+public:
+  static const size_t CAPACITY = Capacity;
+
+private:
+  WORD _keys[Capacity];
+  size_t _count;
+
+public:
+  KeyList()
+    : _count(0)
+  {
+  }
+
+  // Description:
+  //   Appends a key.
+  //
+  // Params:
+  //   key  The virtual key code to add
+  //
+  // Returns:
+  //   false if the list is full and the key was not added.
+  bool push_back(WORD key)
+  {
+    if (_count == Capacity)
+    {
+      return false;
+    }
+
+    _keys[_count++] = key;
+    return true;
+  }
+
+  // Description:
+  //   Removes the first occurrence of a key, keeping the order of the others.
+  //
+  // Params:
+  //   key  The virtual key code to remove
+  //
+  // Returns:
+  //   true if the key was found and removed.
+  bool erase(WORD key)
+  {
+    for (size_t i = 0; i < _count; ++i)
+    {
+      if (_keys[i] == key)
+      {
+        for (--_count; i < _count; ++i)
+        {
+          _keys[i] = _keys[i + 1];
+        }
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void clear()
+  {
+    _count = 0;
+  }
+
+  size_t size() const
+  {
+    return _count;
+  }
+
+  bool empty() const
+  {
+    return _count == 0;
+  }
+
+  const WORD *begin() const
+  {
+    return _keys;
+  }
+
+  const WORD *end() const
+  {
+    return _keys + _count;
+  }
+};
+
+// Keys sent by one binding. Keys past the capacity are ignored when the config is loaded.
+static const size_t CHORD_CAPACITY = 8;
+typedef KeyList<CHORD_CAPACITY> KeyChord;
@@ -0,0 +1,530 @@
+#include "Log.h"
+#include "RingBuffer.h"
+
+#include <windows.h>
+#include <winmeta.h>
+#include <TraceLoggingProvider.h>
+#include <atomic>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// Provider the messages are written to when ETW output is on, e.g. for
+// "wpr -start" or "tracelog" with its GUID {5B2E7C19-8D43-4A6F-9E07-C3D1F4A8B265}.
+TRACELOGGING_DEFINE_PROVIDER(logProvider, "Gopher360",
+  (0x5b2e7c19, 0x8d43, 0x4a6f, 0x9e, 0x07, 0xc3, 0xd1, 0xf4, 0xa8, 0xb2, 0x65));
+
+static const ULONGLONG REPEAT_WINDOW = 10000000;  // FILETIME ticks (100 ns) a message must wait to be written again in full.
+static const char *const LEVEL_NAMES[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+
+struct LogEntry
+{
+  LogLevel level;
+  ULONGLONG time;               // FILETIME of the call, in UTC.
+  char text[LOG_LINE_LENGTH];
+};
+
+// The queue and the writer thread behind the log functions.
+class Logger
+{
+private:
+  MpscRing<LogEntry, LOG_QUEUE_SIZE> _queue;
+  std::atomic<unsigned int> _dropped;  // Messages lost to a full queue since the writer last reported it.
+  std::atomic<int> _level;             // Messages below this level are not queued at all.
+  std::atomic<bool> _console;
+  std::atomic<bool> _etw;
+  std::atomic<bool> _waiting;          // Set while the writer waits, so producers only signal it then.
+  std::atomic<bool> _stopping;
+  HANDLE _wake;
+  HANDLE _thread;
+
+  SRWLOCK _fileLock;                   // Guards _filePath and _fileChanged.
+  std::string _filePath;               // File asked for by setLogFile, "0" for none.
+  bool _fileChanged;
+
+  // Only used by the writer thread.
+  HANDLE _file;
+  bool _etwRegistered;
+  LogEntry _last;                      // Last message written in full.
+  unsigned int _repeats;               // Copies of _last counted instead of written.
+
+  SRWLOCK _linesLock;                  // Guards the ring of lines, which getLogText reads.
+  char _lines[LOG_LINES][LOG_LINE_LENGTH];
+  size_t _nextLine;
+  size_t _lineCount;
+
+public:
+  Logger();
+  ~Logger();
+
+  void log(LogLevel level, const char *format, va_list args);
+
+  void setLevel(LogLevel level)
+  {
+    _level.store(level, std::memory_order_relaxed);
+  }
+
+  void setConsole(bool console)
+  {
+    _console.store(console, std::memory_order_relaxed);
+  }
+
+  void setEtw(bool etw)
+  {
+    _etw.store(etw, std::memory_order_relaxed);
+    wake();
+  }
+
+  void setFile(const std::string &path);
+
+  std::string getText();
+
+private:
+  static DWORD WINAPI threadProc(LPVOID param);
+
+  void run();
+
+  void wake();
+
+  void updateOutputs();
+
+  void handle(const LogEntry &entry);
+
+  void flushRepeats(ULONGLONG time);
+
+  void write(const LogEntry &entry);
+
+  void writeFile(const LogEntry &entry);
+
+  void writeEtw(const LogEntry &entry);
+
+  Logger(const Logger&) = delete;
+  Logger& operator=(const Logger&) = delete;
+};
+
+// Description:
+//   Gets the logger, starting its writer thread on first use.
+static Logger &getLogger()
+{
+  static Logger logger;
+  return logger;
+}
+
+static ULONGLONG getTime()
+{
+  FILETIME now;
+  GetSystemTimeAsFileTime(&now);
+  return ((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime;
+}
+
+Logger::Logger()
+  : _dropped(0)
+  , _level(LOG_INFO)
+  , _console(false)
+  , _etw(false)
+  , _waiting(false)
+  , _stopping(false)
+  , _wake(CreateEvent(NULL, FALSE, FALSE, NULL))
+  , _thread(NULL)
+  , _fileLock(SRWLOCK_INIT)
+  , _filePath("0")
+  , _fileChanged(false)
+  , _file(INVALID_HANDLE_VALUE)
+  , _etwRegistered(false)
+  , _repeats(0)
+  , _linesLock(SRWLOCK_INIT)
+  , _nextLine(0)
+  , _lineCount(0)
+{
+  ZeroMemory(&_last, sizeof(_last));
+  _thread = CreateThread(NULL, 0, threadProc, this, 0, NULL);
+}
+
+Logger::~Logger()
+{
+  if (_thread != NULL)
+  {
+    _stopping.store(true);
+    SetEvent(_wake);
+    WaitForSingleObject(_thread, INFINITE);
+    CloseHandle(_thread);
+  }
+  CloseHandle(_wake);
+}
+
+// Description:
+//   Formats a message and queues it for the writer thread. Never blocks.
+void Logger::log(LogLevel level, const char *format, va_list args)
+{
+  if (level < _level.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+
+  LogEntry entry;
+  entry.level = level;
+  entry.time = getTime();
+  vsnprintf(entry.text, sizeof(entry.text), format, args);
+
+  if (!_queue.push(entry))
+  {
+    _dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  wake();
+}
+
+// Description:
+//   Signals the writer thread if it is waiting. Costs a fence and an atomic exchange when it is
+//     busy.
+void Logger::wake()
+{
+  // Pairs with the fence in run: either the writer sees what was pushed, or this sees _waiting.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (_waiting.exchange(false))
+  {
+    SetEvent(_wake);
+  }
+}
+
+// Description:
+//   Asks for messages to be appended to a file from now on. The file is opened by the writer
+//     thread.
+//
+// Params:
+//   path   The file, or "0" to stop writing to a file
+void Logger::setFile(const std::string &path)
+{
+  AcquireSRWLockExclusive(&_fileLock);
+  if (path != _filePath)
+  {
+    _filePath = path;
+    _fileChanged = true;
+  }
+  ReleaseSRWLockExclusive(&_fileLock);
+  wake();
+}
+
+// Description:
+//   Gets the lines in the ring.
+//
+// Returns:
+//   The lines from the oldest to the newest.
+std::string Logger::getText()
+{
+  std::string text;
+  AcquireSRWLockShared(&_linesLock);
+  for (size_t i = 0; i < _lineCount; ++i)
+  {
+    text += _lines[(_nextLine + LOG_LINES - _lineCount + i) % LOG_LINES];
+    if (text.empty() || text.back() != '\n')
+    {
+      text += '\n';
+    }
+  }
+  ReleaseSRWLockShared(&_linesLock);
+  return text;
+}
+
+DWORD WINAPI Logger::threadProc(LPVOID param)
+{
+  static_cast<Logger*>(param)->run();
+  return 0;
+}
+
+// Description:
+//   The writer thread body. Writes out queued messages and sleeps until more come in, or until
+//     the count of a repeated message is due.
+void Logger::run()
+{
+  while (true)
+  {
+    updateOutputs();
+
+    LogEntry entry;
+    while (_queue.pop(entry))
+    {
+      handle(entry);
+    }
+
+    const unsigned int dropped = _dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+      LogEntry notice;
+      notice.level = LOG_WARNING;
+      notice.time = getTime();
+      snprintf(notice.text, sizeof(notice.text), "%u log messages were dropped\n", dropped);
+      handle(notice);
+    }
+
+    if (_console.load(std::memory_order_relaxed))
+    {
+      fflush(stdout);
+    }
+
+    if (_stopping.load())
+    {
+      break;
+    }
+
+    // Producers signal only once they see _waiting, so look at the queue again after setting it.
+    _waiting.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!_queue.empty() || _stopping.load())
+    {
+      _waiting.store(false);
+      continue;
+    }
+
+    DWORD timeout = INFINITE;
+    if (_repeats > 0)
+    {
+      const ULONGLONG elapsed = getTime() - _last.time;
+      timeout = elapsed >= REPEAT_WINDOW ? 0 : (DWORD)((REPEAT_WINDOW - elapsed) / 10000) + 1;
+    }
+    if (WaitForSingleObject(_wake, timeout) == WAIT_TIMEOUT)
+    {
+      _waiting.store(false);
+      flushRepeats(getTime());
+    }
+  }
+
+  flushRepeats(getTime());
+  if (_file != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(_file);
+  }
+  if (_etwRegistered)
+  {
+    TraceLoggingUnregister(logProvider);
+  }
+}
+
+// Description:
+//   Opens or closes the file and ETW outputs as the settings ask.
+void Logger::updateOutputs()
+{
+  AcquireSRWLockExclusive(&_fileLock);
+  const bool fileChanged = _fileChanged;
+  const std::string path = _filePath;
+  _fileChanged = false;
+  ReleaseSRWLockExclusive(&_fileLock);
+
+  if (fileChanged)
+  {
+    if (_file != INVALID_HANDLE_VALUE)
+    {
+      CloseHandle(_file);
+      _file = INVALID_HANDLE_VALUE;
+    }
+    if (path != "0" && !path.empty())
+    {
+      _file = CreateFileA(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    }
+  }
+
+  const bool etw = _etw.load(std::memory_order_relaxed);
+  if (etw && !_etwRegistered)
+  {
+    _etwRegistered = SUCCEEDED(TraceLoggingRegister(logProvider));
+  }
+  else if (!etw && _etwRegistered)
+  {
+    TraceLoggingUnregister(logProvider);
+    _etwRegistered = false;
+  }
+}
+
+// Description:
+//   Writes a message, or counts it if it repeats the last one within REPEAT_WINDOW.
+void Logger::handle(const LogEntry &entry)
+{
+  if (entry.level == _last.level && entry.time - _last.time < REPEAT_WINDOW && strcmp(entry.text, _last.text) == 0)
+  {
+    ++_repeats;
+    return;
+  }
+
+  flushRepeats(entry.time);
+  write(entry);
+  _last = entry;
+}
+
+// Description:
+//   Writes how many copies of the last message were counted, if any.
+//
+// Params:
+//   time   Time to give the count. Copies of the last message after it are counted again.
+void Logger::flushRepeats(ULONGLONG time)
+{
+  if (_repeats == 0)
+  {
+    return;
+  }
+
+  LogEntry notice;
+  notice.level = _last.level;
+  notice.time = time;
+  snprintf(notice.text, sizeof(notice.text), "Last message repeated %u times\n", _repeats);
+  _repeats = 0;
+  write(notice);
+  _last.time = time;
+}
+
+// Description:
+//   Writes a message to every output.
+void Logger::write(const LogEntry &entry)
+{
+  AcquireSRWLockExclusive(&_linesLock);
+  memcpy(_lines[_nextLine], entry.text, sizeof(entry.text));
+  _nextLine = (_nextLine + 1) % LOG_LINES;
+  if (_lineCount < LOG_LINES)
+  {
+    ++_lineCount;
+  }
+  ReleaseSRWLockExclusive(&_linesLock);
+
+  if (_console.load(std::memory_order_relaxed))
+  {
+    fputs(entry.text, stdout);
+  }
+  if (_file != INVALID_HANDLE_VALUE)
+  {
+    writeFile(entry);
+  }
+  if (_etwRegistered)
+  {
+    writeEtw(entry);
+  }
+}
+
+// Description:
+//   Appends a message to the log file with its local time and level.
+void Logger::writeFile(const LogEntry &entry)
+{
+  FILETIME utc;
+  utc.dwLowDateTime = (DWORD)entry.time;
+  utc.dwHighDateTime = (DWORD)(entry.time >> 32);
+  FILETIME local;
+  SYSTEMTIME time;
+  ZeroMemory(&time, sizeof(time));
+  if (FileTimeToLocalFileTime(&utc, &local))
+  {
+    FileTimeToSystemTime(&local, &time);
+  }
+
+  char line[LOG_LINE_LENGTH + 48];
+  int length = snprintf(line, sizeof(line), "%04u-%02u-%02u %02u:%02u:%02u.%03u %-7s %s",
+                        time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond, time.wMilliseconds,
+                        LEVEL_NAMES[entry.level], entry.text);
+  if (length <= 0)
+  {
+    return;
+  }
+  if ((size_t)length >= sizeof(line))
+  {
+    length = sizeof(line) - 1;
+  }
+  // A message cut at LOG_LINE_LENGTH has lost its newline.
+  if (line[length - 1] != '\n')
+  {
+    if ((size_t)length == sizeof(line) - 1)
+    {
+      line[length - 1] = '\n';
+    }
+    else
+    {
+      line[length++] = '\n';
+    }
+  }
+
+  DWORD written;
+  WriteFile(_file, line, (DWORD)length, &written, NULL);
+}
+
+// Description:
+//   Writes a message as an ETW event. The level of a TraceLogging event is part of its metadata,
+//     so there is one event per level.
+void Logger::writeEtw(const LogEntry &entry)
+{
+  // ETW consumers show the text as a field; the newline only matters to the other outputs.
+  char text[LOG_LINE_LENGTH];
+  memcpy(text, entry.text, sizeof(text));
+  const size_t length = strlen(text);
+  if (length > 0 && text[length - 1] == '\n')
+  {
+    text[length - 1] = '\0';
+  }
+
+  switch (entry.level)
+  {
+  case LOG_DEBUG:
+    TraceLoggingWrite(logProvider, "Message", TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE), TraceLoggingString(text, "Text"));
+    break;
+  case LOG_INFO:
+    TraceLoggingWrite(logProvider, "Message", TraceLoggingLevel(WINEVENT_LEVEL_INFO), TraceLoggingString(text, "Text"));
+    break;
+  case LOG_WARNING:
+    TraceLoggingWrite(logProvider, "Message", TraceLoggingLevel(WINEVENT_LEVEL_WARNING), TraceLoggingString(text, "Text"));
+    break;
+  case LOG_ERROR:
+    TraceLoggingWrite(logProvider, "Message", TraceLoggingLevel(WINEVENT_LEVEL_ERROR), TraceLoggingString(text, "Text"));
+    break;
+  }
+}
+
+// Description:
+//   Adds a message to the log. Messages longer than LOG_LINE_LENGTH are cut. Safe to call from
+//     any thread, and never waits for the message to be written.
+//
+// Params:
+//   level    Severity of the message. Messages below the level set with setLogLevel are ignored.
+//   format   printf format of the message, ending in a newline
+void logMessage(LogLevel level, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  getLogger().log(level, format, args);
+  va_end(args);
+}
+
+// Description:
+//   Sets the lowest level of the messages kept. LOG_INFO by default.
+void setLogLevel(LogLevel level)
+{
+  getLogger().setLevel(level);
+}
+
+// Description:
+//   Sets whether messages are printed to the console.
+void setLogConsole(bool console)
+{
+  getLogger().setConsole(console);
+}
+
+// Description:
+//   Sets the file messages are appended to, with their time and level.
+//
+// Params:
+//   path   The file, or "0" to stop writing to a file
+void setLogFile(const std::string &path)
+{
+  getLogger().setFile(path);
+}
+
+// Description:
+//   Sets whether messages are written as ETW events of the Gopher360 provider.
+void setLogEtw(bool etw)
+{
+  getLogger().setEtw(etw);
+}
+
+// Description:
+//   Gets the last LOG_LINES messages written.
+//
+// Returns:
+//   The messages from the oldest to the newest, one per line.
+std::string getLogText()
+{
+  return getLogger().getText();
+}
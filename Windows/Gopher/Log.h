@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+// Messages are formatted by the thread logging them into a lock-free queue, and written out by a
+// thread of their own: to a ring of the most recent LOG_LINES lines, so a build without a console
+// can still show what happened, and optionally to the console, a file and ETW. Logging never
+// waits on any of them, so the input thread is not held up by a slow console or disk. A message
+// repeated within a second is counted instead of written again.
+const size_t LOG_LINES = 64;
+const size_t LOG_LINE_LENGTH = 160;
+const size_t LOG_QUEUE_SIZE = 256;  // Messages waiting to be written. Further messages are dropped and counted.
+
+enum LogLevel
+{
+  LOG_DEBUG,
+  LOG_INFO,
+  LOG_WARNING,
+  LOG_ERROR
+};
+
+void logMessage(LogLevel level, const char *format, ...);
+
+void setLogLevel(LogLevel level);
+
+void setLogConsole(bool console);
+
+void setLogFile(const std::string &path);
+
+void setLogEtw(bool etw);
+
+std::string getLogText();
@@ -0,0 +1,182 @@
+#include "OskTracker.h"
+#include "Log.h"
+
+#include <shellapi.h>
+#include <stdio.h>
+#include <tchar.h>
+
+// Window class of the On-Screen Keyboard. Unlike its title, it does not depend on the language.
+static const TCHAR OSK_CLASS[] = _T("OSKMainClass");
+
+OskTracker *OskTracker::_instance = nullptr;
+
+OskTracker::OskTracker()
+  : _window(NULL)
+  , _thread(NULL)
+  , _threadId(0)
+  , _started(CreateEvent(NULL, TRUE, FALSE, NULL))
+{
+}
+
+OskTracker::~OskTracker()
+{
+  stop();
+  CloseHandle(_started);
+}
+
+// Description:
+//   Starts following the On-Screen Keyboard window. Does nothing if the tracker is already
+//     running.
+//
+// Returns:
+//   false if the tracker thread could not be started.
+bool OskTracker::start()
+{
+  if (_thread != NULL)
+  {
+    return true;
+  }
+
+  ResetEvent(_started);
+  _thread = CreateThread(NULL, 0, threadProc, this, 0, &_threadId);
+  if (_thread == NULL)
+  {
+    return false;
+  }
+
+  // Messages can only be posted once the thread has a message queue.
+  WaitForSingleObject(_started, INFINITE);
+  return true;
+}
+
+// Description:
+//   Stops the tracker thread and waits for it to exit.
+void OskTracker::stop()
+{
+  if (_thread == NULL)
+  {
+    return;
+  }
+
+  PostThreadMessage(_threadId, WM_QUIT, 0, 0);
+  WaitForSingleObject(_thread, INFINITE);
+  CloseHandle(_thread);
+  _thread = NULL;
+}
+
+// Description:
+//   Starts osk.exe on the tracker thread and returns right away. The window is picked up by
+//     the hooks once it is created.
+//
+// Returns:
+//   false if the tracker is not running.
+bool OskTracker::launch()
+{
+  return _thread != NULL && PostThreadMessage(_threadId, WM_LAUNCH, 0, 0);
+}
+
+DWORD WINAPI OskTracker::threadProc(LPVOID param)
+{
+  static_cast<OskTracker*>(param)->run();
+  return 0;
+}
+
+void CALLBACK OskTracker::eventProc(HWINEVENTHOOK hook, DWORD event, HWND window, LONG object, LONG child, DWORD thread, DWORD time)
+{
+  // Most of the events are about other objects of other windows.
+  if (_instance == nullptr || object != OBJID_WINDOW || child != CHILDID_SELF || window == NULL)
+  {
+    return;
+  }
+
+  if (event == EVENT_OBJECT_DESTROY)
+  {
+    HWND expected = window;
+    _instance->_window.compare_exchange_strong(expected, NULL, std::memory_order_acq_rel);
+  }
+  else if (event == EVENT_OBJECT_CREATE && isOskWindow(window))
+  {
+    _instance->_window.store(window, std::memory_order_release);
+  }
+}
+
+// Description:
+//   Tells whether a window is the On-Screen Keyboard.
+bool OskTracker::isOskWindow(HWND window)
+{
+  TCHAR name[32];
+  return GetClassName(window, name, 32) != 0 && _tcscmp(name, OSK_CLASS) == 0;
+}
+
+// Description:
+//   The tracker thread body. Out of context WinEvent hooks are called from the message loop of
+//     the thread that set them.
+void OskTracker::run()
+{
+  MSG msg;
+  PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);  // Creates the message queue.
+
+  // ShellExecuteEx may use COM.
+  CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+
+  _instance = this;
+  HWINEVENTHOOK hook = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_DESTROY, NULL, eventProc, 0, 0,
+                                       WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+  SetEvent(_started);
+
+  // Look for a keyboard that was running before the hook was set.
+  HWND window = FindWindow(OSK_CLASS, NULL);
+  if (window != NULL)
+  {
+    HWND expected = NULL;
+    _window.compare_exchange_strong(expected, window, std::memory_order_acq_rel);
+  }
+
+  while (GetMessage(&msg, NULL, 0, 0) > 0)
+  {
+    if (msg.hwnd == NULL && msg.message == WM_LAUNCH)
+    {
+      runOsk();
+      continue;
+    }
+    DispatchMessage(&msg);
+  }
+
+  if (hook != NULL)
+  {
+    UnhookWinEvent(hook);
+  }
+  _instance = nullptr;
+  CoUninitialize();
+}
+
+// Description:
+//   Starts osk.exe unless it is already running.
+void OskTracker::runOsk()
+{
+  if (getWindow() != NULL)
+  {
+    return;
+  }
+
+  // A 32 bit process on 64 bit Windows would be redirected to SysWOW64, which has no osk.exe.
+  PVOID redirection = NULL;
+  const BOOL redirected = Wow64DisableWow64FsRedirection(&redirection);
+
+  SHELLEXECUTEINFO info;
+  ZeroMemory(&info, sizeof(info));
+  info.cbSize = sizeof(info);
+  info.fMask = SEE_MASK_NOASYNC | SEE_MASK_FLAG_NO_UI;
+  info.lpVerb = _T("open");
+  info.lpFile = _T("osk.exe");
+  info.nShow = SW_SHOWNORMAL;
+  if (!ShellExecuteEx(&info))
+  {
+    logMessage(LOG_ERROR, "Cannot start the On-screen keyboard (error %u)\n", (unsigned int)GetLastError());
+  }
+
+  if (redirected)
+  {
+    Wow64RevertWow64FsRedirection(redirection);
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+
+// Keeps the window of the Windows On-Screen Keyboard at hand. The window is looked up once, then
+// followed with window create and destroy WinEvent hooks on a thread of its own, so finding it
+// costs an atomic load however many windows are open. The same thread launches osk.exe when it
+// is asked for and not running, which would otherwise stall the caller.
+class OskTracker
+{
+private:
+  static const UINT WM_LAUNCH = WM_USER + 1;  // Posted to the tracker thread to start osk.exe.
+
+  std::atomic<HWND> _window;        // The On-Screen Keyboard window, or NULL when it is not running.
+  HANDLE _thread;
+  DWORD _threadId;
+  HANDLE _started;                  // Set once the tracker thread has a message queue.
+
+  static OskTracker *_instance;     // WinEvent callbacks carry no context; there is one tracker.
+
+public:
+  OskTracker();
+  ~OskTracker();
+
+  bool start();
+
+  void stop();
+
+  // Description:
+  //   Gets the On-Screen Keyboard window. Safe to call from any thread.
+  //
+  // Returns:
+  //   The window, or NULL when the On-Screen Keyboard is not running.
+  HWND getWindow() const
+  {
+    return _window.load(std::memory_order_acquire);
+  }
+
+  bool launch();
+
+private:
+  static DWORD WINAPI threadProc(LPVOID param);
+
+  static void CALLBACK eventProc(HWINEVENTHOOK hook, DWORD event, HWND window, LONG object, LONG child, DWORD thread, DWORD time);
+
+  static bool isOskWindow(HWND window);
+
+  void run();
+
+  void runOsk();
+
+  OskTracker(const OskTracker&) = delete;
+  OskTracker& operator=(const OskTracker&) = delete;
+};
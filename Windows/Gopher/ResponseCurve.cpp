@@ -0,0 +1,116 @@
+#include "ResponseCurve.h"
+
+#include <windows.h>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+// Largest possible squared deflection, reached with both axes at -32768.
+static const float MAX_LENGTHSQ = 2.0f * 32768.0f * 32768.0f;
+
+ResponseCurve::ResponseCurve()
+  : _indexScale(TABLE_SIZE / MAX_LENGTHSQ)
+{
+  std::fill(_table, _table + TABLE_SIZE + 1, 0.0f);
+}
+
+// Description:
+//   Applies a piecewise linear curve. Inputs past the last point continue along the last segment.
+//
+// Params:
+//   points   The curve points, sorted by input
+//   input    The normalized deflection
+//
+// Returns:
+//   The normalized output for the input.
+static float evaluatePoints(const std::vector<CurvePoint> &points, float input)
+{
+  size_t i = 1;
+  while (i < points.size() - 1 && input > points[i].input)
+  {
+    ++i;
+  }
+
+  const CurvePoint &a = points[i - 1];
+  const CurvePoint &b = points[i];
+  if (b.input - a.input < 0.00001f)
+  {
+    return b.output;
+  }
+
+  return a.output + (b.output - a.output) * (input - a.input) / (b.input - a.input);
+}
+
+// Description:
+//   Rebuilds the lookup table.
+//
+// Params:
+//   deadzone   The dead zone of the thumbstick
+//   accel      An exponent to use to create an input curve. 0 to use a linear input
+//   scale      Multiplier applied to the curve, e.g. the cursor speed
+//   fps        The update rate the multiplier is spread across
+//   points     A custom curve replacing the acceleration exponent (Optional)
+void ResponseCurve::build(float deadzone, float accel, float scale, int fps, const std::vector<CurvePoint> &points)
+{
+  const bool custom = points.size() >= 2;
+
+  for (int i = 0; i <= TABLE_SIZE; ++i)
+  {
+    float length = std::sqrt(i / _indexScale);
+    if (length <= deadzone)
+    {
+      _table[i] = 0.0f;
+      continue;
+    }
+
+    // Normalize the thumbstick value.
+    float mult = (length - deadzone) / (MAXSHORT - deadzone);
+
+    // Apply a curve to the normalized thumbstick value.
+    if (custom)
+    {
+      mult = evaluatePoints(points, mult);
+    }
+    else if (accel > 0.0001f)
+    {
+      mult = std::pow(mult, accel);
+    }
+
+    _table[i] = mult * scale / fps;
+  }
+}
+
+// Description:
+//   Parses a custom curve written as comma separated input:output pairs, e.g. "0:0,0.5:0.2,1:1".
+//
+// Params:
+//   text   The curve definition from the config file
+//
+// Returns:
+//   The points sorted by input. Empty if fewer than two valid points were found.
+std::vector<CurvePoint> ResponseCurve::parsePoints(const std::string &text)
+{
+  std::vector<CurvePoint> points;
+  std::istringstream stream(text);
+  for (std::string entry; std::getline(stream, entry, ',');)
+  {
+    size_t separator = entry.find(':');
+    if (separator == std::string::npos)
+    {
+      continue;
+    }
+
+    CurvePoint point;
+    point.input = strtof(entry.substr(0, separator).c_str(), 0);
+    point.output = strtof(entry.substr(separator + 1).c_str(), 0);
+    points.push_back(point);
+  }
+
+  std::sort(points.begin(), points.end(), [](const CurvePoint &a, const CurvePoint &b) { return a.input < b.input; });
+
+  if (points.size() < 2)
+  {
+    points.clear();
+  }
+  return points;
+}
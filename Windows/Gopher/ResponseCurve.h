@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// A point of a custom response curve. Both values are normalized: 0 is the edge of the dead
+// zone and 1 is full deflection on one axis.
+struct CurvePoint
+{
+  float input;
+  float output;
+};
+
+// Precomputed mapping from squared thumbstick deflection to a per-frame velocity multiplier.
+// The dead zone, acceleration exponent or custom curve, speed and update rate are folded into
+// a lookup table when the curve is built, so evaluating it costs one multiply, one table read
+// and a linear interpolation.
+class ResponseCurve
+{
+public:
+  static const int TABLE_SIZE = 1024;
+
+private:
+  float _table[TABLE_SIZE + 1];
+  float _indexScale;  // Converts a squared deflection to a table position.
+
+public:
+  ResponseCurve();
+
+  void build(float deadzone, float accel, float scale, int fps, const std::vector<CurvePoint> &points = {});
+
+  // Description:
+  //   Looks up the multiplier for a thumbstick deflection.
+  //
+  // Params:
+  //   lengthsq   The squared length of the thumbstick deflection
+  //
+  // Returns:
+  //   The multiplier to apply to the thumbstick axes this frame.
+  float evaluate(float lengthsq) const
+  {
+    float position = lengthsq * _indexScale;
+    if (position >= TABLE_SIZE)
+    {
+      return _table[TABLE_SIZE];
+    }
+
+    int index = (int)position;
+    float fraction = position - index;
+    return _table[index] + (_table[index + 1] - _table[index]) * fraction;
+  }
+
+  // The table and scale evaluate() reads, for kernels that evaluate several deflections at once.
+  const float *getTable() const
+  {
+    return _table;
+  }
+
+  float getIndexScale() const
+  {
+    return _indexScale;
+  }
+
+  static std::vector<CurvePoint> parsePoints(const std::string &text);
+};
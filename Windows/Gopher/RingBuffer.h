@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed-capacity, lock-free ring buffer for exactly one producer thread and one consumer thread.
+// Capacity must be a power of two. One slot is kept free to tell a full ring from an empty one.
+template <typename T, size_t Capacity>
+class SpscRing
+{
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+private:
+  // The indices live on separate cache lines so the producer and consumer do not false-share.
+  alignas(64) std::atomic<size_t> _head;  // Next slot to write. Only modified by the producer.
+  alignas(64) std::atomic<size_t> _tail;  // Next slot to read. Only modified by the consumer.
+  alignas(64) T _items[Capacity];
+
+public:
+  SpscRing()
+    : _head(0)
+    , _tail(0)
+  {
+  }
+
+  // Description:
+  //   Adds an item to the ring. Must only be called from the producer thread.
+  //
+  // Returns:
+  //   false if the ring is full and the item was not added.
+  bool push(const T &item)
+  {
+    const size_t head = _head.load(std::memory_order_relaxed);
+    const size_t next = (head + 1) & (Capacity - 1);
+    if (next == _tail.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    _items[head] = item;
+    _head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Description:
+  //   Removes the oldest item from the ring. Must only be called from the consumer thread.
+  //
+  // Returns:
+  //   false if the ring is empty.
+  bool pop(T &item)
+  {
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    item = _items[tail];
+    _tail.store((tail + 1) & (Capacity - 1), std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const
+  {
+    return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+  }
+};
+
+// Fixed-capacity, lock-free queue for any number of producer threads and exactly one consumer
+// thread. Capacity must be a power of two, and all of it is usable. Every slot carries a sequence
+// number telling whether it is free for the lap of the producers or holds an item for the lap
+// of the consumer, so producers only contend on the head index.
+template <typename T, size_t Capacity>
+class MpscRing
+{
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "MpscRing capacity must be a power of two");
+
+private:
+  struct Slot
+  {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  alignas(64) std::atomic<size_t> _head;  // Next position to write. Claimed by the producers.
+  alignas(64) std::atomic<size_t> _tail;  // Next position to read. Only modified by the consumer.
+  alignas(64) Slot _slots[Capacity];
+
+public:
+  MpscRing()
+    : _head(0)
+    , _tail(0)
+  {
+    for (size_t i = 0; i < Capacity; ++i)
+    {
+      _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Description:
+  //   Adds an item to the queue. Safe to call from any thread.
+  //
+  // Returns:
+  //   false if the queue is full and the item was not added.
+  bool push(const T &item)
+  {
+    size_t head = _head.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true)
+    {
+      slot = &_slots[head & (Capacity - 1)];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const ptrdiff_t lap = (ptrdiff_t)(sequence - head);
+      if (lap == 0)
+      {
+        // The slot is free for this position; claim it unless another producer got there first.
+        if (_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (lap < 0)
+      {
+        return false;  // The consumer has not read this slot since the previous lap.
+      }
+      else
+      {
+        head = _head.load(std::memory_order_relaxed);
+      }
+    }
+
+    slot->item = item;
+    slot->sequence.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Description:
+  //   Removes the oldest item from the queue. Must only be called from the consumer thread.
+  //
+  // Returns:
+  //   false if the queue is empty, or its oldest item is still being written.
+  bool pop(T &item)
+  {
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    Slot &slot = _slots[tail & (Capacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+    {
+      return false;
+    }
+
+    item = slot.item;
+    slot.sequence.store(tail + Capacity, std::memory_order_release);
+    _tail.store(tail + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Description:
+  //   Tells whether pop would find nothing. Must only be called from the consumer thread.
+  bool empty() const
+  {
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    return _slots[tail & (Capacity - 1)].sequence.load(std::memory_order_acquire) != tail + 1;
+  }
+};
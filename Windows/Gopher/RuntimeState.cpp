@@ -0,0 +1,231 @@
+#include "RuntimeState.h"
+
+#include <stddef.h>
+
+RuntimeState::RuntimeState()
+  : _data(&_private)
+{
+  initialize(_private);
+}
+
+RuntimeState::~RuntimeState()
+{
+  close();
+}
+
+// Description:
+//   Maps a state file, creating it if it does not exist. From then on the state is read from
+//     and written to the file. A file that is not a valid state is started over.
+//
+// Params:
+//   path   The state file
+//
+// Returns:
+//   false if the file could not be mapped, in which case the state stays in private memory.
+bool RuntimeState::open(const std::string &path)
+{
+  close();
+
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  // Mapping a shorter file extends it with zeros, which fails the check below.
+  HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READWRITE, 0, sizeof(RuntimeStateData), NULL);
+  CloseHandle(file);
+  if (mapping == NULL)
+  {
+    return false;
+  }
+
+  RuntimeStateData *data = (RuntimeStateData*)MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(RuntimeStateData));
+  CloseHandle(mapping);
+  if (data == NULL)
+  {
+    return false;
+  }
+
+  bool valid = data->magic == RuntimeStateData::MAGIC
+    && data->version == RuntimeStateData::VERSION
+    && data->speedCount <= RuntimeStateData::MAX_PROFILES
+    && data->checksum == checksum(*data);
+  if (!valid)
+  {
+    initialize(*data);
+  }
+
+  _data = data;
+  return true;
+}
+
+// Description:
+//   Unmaps the state file, if one is mapped, and keeps its last values in private memory.
+void RuntimeState::close()
+{
+  if (_data != &_private)
+  {
+    _private = *_data;
+    UnmapViewOfFile(_data);
+    _data = &_private;
+  }
+}
+
+// Description:
+//   Resets a state to the defaults.
+//
+// Params:
+//   data   The state to reset
+void RuntimeState::initialize(RuntimeStateData &data)
+{
+  ZeroMemory(&data, sizeof(data));
+  data.magic = RuntimeStateData::MAGIC;
+  data.version = RuntimeStateData::VERSION;
+  data.checksum = checksum(data);
+}
+
+// Description:
+//   Computes the checksum of a state.
+//
+// Params:
+//   data   The state
+//
+// Returns:
+//   The FNV-1a hash of every byte after the checksum field.
+DWORD RuntimeState::checksum(const RuntimeStateData &data)
+{
+  const size_t start = offsetof(RuntimeStateData, checksum) + sizeof(data.checksum);
+  const BYTE *bytes = (const BYTE*)&data;
+  DWORD hash = 2166136261;
+  for (size_t i = start; i < sizeof(data); ++i)
+  {
+    hash = (hash ^ bytes[i]) * 16777619;
+  }
+  return hash;
+}
+
+// Description:
+//   Finds the saved cursor speed of a profile.
+//
+// Params:
+//   process  Executable of the profile in lower case, empty for config.ini
+//
+// Returns:
+//   The entry of the profile, or NULL if none was saved.
+RuntimeStateData::Speed *RuntimeState::findSpeed(const std::string &process) const
+{
+  for (DWORD i = 0; i < _data->speedCount; ++i)
+  {
+    RuntimeStateData::Speed &speed = _data->speeds[i];
+    if (process.compare(0, std::string::npos, speed.process, strnlen(speed.process, RuntimeStateData::MAX_PROCESS)) == 0)
+    {
+      return &speed;
+    }
+  }
+
+  return NULL;
+}
+
+// Description:
+//   Gets the cursor speed saved for a profile.
+//
+// Params:
+//   process      Executable of the profile in lower case, empty for config.ini
+//   speedIndex   Receives the index of the speed in the speeds of the profile
+//
+// Returns:
+//   false if no speed was saved for the profile.
+bool RuntimeState::getSpeedIndex(const std::string &process, unsigned int &speedIndex) const
+{
+  const RuntimeStateData::Speed *speed = findSpeed(process);
+  if (speed == NULL)
+  {
+    return false;
+  }
+
+  speedIndex = speed->speedIndex;
+  return true;
+}
+
+// Description:
+//   Saves the cursor speed selected for a profile. Profiles past MAX_PROFILES, or with longer
+//     executable names than MAX_PROCESS, are not saved.
+//
+// Params:
+//   process      Executable of the profile in lower case, empty for config.ini
+//   speedIndex   Index of the speed in the speeds of the profile
+void RuntimeState::setSpeedIndex(const std::string &process, unsigned int speedIndex)
+{
+  RuntimeStateData::Speed *speed = findSpeed(process);
+  if (speed != NULL)
+  {
+    if (speed->speedIndex != speedIndex)
+    {
+      speed->speedIndex = speedIndex;
+      seal();
+    }
+    return;
+  }
+
+  if (_data->speedCount >= RuntimeStateData::MAX_PROFILES || process.size() >= RuntimeStateData::MAX_PROCESS)
+  {
+    return;
+  }
+
+  speed = &_data->speeds[_data->speedCount];
+  ZeroMemory(speed->process, sizeof(speed->process));
+  memcpy(speed->process, process.c_str(), process.size());
+  speed->speedIndex = speedIndex;
+  _data->speedCount++;
+  seal();
+}
+
+// Description:
+//   Gets the saved toggles.
+//
+// Params:
+//   disabled           Receives whether the mapping was turned off
+//   vibrationDisabled  Receives whether vibration was turned off
+//   hidden             Receives whether the window was hidden
+void RuntimeState::getToggles(bool &disabled, bool &vibrationDisabled, bool &hidden) const
+{
+  disabled = _data->disabled != 0;
+  vibrationDisabled = _data->vibrationDisabled != 0;
+  hidden = _data->hidden != 0;
+}
+
+// Description:
+//   Saves the toggles.
+//
+// Params:
+//   disabled           Whether the mapping is turned off
+//   vibrationDisabled  Whether vibration is turned off
+//   hidden             Whether the window is hidden
+void RuntimeState::setToggles(bool disabled, bool vibrationDisabled, bool hidden)
+{
+  if ((_data->disabled != 0) != disabled || (_data->vibrationDisabled != 0) != vibrationDisabled
+    || (_data->hidden != 0) != hidden)
+  {
+    _data->disabled = disabled;
+    _data->vibrationDisabled = vibrationDisabled;
+    _data->hidden = hidden;
+    seal();
+  }
+}
+
+// Description:
+//   Saves the calibration of a pad slot.
+//
+// Params:
+//   pad          The pad slot
+//   calibration  The calibration of both its sticks
+void RuntimeState::setCalibration(DWORD pad, const PadCalibration &calibration)
+{
+  if (memcmp(&_data->pads[pad], &calibration, sizeof(calibration)) != 0)
+  {
+    _data->pads[pad] = calibration;
+    seal();
+  }
+}
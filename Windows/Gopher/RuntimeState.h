@@ -0,0 +1,91 @@
+#pragma once
+
+#include <windows.h>
+#include <xinput.h>
+#include <string>
+
+#include "StickCalibrator.h"
+
+// Layout of the state file. Every field is written in place through the mapping, and the
+// checksum is updated after every change, so readers should check magic, version and checksum
+// before trusting the rest; a file that fails the check, such as one a crash left between a
+// change and its checksum, is started over.
+struct RuntimeStateData
+{
+  static const DWORD MAGIC = 0x53523347;  // "G3RS"
+  static const DWORD VERSION = 2;
+
+  static const size_t MAX_PROFILES = 32;
+  static const size_t MAX_PROCESS = 64;
+
+  // The cursor speed selected for a profile.
+  struct Speed
+  {
+    char process[MAX_PROCESS];            // Executable of the profile. Empty for config.ini.
+    DWORD speedIndex;
+  };
+
+  DWORD magic;
+  DWORD version;
+  DWORD checksum;                         // FNV-1a of the fields after it.
+  LONG disabled;                          // The mapping was turned off with the disable button.
+  LONG vibrationDisabled;
+  LONG hidden;                            // The window was hidden.
+  DWORD speedCount;                       // Used entries of speeds.
+  Speed speeds[MAX_PROFILES];
+  PadCalibration pads[XUSER_MAX_COUNT];   // Stick calibration of every pad slot.
+};
+
+// State Gopher keeps across sessions: the selected cursor speeds, the toggles and the stick
+// calibration of every pad slot. It lives in a small memory-mapped file, so a change only
+// stores to memory and the system writes it back; nothing is stored unless a value actually
+// changed. Until a file is opened, or if it cannot be, the state is kept in private memory, so
+// a session without a file, such as a benchmark, starts from the defaults and saves nothing.
+class RuntimeState
+{
+private:
+  RuntimeStateData *_data;      // The mapped file, or _private.
+  RuntimeStateData _private;    // Used while no file is mapped.
+
+public:
+  RuntimeState();
+  ~RuntimeState();
+
+  bool open(const std::string &path);
+
+  bool getSpeedIndex(const std::string &process, unsigned int &speedIndex) const;
+
+  void setSpeedIndex(const std::string &process, unsigned int speedIndex);
+
+  void getToggles(bool &disabled, bool &vibrationDisabled, bool &hidden) const;
+
+  void setToggles(bool disabled, bool vibrationDisabled, bool hidden);
+
+  // Description:
+  //   Gets the saved calibration of a pad slot.
+  const PadCalibration &getCalibration(DWORD pad) const
+  {
+    return _data->pads[pad];
+  }
+
+  void setCalibration(DWORD pad, const PadCalibration &calibration);
+
+private:
+  void close();
+
+  RuntimeStateData::Speed *findSpeed(const std::string &process) const;
+
+  static void initialize(RuntimeStateData &data);
+
+  static DWORD checksum(const RuntimeStateData &data);
+
+  // Description:
+  //   Updates the checksum after a change.
+  void seal()
+  {
+    _data->checksum = checksum(*_data);
+  }
+
+  RuntimeState(const RuntimeState&) = delete;
+  RuntimeState& operator=(const RuntimeState&) = delete;
+};
@@ -0,0 +1,164 @@
+#include "Scheduler.h"
+
+#pragma comment(lib, "winmm") // for timeBeginPeriod()
+#include <timeapi.h>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+Scheduler::Scheduler(int rate)
+  : _timer(NULL)
+  , _highResolution(true)
+  , _frequency(1)
+  , _period(1)
+  , _nextDeadline(0)
+  , _rate(0)
+  , _lastLateness(0)
+  , _missedTicks(0)
+{
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  _frequency = frequency.QuadPart;
+
+  // High resolution timers are only available on Windows 10 1803 and newer. Fall back to
+  // a regular timer with the system timer resolution raised to 1 ms on older systems.
+  _timer = CreateWaitableTimerEx(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+  if (_timer == NULL)
+  {
+    _highResolution = false;
+    _timer = CreateWaitableTimer(NULL, TRUE, NULL);
+    timeBeginPeriod(1);
+  }
+
+  setRate(rate);
+}
+
+Scheduler::~Scheduler()
+{
+  if (!_highResolution)
+  {
+    timeEndPeriod(1);
+  }
+
+  if (_timer != NULL)
+  {
+    CloseHandle(_timer);
+  }
+}
+
+// Description:
+//   Changes the tick rate. The next deadline is placed one new period from now.
+//
+// Params:
+//   rate   The number of ticks per second. Values below 1 are clamped to 1.
+void Scheduler::setRate(int rate)
+{
+  if (rate < 1)
+  {
+    rate = 1;
+  }
+
+  _rate = rate;
+  _period = _frequency / rate;
+  _nextDeadline = now() + _period;
+}
+
+// Description:
+//   Gets the current tick rate.
+//
+// Returns:
+//   The number of ticks per second.
+int Scheduler::getRate() const
+{
+  return _rate;
+}
+
+// Description:
+//   Blocks until the next tick deadline. Deadlines advance by exactly one period
+//     each call so they do not drift. If the caller overran one or more whole periods
+//     the missed deadlines are skipped rather than released in a burst.
+//
+// Returns:
+//   How late the tick was released, in microseconds.
+LONGLONG Scheduler::waitForNextTick()
+{
+  LONGLONG remaining = _nextDeadline - now();
+  if (remaining > 0 && _timer != NULL)
+  {
+    // Relative due times are negative and expressed in 100 ns units.
+    LARGE_INTEGER dueTime;
+    dueTime.QuadPart = -(remaining * 10000000 / _frequency);
+    if (dueTime.QuadPart < 0 && SetWaitableTimer(_timer, &dueTime, 0, NULL, NULL, FALSE))
+    {
+      WaitForSingleObject(_timer, INFINITE);
+    }
+  }
+
+  LONGLONG released = now();
+  LONGLONG late = released - _nextDeadline;
+  _lastLateness = late > 0 ? toMicroseconds(late) : 0;
+
+  _nextDeadline += _period;
+  if (released >= _nextDeadline)
+  {
+    LONGLONG skipped = (released - _nextDeadline) / _period + 1;
+    _missedTicks += (unsigned long)skipped;
+    _nextDeadline += skipped * _period;
+  }
+
+  return _lastLateness;
+}
+
+// Description:
+//   Places the next deadline one period from now, e.g. after the caller waited on something
+//     else for a while, so the deadlines it slept through are not counted as missed.
+void Scheduler::restart()
+{
+  _nextDeadline = now() + _period;
+}
+
+// Description:
+//   Gets how late the most recent tick was released.
+//
+// Returns:
+//   The lateness of the last tick in microseconds.
+LONGLONG Scheduler::getLastLateness() const
+{
+  return _lastLateness;
+}
+
+// Description:
+//   Gets the number of deadlines that were skipped because a tick ran longer than a period.
+//
+// Returns:
+//   The total number of missed ticks since the scheduler was created.
+unsigned long Scheduler::getMissedTicks() const
+{
+  return _missedTicks;
+}
+
+// Description:
+//   Reads the performance counter.
+//
+// Returns:
+//   The current performance counter value.
+LONGLONG Scheduler::now() const
+{
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return counter.QuadPart;
+}
+
+// Description:
+//   Converts a performance counter interval to microseconds.
+//
+// Params:
+//   ticks  The interval in performance counter ticks
+//
+// Returns:
+//   The interval in microseconds.
+LONGLONG Scheduler::toMicroseconds(LONGLONG ticks) const
+{
+  return ticks * 1000000 / _frequency;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <windows.h>
+
+// Fixed-rate tick scheduler. Ticks are placed on absolute deadlines measured with the
+// performance counter, so time spent handling a tick does not push back the next one.
+class Scheduler
+{
+private:
+  HANDLE _timer;              // Waitable timer used to sleep between ticks.
+  bool _highResolution;       // True when the timer was created with CREATE_WAITABLE_TIMER_HIGH_RESOLUTION.
+  LONGLONG _frequency;        // Performance counter ticks per second.
+  LONGLONG _period;           // Length of one scheduler tick in performance counter ticks.
+  LONGLONG _nextDeadline;     // Absolute performance counter value of the next tick.
+  int _rate;                  // Target rate in ticks per second.
+  LONGLONG _lastLateness;     // How late the last tick was released, in microseconds.
+  unsigned long _missedTicks; // Number of deadlines skipped because a tick overran its period.
+
+public:
+  Scheduler(int rate = 150);
+  ~Scheduler();
+
+  void setRate(int rate);
+
+  int getRate() const;
+
+  LONGLONG waitForNextTick();
+
+  void restart();
+
+  LONGLONG getLastLateness() const;
+
+  unsigned long getMissedTicks() const;
+
+  LONGLONG now() const;
+
+  LONGLONG toMicroseconds(LONGLONG ticks) const;
+
+private:
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+};
@@ -0,0 +1,277 @@
+#include "Stats.h"
+
+#include <intrin.h>
+#include <iomanip>
+#include <new>
+#include <sstream>
+
+static const char *STAGE_NAMES[STAT_COUNT] =
+{
+  "poll",
+  "diff",
+  "mapping",
+  "flush",
+  "overshoot",
+  "end to end",
+  "filter lag",
+  "tick jitter",
+};
+
+// Description:
+//   Finds the bucket a value is counted in.
+//
+// Params:
+//   value  The measurement in microseconds
+//
+// Returns:
+//   The index of the bucket, 0 to BUCKET_COUNT - 1.
+int StatsHistogram::bucketOf(DWORD value)
+{
+  if (value < LINEAR_BUCKETS)
+  {
+    return (int)value;
+  }
+
+  unsigned long exponent;
+  _BitScanReverse(&exponent, value);
+
+  const int shift = (int)exponent - SUB_BUCKET_BITS;
+  const int subBucket = (int)(value >> shift) - SUB_BUCKETS;
+  return LINEAR_BUCKETS + (shift - 1) * SUB_BUCKETS + subBucket;
+}
+
+// Description:
+//   Gets the largest value counted in a bucket.
+//
+// Params:
+//   bucket   The index of the bucket
+//
+// Returns:
+//   The inclusive upper bound of the bucket in microseconds.
+DWORD StatsHistogram::bucketLimit(int bucket)
+{
+  if (bucket < LINEAR_BUCKETS)
+  {
+    return (DWORD)bucket;
+  }
+
+  const int shift = (bucket - LINEAR_BUCKETS) / SUB_BUCKETS + 1;
+  const DWORD subBucket = (DWORD)((bucket - LINEAR_BUCKETS) % SUB_BUCKETS);
+  const DWORD lower = (SUB_BUCKETS + subBucket) << shift;
+  return lower + ((DWORD)1 << shift) - 1;
+}
+
+// Description:
+//   Estimates a percentile of the recorded values.
+//
+// Params:
+//   fraction   The percentile as a fraction, e.g. 0.99 for p99
+//
+// Returns:
+//   The upper bound of the bucket holding the percentile, or 0 if nothing was recorded.
+DWORD StatsHistogram::percentile(double fraction) const
+{
+  const DWORD total = count.load(std::memory_order_relaxed);
+  if (total == 0)
+  {
+    return 0;
+  }
+
+  DWORD target = (DWORD)(fraction * total + 0.5);
+  if (target < 1)
+  {
+    target = 1;
+  }
+
+  const DWORD largest = max.load(std::memory_order_relaxed);
+  DWORD seen = 0;
+  for (int i = 0; i < BUCKET_COUNT; ++i)
+  {
+    seen += buckets[i].load(std::memory_order_relaxed);
+    if (seen >= target)
+    {
+      DWORD limit = bucketLimit(i);
+      return limit < largest ? limit : largest;
+    }
+  }
+
+  return largest;
+}
+
+Stats::Stats()
+  : _mapping(NULL)
+  , _block(NULL)
+  , _shared(false)
+{
+  _mapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(StatsBlock), STATS_MAPPING_NAME);
+  if (_mapping != NULL && GetLastError() == ERROR_ALREADY_EXISTS)
+  {
+    // Another instance is publishing its stats. Leave its block alone.
+    CloseHandle(_mapping);
+    _mapping = NULL;
+  }
+
+  void *memory = NULL;
+  if (_mapping != NULL)
+  {
+    memory = MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(StatsBlock));
+    _shared = memory != NULL;
+  }
+  if (memory == NULL)
+  {
+    memory = ::operator new(sizeof(StatsBlock));
+  }
+
+  ZeroMemory(memory, sizeof(StatsBlock));
+  _block = new (memory) StatsBlock;
+  _block->stageCount = STAT_COUNT;
+  _block->bucketCount = StatsHistogram::BUCKET_COUNT;
+  _block->version = StatsBlock::VERSION;
+
+  // Publish the magic last so a reader never sees a half initialized header.
+  std::atomic_thread_fence(std::memory_order_release);
+  _block->magic = StatsBlock::MAGIC;
+}
+
+Stats::~Stats()
+{
+  if (_shared)
+  {
+    UnmapViewOfFile(_block);
+  }
+  else
+  {
+    ::operator delete(_block);
+  }
+
+  if (_mapping != NULL)
+  {
+    CloseHandle(_mapping);
+  }
+}
+
+// Description:
+//   Counts one handled sample.
+void Stats::addFrame()
+{
+  _block->frames.store(_block->frames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// Description:
+//   Counts polling ticks that were skipped because the polling thread fell behind.
+//
+// Params:
+//   count  The number of ticks skipped since the last call
+void Stats::addMissedDeadlines(DWORD count)
+{
+  _block->missedDeadlines.store(_block->missedDeadlines.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+}
+
+// Description:
+//   Publishes the number of samples the polling thread had to drop.
+//
+// Params:
+//   count  The total number of dropped samples
+void Stats::setDroppedSamples(DWORD count)
+{
+  _block->droppedSamples.store(count, std::memory_order_relaxed);
+}
+
+// Description:
+//   Gets the stats block, e.g. to print a summary.
+//
+// Returns:
+//   The block the stats are recorded in.
+const StatsBlock &Stats::block() const
+{
+  return *_block;
+}
+
+// Description:
+//   Tells whether the stats can be read by other processes.
+//
+// Returns:
+//   true if the stats are published under STATS_MAPPING_NAME.
+bool Stats::isShared() const
+{
+  return _shared;
+}
+
+// Description:
+//   Formats the counters and the p50, p99 and p99.9 of every stage as a table.
+//
+// Params:
+//   block  The stats to format, either from a Stats object or a mapped view of STATS_MAPPING_NAME
+//
+// Returns:
+//   One line per stage, in microseconds.
+std::string Stats::summary(const StatsBlock &block)
+{
+  std::ostringstream out;
+  out << "frames: " << block.frames.load()
+      << "  missed deadlines: " << block.missedDeadlines.load()
+      << "  dropped samples: " << block.droppedSamples.load() << std::endl;
+
+  out << std::left << std::setw(12) << "stage" << std::right
+      << std::setw(10) << "count" << std::setw(10) << "p50" << std::setw(10) << "p99"
+      << std::setw(10) << "p99.9" << std::setw(10) << "max" << std::endl;
+
+  for (int i = 0; i < STAT_COUNT; ++i)
+  {
+    const StatsHistogram &histogram = block.stages[i];
+    out << std::left << std::setw(12) << STAGE_NAMES[i] << std::right
+        << std::setw(10) << histogram.count.load()
+        << std::setw(10) << histogram.percentile(0.5)
+        << std::setw(10) << histogram.percentile(0.99)
+        << std::setw(10) << histogram.percentile(0.999)
+        << std::setw(10) << histogram.max.load() << std::endl;
+  }
+
+  return out.str();
+}
+
+// Description:
+//   Gets what was recorded between two copies of the same stats, e.g. to compare the tick jitter
+//     over a few seconds with the scheduling settings on and off. From a zeroed earlier block it
+//     takes a copy of the later one.
+//
+// Params:
+//   earlier    The stats at the start of the interval
+//   later      The stats at its end
+//   interval   Receives the counts recorded in between. The max of a stage is the upper bound of
+//                its highest bucket recorded in between, or the later max if that is lower.
+void Stats::difference(const StatsBlock &earlier, const StatsBlock &later, StatsBlock &interval)
+{
+  interval.magic = later.magic;
+  interval.version = later.version;
+  interval.stageCount = later.stageCount;
+  interval.bucketCount = later.bucketCount;
+  interval.frames = later.frames.load() - earlier.frames.load();
+  interval.missedDeadlines = later.missedDeadlines.load() - earlier.missedDeadlines.load();
+  interval.droppedSamples = later.droppedSamples.load() - earlier.droppedSamples.load();
+
+  for (int i = 0; i < STAT_COUNT; ++i)
+  {
+    const StatsHistogram &from = earlier.stages[i];
+    const StatsHistogram &to = later.stages[i];
+    StatsHistogram &histogram = interval.stages[i];
+
+    // Counted from the buckets, so that a measurement recorded while copying stays consistent.
+    DWORD count = 0;
+    DWORD largest = 0;
+    for (int j = 0; j < StatsHistogram::BUCKET_COUNT; ++j)
+    {
+      const DWORD counted = to.buckets[j].load(std::memory_order_relaxed) - from.buckets[j].load(std::memory_order_relaxed);
+      histogram.buckets[j].store(counted, std::memory_order_relaxed);
+      count += counted;
+      if (counted > 0)
+      {
+        largest = StatsHistogram::bucketLimit(j);
+      }
+    }
+
+    const DWORD max = to.max.load(std::memory_order_relaxed);
+    histogram.count.store(count, std::memory_order_relaxed);
+    histogram.max.store(max < largest ? max : largest, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <string>
+
+// The stages of a frame that are timed. Poll, diff, overshoot and jitter are measured on the polling
+// thread; mapping, flush, end to end and filter lag on the thread running Gopher::loop.
+enum StatStage
+{
+  STAT_POLL,        // Reading every controller slot.
+  STAT_DIFF,        // Comparing the sample with the previous one.
+  STAT_MAPPING,     // Turning the sample into queued system inputs.
+  STAT_FLUSH,       // The SendInput call.
+  STAT_OVERSHOOT,   // How late the polling thread woke up for its tick.
+  STAT_END_TO_END,  // From the controller poll to the end of the SendInput call.
+  STAT_FILTER_LAG,  // Delay the stick smoothing adds to the sticks it changes.
+  STAT_JITTER,      // Change of the overshoot between two consecutive polling ticks.
+
+  STAT_COUNT
+};
+
+// Log-linear latency histogram in microseconds. Values below LINEAR_BUCKETS get an exact bucket;
+// larger values get SUB_BUCKETS buckets per power of two, which bounds the error of a reported
+// percentile to about 6%. Each histogram has a single writer, so the counters only need
+// atomic loads and stores to be read safely from another thread or process.
+struct StatsHistogram
+{
+  static const int SUB_BUCKET_BITS = 4;
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const int LINEAR_BUCKETS = SUB_BUCKETS * 2;
+  static const int BUCKET_COUNT = LINEAR_BUCKETS + (32 - SUB_BUCKET_BITS - 1) * SUB_BUCKETS;
+
+  std::atomic<DWORD> buckets[BUCKET_COUNT];
+  std::atomic<DWORD> count;
+  std::atomic<DWORD> max;
+
+  // Description:
+  //   Adds one measurement. Must only be called from the histogram's writer thread.
+  //
+  // Params:
+  //   micros   The measured duration in microseconds
+  void record(LONGLONG micros)
+  {
+    DWORD value = micros < 0 ? 0 : (micros > MAXDWORD ? MAXDWORD : (DWORD)micros);
+    std::atomic<DWORD> &bucket = buckets[bucketOf(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (value > max.load(std::memory_order_relaxed))
+    {
+      max.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  DWORD percentile(double fraction) const;
+
+  static int bucketOf(DWORD value);
+
+  static DWORD bucketLimit(int bucket);
+};
+
+// Layout of the shared memory block published under STATS_MAPPING_NAME. Readers should check
+// magic and version before interpreting the rest of the block.
+struct StatsBlock
+{
+  static const DWORD MAGIC = 0x53333647;  // "G63S"
+  static const DWORD VERSION = 3;
+
+  DWORD magic;
+  DWORD version;
+  DWORD stageCount;
+  DWORD bucketCount;
+  std::atomic<DWORD> frames;           // Samples handled by Gopher::loop.
+  std::atomic<DWORD> missedDeadlines;  // Polling ticks skipped because the thread overran.
+  std::atomic<DWORD> droppedSamples;   // Samples lost because the ring was full.
+  StatsHistogram stages[STAT_COUNT];
+};
+
+#define STATS_MAPPING_NAME TEXT("Local\\Gopher360Stats")
+
+// Latency instrumentation of the input pipeline. The histograms live in a named shared memory
+// block so an external tool can read them while Gopher is running; if the block cannot be
+// created, e.g. because another instance already owns it, the stats are kept in private memory.
+class Stats
+{
+private:
+  HANDLE _mapping;
+  StatsBlock *_block;
+  bool _shared;             // false when _block is private memory.
+
+public:
+  Stats();
+  ~Stats();
+
+  // Description:
+  //   Records the duration of one stage of a frame.
+  //
+  // Params:
+  //   stage    The timed stage
+  //   micros   The duration in microseconds
+  void record(StatStage stage, LONGLONG micros)
+  {
+    _block->stages[stage].record(micros);
+  }
+
+  void addFrame();
+
+  void addMissedDeadlines(DWORD count);
+
+  void setDroppedSamples(DWORD count);
+
+  const StatsBlock &block() const;
+
+  bool isShared() const;
+
+  static std::string summary(const StatsBlock &block);
+
+  static void difference(const StatsBlock &earlier, const StatsBlock &later, StatsBlock &interval);
+
+private:
+  Stats(const Stats&) = delete;
+  Stats& operator=(const Stats&) = delete;
+};
@@ -0,0 +1,182 @@
+#include "StickCalibrator.h"
+
+#include <algorithm>
+
+// Description:
+//   Clamps a value to the thumbstick range.
+static SHORT toAxis(LONG value)
+{
+  return (SHORT)(std::max)((LONG)-32768, (std::min)((LONG)32767, value));
+}
+
+// Description:
+//   Blends a new measurement into an older one, weighing the older one three times as much.
+static LONG blend(LONG previous, LONG measured)
+{
+  const LONG sum = previous * 3 + measured;
+  return (sum >= 0 ? sum + 2 : sum - 2) / 4;
+}
+
+// Description:
+//   Restarts the rest windows of a pad, e.g. when it was unplugged. Its calibration is kept.
+//
+// Params:
+//   pad  The pad slot
+void StickCalibrator::reset(DWORD pad)
+{
+  _windows[pad][0] = Window();
+  _windows[pad][1] = Window();
+}
+
+// Description:
+//   Sets the calibration of a pad slot, such as the one saved by an earlier session.
+//
+// Params:
+//   pad          The pad slot
+//   calibration  The calibration of both its sticks
+void StickCalibrator::setCalibration(DWORD pad, const PadCalibration &calibration)
+{
+  _pads[pad] = calibration;
+  for (StickCalibration &stick : _pads[pad].sticks)
+  {
+    stick.centerX = toAxis((std::max)(-MAX_CENTER, (std::min)(MAX_CENTER, (LONG)stick.centerX)));
+    stick.centerY = toAxis((std::max)(-MAX_CENTER, (std::min)(MAX_CENTER, (LONG)stick.centerY)));
+    stick.noise = (WORD)(std::min)(MAX_NOISE, (LONG)stick.noise);
+  }
+  reset(pad);
+}
+
+// Description:
+//   Measures the thumbsticks of the connected pads and corrects them in place.
+//
+// Params:
+//   states     The controller state of every pad slot
+//   connected  Bit n is set when the controller in slot n is connected
+//
+// Returns:
+//   A mask with bit n set when the calibration of pad n changed, e.g. to save it.
+DWORD StickCalibrator::apply(XINPUT_STATE states[XUSER_MAX_COUNT], DWORD connected)
+{
+  DWORD changed = 0;
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+  {
+    if (!(connected & (1 << i)))
+    {
+      continue;
+    }
+
+    XINPUT_GAMEPAD &gamepad = states[i].Gamepad;
+    StickCalibration *sticks = _pads[i].sticks;
+    if (measure(_windows[i][0], sticks[0], gamepad.sThumbLX, gamepad.sThumbLY)
+      | measure(_windows[i][1], sticks[1], gamepad.sThumbRX, gamepad.sThumbRY))
+    {
+      changed |= 1 << i;
+    }
+
+    correct(sticks[0], gamepad.sThumbLX, gamepad.sThumbLY);
+    correct(sticks[1], gamepad.sThumbRX, gamepad.sThumbRY);
+  }
+
+  return changed;
+}
+
+// Description:
+//   Adds a raw stick position to its rest window, and blends the window into the calibration
+//     once it is complete. A position too far from the others of the window starts a new one.
+//
+// Params:
+//   window       The rest window of the stick
+//   calibration  The calibration of the stick
+//   x            The raw position
+//   y
+//
+// Returns:
+//   true if the calibration changed.
+bool StickCalibrator::measure(Window &window, StickCalibration &calibration, SHORT x, SHORT y)
+{
+  if (window.count > 0
+    && ((std::max)(window.maxX, x) - (std::min)(window.minX, x) > MAX_REST_SPREAD
+      || (std::max)(window.maxY, y) - (std::min)(window.minY, y) > MAX_REST_SPREAD))
+  {
+    window = Window();
+  }
+
+  if (window.count == 0)
+  {
+    window.minX = window.maxX = x;
+    window.minY = window.maxY = y;
+  }
+  window.sumX += x;
+  window.sumY += y;
+  window.minX = (std::min)(window.minX, x);
+  window.maxX = (std::max)(window.maxX, x);
+  window.minY = (std::min)(window.minY, y);
+  window.maxY = (std::max)(window.maxY, y);
+  if (++window.count < WINDOW_SAMPLES)
+  {
+    return false;
+  }
+
+  // A stick held still away from the center is not at rest.
+  const LONG meanX = window.sumX / (LONG)window.count;
+  const LONG meanY = window.sumY / (LONG)window.count;
+  const Window measured = window;
+  window = Window();
+  if (meanX < -MAX_CENTER || meanX > MAX_CENTER || meanY < -MAX_CENTER || meanY > MAX_CENTER)
+  {
+    return false;
+  }
+
+  const LONG noise = (std::min)(MAX_NOISE, (std::max)((std::max)(measured.maxX - meanX, meanX - measured.minX),
+                                                      (std::max)(measured.maxY - meanY, meanY - measured.minY)));
+
+  StickCalibration next;
+  if (calibration.windows == 0)
+  {
+    next.centerX = (SHORT)meanX;
+    next.centerY = (SHORT)meanY;
+    next.noise = (WORD)noise;
+  }
+  else
+  {
+    next.centerX = (SHORT)blend(calibration.centerX, meanX);
+    next.centerY = (SHORT)blend(calibration.centerY, meanY);
+    next.noise = (WORD)blend(calibration.noise, noise);
+  }
+  next.windows = calibration.windows < MAXWORD ? (WORD)(calibration.windows + 1) : MAXWORD;
+
+  // The number of windows alone is not worth saving once the stick is known.
+  const bool changed = next.centerX != calibration.centerX || next.centerY != calibration.centerY
+    || next.noise != calibration.noise || calibration.windows == 0;
+  calibration = next;
+  return changed;
+}
+
+// Description:
+//   Moves a stick position by the rest position of the stick, and snaps it to the center when
+//     it is within the noise.
+//
+// Params:
+//   calibration  The calibration of the stick
+//   x            The position to correct
+//   y
+void StickCalibrator::correct(const StickCalibration &calibration, SHORT &x, SHORT &y)
+{
+  if (calibration.windows == 0)
+  {
+    return;
+  }
+
+  const LONG dx = (LONG)x - calibration.centerX;
+  const LONG dy = (LONG)y - calibration.centerY;
+  const LONGLONG noise = calibration.noise;
+  if ((LONGLONG)dx * dx + (LONGLONG)dy * dy <= noise * noise)
+  {
+    x = 0;
+    y = 0;
+    return;
+  }
+
+  x = toAxis(dx);
+  y = toAxis(dy);
+}
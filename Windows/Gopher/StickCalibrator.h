@@ -0,0 +1,68 @@
+#pragma once
+
+#include <windows.h>
+#include <xinput.h>
+
+// What was measured of one thumbstick at rest.
+struct StickCalibration
+{
+  SHORT centerX;      // Position the stick rests at.
+  SHORT centerY;
+  WORD noise;         // Largest distance from the center the resting stick wanders.
+  WORD windows;       // Rest windows measured, up to MAXWORD. 0 when nothing was measured yet.
+};
+
+// Both thumbsticks of a pad slot. Index 0 is the left stick.
+struct PadCalibration
+{
+  StickCalibration sticks[2];
+};
+
+// Measures where the thumbsticks of every pad rest and how much they wander there, and corrects
+// the states for it: the rest position is moved to the center and positions within the noise
+// of it are snapped to the center. Worn sticks that rest off center or drift then look like new
+// ones to the filter and the dead zones. The sticks are measured over windows of consecutive
+// states in which they stay still near the center; every complete window is blended into the
+// calibration, so it follows the stick as it wears.
+class StickCalibrator
+{
+private:
+  static constexpr DWORD WINDOW_SAMPLES = 64;     // States in a rest window.
+  static constexpr LONG MAX_REST_SPREAD = 1024;   // Widest range of either axis in a rest window.
+  static constexpr LONG MAX_CENTER = 2500;        // Farthest a rest position is trusted to be from the center.
+  static constexpr LONG MAX_NOISE = 2048;         // Largest noise snapped to the center.
+
+  // The rest window being measured of one stick.
+  struct Window
+  {
+    LONG sumX = 0;
+    LONG sumY = 0;
+    SHORT minX = 0;
+    SHORT maxX = 0;
+    SHORT minY = 0;
+    SHORT maxY = 0;
+    DWORD count = 0;
+  };
+
+  PadCalibration _pads[XUSER_MAX_COUNT] = {};
+  Window _windows[XUSER_MAX_COUNT][2];
+
+public:
+  void reset(DWORD pad);
+
+  void setCalibration(DWORD pad, const PadCalibration &calibration);
+
+  // Description:
+  //   Gets the calibration of a pad slot.
+  const PadCalibration &getCalibration(DWORD pad) const
+  {
+    return _pads[pad];
+  }
+
+  DWORD apply(XINPUT_STATE states[XUSER_MAX_COUNT], DWORD connected);
+
+private:
+  bool measure(Window &window, StickCalibration &calibration, SHORT x, SHORT y);
+
+  static void correct(const StickCalibration &calibration, SHORT &x, SHORT &y);
+};
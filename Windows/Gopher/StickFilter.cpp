@@ -0,0 +1,161 @@
+#include "StickFilter.h"
+
+#include <cmath>
+
+static const float PI = 3.14159265f;
+static const float DERIVATIVE_CUTOFF = 1.0f;  // Cutoff frequency of the speed estimate in Hz.
+static const float MIN_DT = 0.001f;           // Shortest step assumed between two states, in seconds.
+
+// Description:
+//   Gets the smoothing factor of a first order low-pass filter.
+//
+// Params:
+//   cutoff   The cutoff frequency in Hz
+//   dt       Seconds since the previous value
+//
+// Returns:
+//   The weight of the new value, from 0 to 1.
+static float smoothingFactor(float cutoff, float dt)
+{
+  const float tau = 1.0f / (2.0f * PI * cutoff);
+  return 1.0f / (1.0f + tau / dt);
+}
+
+// Description:
+//   Converts a normalized axis value back to the thumbstick range.
+static SHORT toAxis(float value)
+{
+  const float scaled = std::floor(value * 32768.0f + 0.5f);
+  if (scaled >= 32767.0f)
+  {
+    return 32767;
+  }
+  if (scaled <= -32768.0f)
+  {
+    return -32768;
+  }
+  return (SHORT)scaled;
+}
+
+// Description:
+//   Sets the filter parameters and restarts every pad.
+//
+// Params:
+//   minCutoff  Cutoff frequency of a resting stick in Hz. Lower smooths more. 0 disables the filter.
+//   beta       Increase of the cutoff frequency per full deflection per second of stick speed.
+//                Higher follows fast moves more closely.
+//   frequency  Performance counter ticks per second
+void StickFilter::configure(float minCutoff, float beta, LONGLONG frequency)
+{
+  _minCutoff = minCutoff > 0.0f ? minCutoff : 0.0f;
+  _beta = beta > 0.0f ? beta : 0.0f;
+  _frequency = (double)frequency;
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+  {
+    reset(i);
+  }
+}
+
+// Description:
+//   Forgets the history of a pad, so its next state passes through unfiltered.
+//
+// Params:
+//   pad  The pad slot
+void StickFilter::reset(DWORD pad)
+{
+  _pads[pad] = Pad();
+}
+
+// Description:
+//   Filters the thumbsticks of the connected pads in place.
+//
+// Params:
+//   states     The controller state of every pad slot
+//   connected  Bit n is set when the controller in slot n is connected
+//   timestamp  Performance counter value at which the states were polled
+//
+// Returns:
+//   true if a filtered stick still trails its actual position, so states must keep coming in
+//     for it to settle even when the controller does not change.
+bool StickFilter::apply(XINPUT_STATE states[XUSER_MAX_COUNT], DWORD connected, LONGLONG timestamp)
+{
+  bool settling = false;
+  _lag = 0.0f;
+
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+  {
+    if (!(connected & (1 << i)))
+    {
+      continue;
+    }
+
+    Pad &pad = _pads[i];
+    XINPUT_GAMEPAD &gamepad = states[i].Gamepad;
+    if (!pad.primed)
+    {
+      pad.sticks[0].x = gamepad.sThumbLX / 32768.0f;
+      pad.sticks[0].y = gamepad.sThumbLY / 32768.0f;
+      pad.sticks[1].x = gamepad.sThumbRX / 32768.0f;
+      pad.sticks[1].y = gamepad.sThumbRY / 32768.0f;
+      pad.timestamp = timestamp;
+      pad.primed = true;
+      continue;
+    }
+
+    float dt = (float)((timestamp - pad.timestamp) / _frequency);
+    if (dt < MIN_DT)
+    {
+      dt = MIN_DT;
+    }
+    pad.timestamp = timestamp;
+
+    settling = filterStick(pad.sticks[0], gamepad.sThumbLX, gamepad.sThumbLY, dt) || settling;
+    settling = filterStick(pad.sticks[1], gamepad.sThumbRX, gamepad.sThumbRY, dt) || settling;
+  }
+
+  return settling;
+}
+
+// Description:
+//   Filters one stick. Both axes share a cutoff derived from the speed of the stick, so a
+//     diagonal move is smoothed the same on both axes and keeps its direction.
+//
+// Params:
+//   stick  The filter state of the stick
+//   x      The horizontal axis, replaced by its filtered value
+//   y      The vertical axis, replaced by its filtered value
+//   dt     Seconds since the previous state
+//
+// Returns:
+//   true if the filtered position differs from the actual one.
+bool StickFilter::filterStick(Stick &stick, SHORT &x, SHORT &y, float dt)
+{
+  const float rawX = x / 32768.0f;
+  const float rawY = y / 32768.0f;
+
+  const float derivativeAlpha = smoothingFactor(DERIVATIVE_CUTOFF, dt);
+  stick.dx += derivativeAlpha * ((rawX - stick.x) / dt - stick.dx);
+  stick.dy += derivativeAlpha * ((rawY - stick.y) / dt - stick.dy);
+
+  const float speed = std::sqrt(stick.dx * stick.dx + stick.dy * stick.dy);
+  const float cutoff = _minCutoff + _beta * speed;
+  const float alpha = smoothingFactor(cutoff, dt);
+  stick.x += alpha * (rawX - stick.x);
+  stick.y += alpha * (rawY - stick.y);
+
+  const SHORT filteredX = toAxis(stick.x);
+  const SHORT filteredY = toAxis(stick.y);
+  const bool changed = filteredX != x || filteredY != y;
+  x = filteredX;
+  y = filteredY;
+
+  if (changed)
+  {
+    const float lag = 1.0f / (2.0f * PI * cutoff);
+    if (lag > _lag)
+    {
+      _lag = lag;
+    }
+  }
+  return changed;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <windows.h>
+#include <xinput.h>
+
+// Adaptive smoothing of the thumbsticks of every pad with a One Euro filter (Casiez, Roussel
+// and Vogel, CHI 2012). Each stick is low-pass filtered with a cutoff frequency that rises with
+// its speed, so a resting or slowly moving stick is smoothed heavily, hiding the jitter of worn
+// and wireless sticks, while fast moves pass through with almost no lag.
+class StickFilter
+{
+private:
+  struct Stick
+  {
+    float x = 0.0f;     // Filtered position, with full deflection at 1.
+    float y = 0.0f;
+    float dx = 0.0f;    // Filtered velocity, in full deflections per second.
+    float dy = 0.0f;
+  };
+
+  struct Pad
+  {
+    Stick sticks[2];              // Left and right stick.
+    LONGLONG timestamp = 0;       // Time of the last filtered state.
+    bool primed = false;          // false until the first state after a reset.
+  };
+
+  Pad _pads[XUSER_MAX_COUNT];
+  float _minCutoff = 0.0f;        // Cutoff frequency of a resting stick in Hz. 0 disables the filter.
+  float _beta = 0.0f;             // How fast the cutoff rises with the stick speed.
+  double _frequency = 1.0;        // Performance counter ticks per second.
+  float _lag = 0.0f;              // Largest time constant applied by the last apply, in seconds.
+
+public:
+  void configure(float minCutoff, float beta, LONGLONG frequency);
+
+  bool isEnabled() const
+  {
+    return _minCutoff > 0.0f;
+  }
+
+  void reset(DWORD pad);
+
+  bool apply(XINPUT_STATE states[XUSER_MAX_COUNT], DWORD connected, LONGLONG timestamp);
+
+  // Description:
+  //   Gets the delay the filter added to the sticks it changed in the last apply, which is the
+  //     time constant of their low-pass filters.
+  //
+  // Returns:
+  //   The delay in seconds, 0 when every stick passed through unchanged.
+  float getLag() const
+  {
+    return _lag;
+  }
+
+private:
+  bool filterStick(Stick &stick, SHORT &x, SHORT &y, float dt);
+};
@@ -0,0 +1,162 @@
+#include "ThreadTuning.h"
+
+#include <avrt.h>
+
+#pragma comment(lib, "avrt") // for AvSetMmThreadCharacteristics()
+
+// SetThreadInformation and SetProcessInformation are only available from Windows 8 and power
+// throttling from Windows 10 1709, so they are loaded at runtime with their own declarations.
+typedef BOOL (WINAPI *SetInformationFn)(HANDLE, int, LPVOID, DWORD);
+
+struct PowerThrottlingState
+{
+  ULONG Version;
+  ULONG ControlMask;    // Policies set by the caller. The system decides the others.
+  ULONG StateMask;      // Whether each of them is on.
+};
+
+static const int THREAD_POWER_THROTTLING = 3;           // ThreadPowerThrottling
+static const int PROCESS_POWER_THROTTLING = 4;          // ProcessPowerThrottling
+static const ULONG POWER_THROTTLING_VERSION = 1;
+static const ULONG POWER_THROTTLING_EXECUTION_SPEED = 0x1;
+static const ULONG POWER_THROTTLING_IGNORE_TIMER_RESOLUTION = 0x4;
+
+static const DWORD PRIORITY_CLASSES[] = { NORMAL_PRIORITY_CLASS, ABOVE_NORMAL_PRIORITY_CLASS, HIGH_PRIORITY_CLASS };
+
+// Description:
+//   Sets the power throttling policies of a thread or process.
+//
+// Params:
+//   function   "SetThreadInformation" or "SetProcessInformation"
+//   handle     The thread or process
+//   type       THREAD_POWER_THROTTLING or PROCESS_POWER_THROTTLING
+//   control    The policies to set, none to leave them all to the system
+//
+// Returns:
+//   false if the system does not support power throttling or refused.
+static bool setPowerThrottling(const char *function, HANDLE handle, int type, ULONG control)
+{
+  SetInformationFn setInformation = (SetInformationFn)GetProcAddress(GetModuleHandle(TEXT("kernel32.dll")), function);
+  if (setInformation == NULL)
+  {
+    return false;
+  }
+
+  // Every policy that is set is turned off.
+  PowerThrottlingState state;
+  state.Version = POWER_THROTTLING_VERSION;
+  state.ControlMask = control;
+  state.StateMask = 0;
+  return setInformation(handle, type, &state, sizeof(state)) != FALSE;
+}
+
+ThreadTuning::ThreadTuning()
+  : _mmcss(NULL)
+{
+}
+
+// Description:
+//   Applies scheduling settings to the calling thread, undoing the previous ones where they
+//     differ. Settings that cannot be applied leave the thread as the system schedules it, and
+//     are tried again by the next apply.
+//
+// Params:
+//   settings   The settings to apply
+//
+// Returns:
+//   false if part of the settings could not be applied, e.g. an unknown MMCSS task.
+bool ThreadTuning::apply(const ThreadSettings &settings)
+{
+  bool applied = true;
+
+  if (settings.mmcssTask != _applied.mmcssTask)
+  {
+    if (_mmcss != NULL)
+    {
+      AvRevertMmThreadCharacteristics(_mmcss);
+      _mmcss = NULL;
+    }
+    _applied.mmcssTask = "0";
+
+    if (settings.mmcssTask != "0" && !settings.mmcssTask.empty())
+    {
+      DWORD taskIndex = 0;
+      _mmcss = AvSetMmThreadCharacteristicsA(settings.mmcssTask.c_str(), &taskIndex);
+      if (_mmcss != NULL)
+      {
+        AvSetMmThreadPriority(_mmcss, AVRT_PRIORITY_HIGH);
+        _applied.mmcssTask = settings.mmcssTask;
+      }
+      applied = _mmcss != NULL;
+    }
+  }
+
+  if (settings.affinity != _applied.affinity)
+  {
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+
+    // Cores outside the process mask cannot be used; with none left the thread runs anywhere.
+    DWORD_PTR mask = settings.affinity & processMask;
+    if (SetThreadAffinityMask(GetCurrentThread(), mask != 0 ? mask : processMask) == 0)
+    {
+      applied = false;
+    }
+    else if (mask == 0 && settings.affinity != 0)
+    {
+      // Running anywhere is what affinity 0 asks for, so the next apply tries the mask again.
+      _applied.affinity = 0;
+      applied = false;
+    }
+    else
+    {
+      _applied.affinity = settings.affinity;
+    }
+  }
+
+  if (settings.noPowerThrottling != _applied.noPowerThrottling)
+  {
+    const ULONG control = settings.noPowerThrottling ? POWER_THROTTLING_EXECUTION_SPEED : 0;
+    if (setPowerThrottling("SetThreadInformation", GetCurrentThread(), THREAD_POWER_THROTTLING, control))
+    {
+      _applied.noPowerThrottling = settings.noPowerThrottling;
+    }
+    else
+    {
+      applied = false;
+    }
+  }
+
+  return applied;
+}
+
+// Description:
+//   Undoes the settings applied to the calling thread.
+void ThreadTuning::reset()
+{
+  apply(ThreadSettings());
+}
+
+// Description:
+//   Sets the priority class and power throttling of the whole process.
+//
+// Params:
+//   priority           0 for normal, 1 for above normal, 2 for high
+//   noPowerThrottling  true to opt the process out of EcoQoS, and keep its timer resolution
+//                        while its windows are hidden
+//
+// Returns:
+//   false if the settings could not be applied.
+bool ThreadTuning::applyProcess(int priority, bool noPowerThrottling)
+{
+  if (priority < 0 || priority >= (int)(sizeof(PRIORITY_CLASSES) / sizeof(PRIORITY_CLASSES[0])))
+  {
+    priority = 0;
+  }
+  bool applied = SetPriorityClass(GetCurrentProcess(), PRIORITY_CLASSES[priority]) != FALSE;
+
+  const ULONG control = noPowerThrottling ? POWER_THROTTLING_EXECUTION_SPEED | POWER_THROTTLING_IGNORE_TIMER_RESOLUTION : 0;
+  const bool throttling = setPowerThrottling("SetProcessInformation", GetCurrentProcess(), PROCESS_POWER_THROTTLING, control);
+  return applied && (throttling || !noPowerThrottling);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+
+// How a thread of the input pipeline is scheduled.
+struct ThreadSettings
+{
+  std::string mmcssTask = "0";        // MMCSS task to join, such as "Games" or "Pro Audio". "0" for none.
+  DWORD_PTR affinity = 0;             // Cores the thread may run on, one bit per core. 0 for any.
+  bool noPowerThrottling = false;     // Opts the thread out of EcoQoS.
+
+  bool operator==(const ThreadSettings &other) const
+  {
+    return mmcssTask == other.mmcssTask && affinity == other.affinity && noPowerThrottling == other.noPowerThrottling;
+  }
+
+  bool operator!=(const ThreadSettings &other) const
+  {
+    return !(*this == other);
+  }
+};
+
+// Applies ThreadSettings to the calling thread and undoes them. MMCSS raises the thread to the
+// priority the task is given in the registry and keeps it there under CPU load, which a plain
+// SetThreadPriority does not guarantee against higher-priority work; pinning keeps the thread
+// off cores a build or render is saturating. Every method must be called from the tuned thread,
+// so the settings are not undone on destruction; they end with the thread otherwise.
+class ThreadTuning
+{
+private:
+  HANDLE _mmcss;                      // AvSetMmThreadCharacteristics handle, NULL when not joined.
+  ThreadSettings _applied;
+
+public:
+  ThreadTuning();
+
+  bool apply(const ThreadSettings &settings);
+
+  void reset();
+
+  // Description:
+  //   Gets the settings in effect. Parts that could not be applied keep their previous value.
+  const ThreadSettings &getApplied() const
+  {
+    return _applied;
+  }
+
+  static bool applyProcess(int priority, bool noPowerThrottling);
+
+private:
+  ThreadTuning(const ThreadTuning&) = delete;
+  ThreadTuning& operator=(const ThreadTuning&) = delete;
+};
@@ -0,0 +1,72 @@
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel()
+  : _count(0)
+{
+  for (WheelTimer &head : _slots)
+  {
+    head.next = head.prev = &head;
+  }
+
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  _frequency = frequency.QuadPart;
+  _resolution = _frequency / 1000 > 0 ? _frequency / 1000 : 1;
+
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  _current = now.QuadPart / _resolution;
+}
+
+// Description:
+//   Schedules a timer, moving it if it is already scheduled.
+//
+// Params:
+//   timer      The timer to schedule
+//   deadline   Performance counter value at which it fires. A deadline in the past fires at
+//                the next advance.
+void TimerWheel::schedule(WheelTimer &timer, LONGLONG deadline)
+{
+  cancel(timer);
+  timer.deadline = deadline;
+  link(timer, _slots[slotTime(deadline) % SLOTS]);
+  ++_count;
+}
+
+// Description:
+//   Unschedules a timer. Does nothing if it is not scheduled.
+//
+// Params:
+//   timer  The timer to cancel
+void TimerWheel::cancel(WheelTimer &timer)
+{
+  if (timer.isScheduled())
+  {
+    unlink(timer);
+    --_count;
+  }
+}
+
+// Description:
+//   Gets the slot time a deadline is filed under. Deadlines before the current slot are filed
+//     under the current one, so they are visited at the next advance.
+LONGLONG TimerWheel::slotTime(LONGLONG deadline) const
+{
+  const LONGLONG time = deadline / _resolution;
+  return time > _current ? time : _current;
+}
+
+void TimerWheel::link(WheelTimer &timer, WheelTimer &head)
+{
+  timer.prev = head.prev;
+  timer.next = &head;
+  head.prev->next = &timer;
+  head.prev = &timer;
+}
+
+void TimerWheel::unlink(WheelTimer &timer)
+{
+  timer.prev->next = timer.next;
+  timer.next->prev = timer.prev;
+  timer.prev = timer.next = nullptr;
+}
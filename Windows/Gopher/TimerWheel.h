@@ -0,0 +1,119 @@
+#pragma once
+
+#include <windows.h>
+
+// A timer that can be scheduled on a TimerWheel. Timers belong to their owner and are linked
+// into the wheel in place, so scheduling and cancelling never touch the heap.
+struct WheelTimer
+{
+  WheelTimer *prev = nullptr;
+  WheelTimer *next = nullptr;
+  LONGLONG deadline = 0;    // Performance counter value at which the timer fires.
+  DWORD cookie = 0;         // Tells the owner which timer fired.
+
+  bool isScheduled() const
+  {
+    return prev != nullptr;
+  }
+};
+
+// Hashed timer wheel over performance counter timestamps. Every slot covers one millisecond and
+// holds the timers due in it on any turn of the wheel, so scheduling and cancelling are O(1)
+// and advancing costs one visit per elapsed slot, however many timers are pending. Timers
+// fire at the first advance at or after their exact deadline.
+class TimerWheel
+{
+public:
+  static const size_t SLOTS = 256;
+
+private:
+  WheelTimer _slots[SLOTS];   // List heads; an empty slot points to itself.
+  LONGLONG _frequency;        // Performance counter ticks per second.
+  LONGLONG _resolution;       // Performance counter ticks per slot.
+  LONGLONG _current;          // Slot time up to which the wheel has been advanced.
+  size_t _count;              // Scheduled timers.
+
+public:
+  TimerWheel();
+
+  void schedule(WheelTimer &timer, LONGLONG deadline);
+
+  void cancel(WheelTimer &timer);
+
+  bool empty() const
+  {
+    return _count == 0;
+  }
+
+  LONGLONG getFrequency() const
+  {
+    return _frequency;
+  }
+
+  // Description:
+  //   Fires every timer whose deadline has passed. A fired timer is unscheduled before fire is
+  //     called, which may schedule it again.
+  //
+  // Params:
+  //   now    The current performance counter value
+  //   fire   Called with every expired timer
+  template<typename Fire>
+  void advance(LONGLONG now, Fire fire)
+  {
+    const LONGLONG target = now / _resolution;
+    if (target < _current)
+    {
+      return;
+    }
+
+    // After a long gap every slot is visited once.
+    if (target - _current >= (LONGLONG)SLOTS)
+    {
+      _current = target - SLOTS + 1;
+    }
+
+    // The last slot is visited again next time, since it may hold timers due later in it.
+    for (LONGLONG time = _current; time <= target; ++time)
+    {
+      WheelTimer &head = _slots[time % SLOTS];
+      if (head.next == &head)
+      {
+        continue;
+      }
+
+      // Timers scheduled again by fire() land in the wheel, not in the list being walked.
+      WheelTimer pending;
+      pending.next = head.next;
+      pending.prev = head.prev;
+      pending.next->prev = &pending;
+      pending.prev->next = &pending;
+      head.next = head.prev = &head;
+
+      while (pending.next != &pending)
+      {
+        WheelTimer &timer = *pending.next;
+        unlink(timer);
+        if (timer.deadline <= now)
+        {
+          --_count;
+          fire(timer);
+        }
+        else
+        {
+          link(timer, _slots[slotTime(timer.deadline) % SLOTS]);
+        }
+      }
+    }
+    _current = target;
+  }
+
+private:
+  LONGLONG slotTime(LONGLONG deadline) const;
+
+  static void link(WheelTimer &timer, WheelTimer &head);
+
+  static void unlink(WheelTimer &timer);
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+};
@@ -0,0 +1,440 @@
+#include "TraceRecorder.h"
+
+#include "Log.h"
+
+#include <algorithm>
+
+TraceRecorder::TraceRecorder()
+  : _active(NULL)
+  , _generation(0)
+  , _started(false)
+  , _prefaultMark(0)
+  , _dropped(0)
+  , _capacity(0)
+  , _requested(0)
+  , _opened(NULL)
+  , _failed(0)
+  , _stopping(false)
+  , _wake(CreateEvent(NULL, FALSE, FALSE, NULL))
+  , _thread(NULL)
+  , _current(NULL)
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+  stop();
+  if (_thread != NULL)
+  {
+    _stopping = true;
+    SetEvent(_wake);
+    WaitForSingleObject(_thread, INFINITE);
+    CloseHandle(_thread);
+  }
+
+  // Whatever the helper thread did not get to before it ended.
+  for (Recording *recording : _closing)
+  {
+    close(recording);
+  }
+  close(_opened.exchange(NULL));
+  CloseHandle(_wake);
+}
+
+// Description:
+//   Asks for a trace file to be created, preallocated and mapped by the helper thread. Records
+//     are kept from the moment it is ready; the helper thread logs whether it could be opened.
+//     Any trace being recorded is stopped first.
+//
+// Params:
+//   path       The trace file to create. An existing file is overwritten.
+//   capacity   Number of bytes to preallocate
+//
+// Returns:
+//   false if the helper thread could not be started.
+bool TraceRecorder::start(const std::string &path, SIZE_T capacity)
+{
+  stop();
+
+  if (_thread == NULL)
+  {
+    _thread = CreateThread(NULL, 0, threadProc, this, 0, NULL);
+    if (_thread == NULL)
+    {
+      return false;
+    }
+  }
+
+  ++_generation;
+  AcquireSRWLockExclusive(&_lock);
+  _path = path;
+  _capacity = capacity;
+  _requested = _generation;
+  ReleaseSRWLockExclusive(&_lock);
+  _started = true;
+  SetEvent(_wake);
+  return true;
+}
+
+// Description:
+//   Stops recording. The helper thread cuts the file down to the recorded data and closes it.
+void TraceRecorder::stop()
+{
+  detach();
+  ++_generation;
+  _started = false;
+
+  AcquireSRWLockExclusive(&_lock);
+  _path.clear();
+  ReleaseSRWLockExclusive(&_lock);
+  SetEvent(_wake);
+}
+
+// Description:
+//   Tells whether records are kept, taking over the trace the helper thread opened if it is
+//     ready.
+//
+// Returns:
+//   true if a trace is being recorded.
+bool TraceRecorder::isRecording()
+{
+  if (_active == NULL && _opened.load(std::memory_order_relaxed) != NULL)
+  {
+    Recording *opened = _opened.exchange(NULL, std::memory_order_acquire);
+    if (opened != NULL && opened->generation == _generation)
+    {
+      _active = opened;
+      _prefaultMark = PREFAULT_WINDOW / 2;
+      _dropped = 0;
+    }
+    else if (opened != NULL)
+    {
+      // Opened for a start that was stopped since.
+      AcquireSRWLockExclusive(&_lock);
+      _closing.push_back(opened);
+      ReleaseSRWLockExclusive(&_lock);
+      SetEvent(_wake);
+    }
+  }
+
+  return _active != NULL;
+}
+
+// Description:
+//   Hands the trace being recorded, and one opened but not taken yet, to the helper thread to
+//     close.
+void TraceRecorder::detach()
+{
+  Recording *opened = _opened.exchange(NULL, std::memory_order_acquire);
+  if (_active == NULL && opened == NULL)
+  {
+    return;
+  }
+
+  AcquireSRWLockExclusive(&_lock);
+  if (_active != NULL)
+  {
+    _closing.push_back(_active);
+  }
+  if (opened != NULL)
+  {
+    _closing.push_back(opened);
+  }
+  ReleaseSRWLockExclusive(&_lock);
+  _active = NULL;
+  SetEvent(_wake);
+}
+
+DWORD WINAPI TraceRecorder::threadProc(LPVOID param)
+{
+  static_cast<TraceRecorder*>(param)->run();
+  return 0;
+}
+
+// Description:
+//   The helper thread body. Closes the traces handed to it, opens the one asked for and keeps
+//     the pages ahead of the newest one faulted in.
+void TraceRecorder::run()
+{
+  while (true)
+  {
+    WaitForSingleObject(_wake, INFINITE);
+
+    std::vector<Recording*> closing;
+    AcquireSRWLockExclusive(&_lock);
+    closing.swap(_closing);
+    const std::string path = _path;
+    const SIZE_T capacity = _capacity;
+    const DWORD generation = _requested;
+    _path.clear();
+    ReleaseSRWLockExclusive(&_lock);
+
+    for (Recording *recording : closing)
+    {
+      if (recording == _current)
+      {
+        _current = NULL;
+      }
+      close(recording);
+    }
+
+    if (!path.empty())
+    {
+      Recording *recording = open(path, capacity);
+      if (recording == NULL)
+      {
+        _failed = generation;
+        logMessage(LOG_ERROR, "Cannot record input trace to %s\n", path.c_str());
+      }
+      else
+      {
+        recording->generation = generation;
+        _current = recording;
+        logMessage(LOG_INFO, "Recording input trace to %s\n", path.c_str());
+
+        // One the input thread did not take is out of date.
+        Recording *stale = _opened.exchange(recording, std::memory_order_release);
+        if (stale != NULL)
+        {
+          close(stale);
+        }
+      }
+    }
+
+    if (_current != NULL)
+    {
+      prefault(*_current);
+    }
+
+    if (_stopping)
+    {
+      break;
+    }
+  }
+}
+
+// Description:
+//   Creates a trace file, preallocates it, maps it and writes its header.
+//
+// Params:
+//   path       The trace file to create. An existing file is overwritten.
+//   capacity   Number of bytes to preallocate
+//
+// Returns:
+//   The mapped trace, or NULL if it could not be created.
+TraceRecorder::Recording *TraceRecorder::open(const std::string &path, SIZE_T capacity)
+{
+  if (capacity < sizeof(TraceFileHeader))
+  {
+    return NULL;
+  }
+
+  Recording *recording = new Recording();
+  recording->file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, NULL);
+  if (recording->file == INVALID_HANDLE_VALUE)
+  {
+    delete recording;
+    return NULL;
+  }
+
+  // Creating a mapping larger than the file extends the file to the mapping size.
+  ULARGE_INTEGER size;
+  size.QuadPart = capacity;
+  recording->mapping = CreateFileMapping(recording->file, NULL, PAGE_READWRITE, size.HighPart, size.LowPart, NULL);
+  if (recording->mapping != NULL)
+  {
+    recording->view = (BYTE*)MapViewOfFile(recording->mapping, FILE_MAP_ALL_ACCESS, 0, 0, capacity);
+  }
+  if (recording->view == NULL)
+  {
+    close(recording);
+    return NULL;
+  }
+
+  TraceFileHeader header;
+  header.magic = TraceFileHeader::MAGIC;
+  header.version = TraceFileHeader::VERSION;
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  header.frequency = frequency.QuadPart;
+
+  memcpy(recording->view, &header, sizeof(header));
+  recording->capacity = capacity;
+  recording->used = sizeof(header);
+  prefault(*recording);
+  return recording;
+}
+
+// Description:
+//   Faults in the pages up to PREFAULT_WINDOW past the end of a trace, so appending to it does
+//     not take a page fault on the input thread.
+//
+// Params:
+//   recording  The trace
+void TraceRecorder::prefault(Recording &recording)
+{
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+
+  const SIZE_T used = recording.used.load(std::memory_order_relaxed);
+  const SIZE_T end = (std::min)(recording.capacity, used + PREFAULT_WINDOW);
+  SIZE_T offset = recording.prefaulted - recording.prefaulted % info.dwPageSize;
+  for (; offset < end; offset += info.dwPageSize)
+  {
+    // A locked add of 0 dirties the page and leaves whatever the input thread wrote there.
+    InterlockedExchangeAdd((volatile LONG*)(recording.view + offset), 0);
+  }
+  recording.prefaulted = (std::max)(recording.prefaulted, end);
+}
+
+// Description:
+//   Unmaps a trace, cuts the file down to the recorded data and closes it.
+//
+// Params:
+//   recording  The trace, or NULL
+void TraceRecorder::close(Recording *recording)
+{
+  if (recording == NULL)
+  {
+    return;
+  }
+
+  if (recording->view != NULL)
+  {
+    UnmapViewOfFile(recording->view);
+  }
+  if (recording->mapping != NULL)
+  {
+    CloseHandle(recording->mapping);
+  }
+  if (recording->file != INVALID_HANDLE_VALUE)
+  {
+    LARGE_INTEGER end;
+    end.QuadPart = recording->used.load();
+    SetFilePointerEx(recording->file, end, NULL, FILE_BEGIN);
+    SetEndOfFile(recording->file);
+    CloseHandle(recording->file);
+  }
+  delete recording;
+}
+
+// Description:
+//   Appends the controller states of one sample.
+//
+// Params:
+//   sample   The sample to record
+void TraceRecorder::recordSample(const InputSample &sample)
+{
+  BYTE *payload = reserve(TRACE_SAMPLE, sizeof(TraceSample), sample.timestamp);
+  if (payload == NULL)
+  {
+    return;
+  }
+
+  TraceSample *record = (TraceSample*)payload;
+  memcpy(&record->connected, &sample.connected, sizeof(sample.connected));
+  memcpy(record->states, sample.states, sizeof(sample.states));
+}
+
+// Description:
+//   Appends the events of one SendInput call.
+//
+// Params:
+//   inputs     The events sent
+//   count      Number of events in inputs
+//   timestamp  Performance counter value at the time of the call
+void TraceRecorder::recordInputs(const INPUT *inputs, UINT count, LONGLONG timestamp)
+{
+  BYTE *payload = reserve(TRACE_INPUT, count * sizeof(INPUT), timestamp);
+  if (payload != NULL)
+  {
+    memcpy(payload, inputs, count * sizeof(INPUT));
+  }
+}
+
+// Description:
+//   Gets the number of records lost because the preallocated space was full.
+//
+// Returns:
+//   The number of dropped records since recording started.
+unsigned long TraceRecorder::getDroppedRecords() const
+{
+  return _dropped;
+}
+
+// Description:
+//   Writes a record header and reserves space for its payload. Wakes the helper thread to fault
+//     in more pages once half of the window it faulted in is used.
+//
+// Params:
+//   type       The TraceRecordType of the record
+//   size       Bytes of payload
+//   timestamp  Performance counter value of the record
+//
+// Returns:
+//   Where to write the payload, or NULL if nothing is recorded or the record does not fit.
+BYTE *TraceRecorder::reserve(DWORD type, DWORD size, LONGLONG timestamp)
+{
+  if (_active == NULL)
+  {
+    return NULL;
+  }
+
+  const SIZE_T used = _active->used.load(std::memory_order_relaxed);
+  if (_active->capacity - used < sizeof(TraceRecord) + size)
+  {
+    ++_dropped;
+    return NULL;
+  }
+
+  TraceRecord record;
+  record.type = type;
+  record.size = size;
+  record.timestamp = timestamp;
+
+  BYTE *header = _active->view + used;
+  memcpy(header, &record, sizeof(record));
+  _active->used.store(used + sizeof(record) + size, std::memory_order_relaxed);
+
+  if (used >= _prefaultMark)
+  {
+    _prefaultMark = used + PREFAULT_WINDOW / 2;
+    SetEvent(_wake);
+  }
+  return header + sizeof(record);
+}
+
+RecordingSink::RecordingSink(InputSink* target, TraceRecorder* recorder)
+  : _target(target)
+  , _recorder(recorder)
+{
+}
+
+// Description:
+//   Records the events when a trace is being recorded and delivers them to the target sink.
+//
+// Params:
+//   inputs   The events to deliver
+//   count    Number of events in inputs
+void RecordingSink::send(const INPUT *inputs, UINT count)
+{
+  if (_recorder->isRecording())
+  {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    _recorder->recordInputs(inputs, count, now.QuadPart);
+  }
+
+  _target->send(inputs, count);
+}
+
+// Description:
+//   Reads the cursor position from the target sink.
+//
+// Params:
+//   point  Receives the position in screen coordinates
+void RecordingSink::getCursorPos(POINT &point)
+{
+  _target->getCursorPos(point);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "InputPoller.h"
+#include "InputSink.h"
+#include "InputTrace.h"
+
+// Records controller samples and generated inputs to a trace file in the InputTrace format.
+// The file is created, preallocated and mapped by a helper thread, which hands the finished view
+// to the input thread, so appending a record is a copy into the view; the system writes the
+// pages back in the background and the input thread never waits on disk I/O. The helper thread
+// also faults in a window of pages ahead of the end of the trace, and closes and trims the file
+// when recording stops. The data is part of the file cache as soon as it is copied, so a trace
+// survives the process being killed; the zeroed tail then reads as TRACE_END. Recording stops
+// when the preallocated space is used up.
+class TraceRecorder
+{
+private:
+  static const SIZE_T PREFAULT_WINDOW = 1024 * 1024;  // Bytes past the end of the trace kept faulted in.
+
+  // A trace file mapped by the helper thread.
+  struct Recording
+  {
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+    BYTE *view = NULL;
+    SIZE_T capacity = 0;                // Size of the mapped view in bytes.
+    std::atomic<SIZE_T> used{ 0 };      // Bytes written so far, including the file header.
+    SIZE_T prefaulted = 0;              // Bytes faulted in. Only used by the helper thread.
+    DWORD generation = 0;               // The start call it was opened for.
+  };
+
+  // Only used by the input thread.
+  Recording *_active;                   // The trace being recorded, NULL when none is.
+  DWORD _generation;                    // Counts the start and stop calls.
+  bool _started;                        // start was called since the last stop.
+  SIZE_T _prefaultMark;                 // Used bytes at which the helper thread is woken to fault in more.
+  unsigned long _dropped;               // Records that did not fit.
+
+  // Requests to the helper thread, guarded by _lock.
+  SRWLOCK _lock = SRWLOCK_INIT;
+  std::string _path;                    // Trace to open, empty for none.
+  SIZE_T _capacity;
+  DWORD _requested;                     // Generation of the trace to open.
+  std::vector<Recording*> _closing;     // Traces to close.
+
+  std::atomic<Recording*> _opened;      // Opened by the helper thread, not yet taken by the input thread.
+  std::atomic<DWORD> _failed;           // Generation of the last trace that could not be opened.
+  std::atomic<bool> _stopping;
+  HANDLE _wake;                         // Auto-reset event that wakes the helper thread.
+  HANDLE _thread;
+  Recording *_current;                  // Newest trace opened. Only used by the helper thread.
+
+public:
+  TraceRecorder();
+  ~TraceRecorder();
+
+  bool start(const std::string &path, SIZE_T capacity);
+
+  void stop();
+
+  // Description:
+  //   Tells whether start was called since the last stop and the trace did not fail to open.
+  bool isStarted() const
+  {
+    return _started && _failed.load(std::memory_order_relaxed) != _generation;
+  }
+
+  bool isRecording();
+
+  void recordSample(const InputSample &sample);
+
+  void recordInputs(const INPUT *inputs, UINT count, LONGLONG timestamp);
+
+  unsigned long getDroppedRecords() const;
+
+private:
+  BYTE *reserve(DWORD type, DWORD size, LONGLONG timestamp);
+
+  void detach();
+
+  static DWORD WINAPI threadProc(LPVOID param);
+
+  void run();
+
+  static Recording *open(const std::string &path, SIZE_T capacity);
+
+  static void prefault(Recording &recording);
+
+  static void close(Recording *recording);
+
+  TraceRecorder(const TraceRecorder&) = delete;
+  TraceRecorder& operator=(const TraceRecorder&) = delete;
+};
+
+// Forwards inputs to another sink, recording them on the way.
+class RecordingSink : public InputSink
+{
+private:
+  InputSink* _target;
+  TraceRecorder* _recorder;
+
+public:
+  RecordingSink(InputSink* target, TraceRecorder* recorder);
+
+  void send(const INPUT *inputs, UINT count) override;
+
+  void getCursorPos(POINT &point) override;
+};
@@ -27,7 +27,11 @@
 #pragma comment(lib, "XInput9_1_0.lib")
 #pragma comment(lib, "winmm") // for volume
 
+#include <memory>
+
+#include "ControllerManager.h"
 #include "Gopher.h"
+#include "HidBackend.h"
 
 bool ChangeVolume(double nVolume, bool bScalar); // Not used yet
 BOOL isRunningAsAdministrator(); // Check if administrator, makes on-screen keyboard clickable
@@ -40,14 +44,37 @@ BOOL isRunningAsAdministrator(); // Check if administrator, makes on-screen keyb
  *   http://msdn.microsoft.com/en-us/library/windows/desktop/microsoft.directx_sdk.reference.xinput_gamepad%28v=vs.85%29.aspx
  */
 
-int main()
+int main(int argc, char *argv[])
 {
-  CXBOXController controller(1);
-  Gopher gopher(&controller);
+  // -hid reads the pads through raw HID instead of XInput, e.g. a DualShock 4 without InputMapper.
+  std::unique_ptr<ControllerBackend> controllers;
+  for (int i = 1; i < argc && !controllers; ++i)
+  {
+    if (_stricmp(argv[i], "-hid") == 0)
+    {
+      controllers.reset(new HidBackend());
+    }
+  }
+  if (!controllers)
+  {
+    controllers.reset(new ControllerManager());
+  }
+
+  SystemInputSink sink;
+  Gopher gopher(controllers.get(), &sink);
   HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
   SetConsoleTitle( TEXT( "Gopher360" ) );
 
-  system("Color 1D");
+  // Same as "Color 1D", without starting cmd.exe for it.
+  CONSOLE_SCREEN_BUFFER_INFO screen;
+  if (GetConsoleScreenBufferInfo(hConsole, &screen))
+  {
+    const COORD origin = { 0, 0 };
+    DWORD written;
+    FillConsoleOutputAttribute(hConsole, 0x1D, screen.dwSize.X * screen.dwSize.Y, origin, &written);
+  }
+  SetConsoleTextAttribute(hConsole, 0x1D);
+  setLogConsole(true);
 
   printf("Welcome to Gopher360 - a VERY fast and lightweight controller-to-keyboard & mouse input tool.\n");
   printf("All you need is an Xbox360/Xbone controller (wired or wireless adapter), or DualShock (with InputMapper 1.5+)\n");
@@ -72,6 +99,8 @@ int main()
   }
 
   gopher.loadConfigFile();
+  gopher.loadState("gopher.state");
+  gopher.start();
 
   // Start the Gopher program loop
   while (true)
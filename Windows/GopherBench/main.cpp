@@ -0,0 +1,469 @@
+// Headless benchmark of the Gopher mapping pipeline. Replays a recorded input trace, or a
+// synthetic one, through Gopher::handleSample into a sink that only counts the generated
+// events, and reports the CPU cost and heap allocations per frame. The steady-state loop must
+// not allocate; the benchmark exits with status 2 when a measured frame did. The analog kernel
+// is also checked and timed on its own against its scalar reference, with every pad slot in use.
+// Only the mapping settings of the config.ini in the working directory are used: the benchmark
+// creates no file, records no trace and leaves log files and thread scheduling alone.
+//
+// With -stats, prints the latency stats a running Gopher publishes instead: all of them, or
+// only those recorded over the given number of seconds, e.g. to compare the tick jitter with
+// MMCSS_TASK, the affinities and NO_POWER_THROTTLING set and unset.
+//
+// Usage: GopherBench [trace file] [passes]
+//        GopherBench -stats [seconds]
+
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "AnalogKernel.h"
+#include "ControllerManager.h"
+#include "Gopher.h"
+#include "InputTrace.h"
+
+#pragma comment(lib, "XInput9_1_0.lib")
+
+// Every heap allocation made by the process, counted by the replacement operator new below.
+static std::atomic<unsigned long long> allocations(0);
+
+void *operator new(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void *memory = malloc(size == 0 ? 1 : size);
+  if (memory == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+  free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+  free(memory);
+}
+
+// A controller slot without hardware behind it.
+class NullController : public IController
+{
+public:
+  DWORD Poll(XINPUT_STATE &state) override
+  {
+    ZeroMemory(&state, sizeof(state));
+    return ERROR_DEVICE_NOT_CONNECTED;
+  }
+
+  bool IsConnected() override
+  {
+    return false;
+  }
+
+  void Vibrate(const HapticEffect &effect) override
+  {
+  }
+
+  void StopVibration() override
+  {
+  }
+};
+
+// Counts the generated events and tracks relative cursor motion on a simulated desktop.
+class CountingSink : public InputSink
+{
+private:
+  POINT _cursor;
+
+public:
+  unsigned long long events;
+  unsigned long long batches;
+
+  CountingSink()
+    : events(0)
+    , batches(0)
+  {
+    _cursor.x = 960;
+    _cursor.y = 540;
+  }
+
+  void send(const INPUT *inputs, UINT count) override
+  {
+    events += count;
+    ++batches;
+
+    for (UINT i = 0; i < count; ++i)
+    {
+      const MOUSEINPUT &mouse = inputs[i].mi;
+      if (inputs[i].type == INPUT_MOUSE && (mouse.dwFlags & MOUSEEVENTF_MOVE) && !(mouse.dwFlags & MOUSEEVENTF_ABSOLUTE))
+      {
+        _cursor.x += mouse.dx;
+        _cursor.y += mouse.dy;
+      }
+    }
+  }
+
+  void getCursorPos(POINT &point) override
+  {
+    point = _cursor;
+  }
+};
+
+// Description:
+//   Builds a trace of one pad sweeping both sticks in circles while tapping the face buttons
+//     and triggers, so every stage of the mapping has work to do.
+//
+// Params:
+//   count      Number of samples to generate
+//   frequency  Counter frequency used for the sample timestamps
+//
+// Returns:
+//   The generated samples, 150 per simulated second.
+static std::vector<InputSample> makeSyntheticTrace(int count, LONGLONG frequency)
+{
+  static const WORD BUTTONS[] = { XINPUT_GAMEPAD_A, XINPUT_GAMEPAD_B, XINPUT_GAMEPAD_X, XINPUT_GAMEPAD_DPAD_UP };
+
+  std::vector<InputSample> samples(count);
+  for (int i = 0; i < count; ++i)
+  {
+    InputSample &sample = samples[i];
+    ZeroMemory(&sample, sizeof(sample));
+    sample.timestamp = frequency * i / 150;
+    sample.connected = 1;
+
+    XINPUT_GAMEPAD &pad = sample.states[0].Gamepad;
+    sample.states[0].dwPacketNumber = i;
+
+    const double angle = i * 0.02;
+    pad.sThumbLX = (SHORT)(std::cos(angle) * 30000);
+    pad.sThumbLY = (SHORT)(std::sin(angle) * 30000);
+    pad.sThumbRY = (SHORT)(std::sin(angle * 3) * 20000);
+
+    if ((i / 15) % 2 == 0)
+    {
+      pad.wButtons = BUTTONS[(i / 30) % (sizeof(BUTTONS) / sizeof(BUTTONS[0]))];
+    }
+    if ((i / 40) % 2 == 0)
+    {
+      pad.bLeftTrigger = 200;
+    }
+  }
+
+  return samples;
+}
+
+// Description:
+//   Checks that one output of the two analog kernels is the same, within float rounding.
+static bool sameOutput(float expected, float actual)
+{
+  return std::fabs(expected - actual) <= 1e-4f * (std::max)(1.0f, std::fabs(expected));
+}
+
+// Description:
+//   Compares every output of the two analog kernels for one frame.
+//
+// Params:
+//   scalar   Outputs of processAnalogScalar
+//   sse2     Outputs of processAnalog
+//   frame    Index of the frame, for the report
+//
+// Returns:
+//   false if an output differs, after printing it.
+static bool compareAnalog(const AnalogFrame &scalar, const AnalogFrame &sse2, size_t frame)
+{
+  if (scalar.active != sse2.active)
+  {
+    printf("FAILED: frame %zu: active is 0x%x in the scalar kernel and 0x%x in the sse2 one\n", frame, scalar.active, sse2.active);
+    return false;
+  }
+
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+  {
+    const float expected[4] = { scalar.cursorX[i], scalar.cursorY[i], scalar.wheelX[i], scalar.wheelY[i] };
+    const float actual[4] = { sse2.cursorX[i], sse2.cursorY[i], sse2.wheelX[i], sse2.wheelY[i] };
+    const char *names[4] = { "cursorX", "cursorY", "wheelX", "wheelY" };
+    for (int field = 0; field < 4; ++field)
+    {
+      if (!sameOutput(expected[field], actual[field]))
+      {
+        printf("FAILED: frame %zu: %s[%u] is %g in the scalar kernel and %g in the sse2 one\n",
+               frame, names[field], i, expected[field], actual[field]);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+// Description:
+//   Checks the analog kernel against its scalar reference on every sample, then times both.
+//     Every slot replays pad 0 of the trace from a different point, mirrored or with its sticks
+//     swapped, so that each lane sees different input and both triggers drive an output.
+//
+// Params:
+//   samples  The samples to process
+//   passes   Number of times the samples are processed by each kernel
+//
+// Returns:
+//   false if the two kernels disagree.
+static bool benchmarkAnalog(std::vector<InputSample> samples, int passes)
+{
+  const std::vector<InputSample> trace = samples;
+  for (size_t n = 0; n < samples.size(); ++n)
+  {
+    for (DWORD i = 1; i < XUSER_MAX_COUNT; ++i)
+    {
+      XINPUT_STATE &state = samples[n].states[i];
+      state = trace[(n + i * trace.size() / XUSER_MAX_COUNT + i * 37) % trace.size()].states[0];
+
+      XINPUT_GAMEPAD &pad = state.Gamepad;
+      if (i == 1)
+      {
+        pad.sThumbLX = (SHORT)(-1 - pad.sThumbLX);
+        pad.sThumbRY = (SHORT)(-1 - pad.sThumbRY);
+      }
+      else if (i == 2)
+      {
+        std::swap(pad.sThumbLX, pad.sThumbRX);
+        std::swap(pad.sThumbLY, pad.sThumbRY);
+        std::swap(pad.bLeftTrigger, pad.bRightTrigger);
+      }
+      else
+      {
+        std::swap(pad.sThumbLX, pad.sThumbLY);
+        pad.sThumbRX = (SHORT)(pad.sThumbRY / 2);
+        pad.bRightTrigger = (BYTE)(255 - pad.bLeftTrigger);
+      }
+    }
+    samples[n].connected = (1 << XUSER_MAX_COUNT) - 1;
+  }
+
+  ResponseCurve cursorCurve;
+  ResponseCurve scrollCurve;
+  ResponseCurve triggerCurve;
+  cursorCurve.build(6000.0f, 1.5f, 0.025f, 150);
+  scrollCurve.build(5000.0f, 0.0f, 0.1f, 150);
+  triggerCurve.build(30 * TRIGGER_TO_STICK, 0.0f, 1.0f, 1);
+
+  AnalogSettings settings;
+  settings.cursorCurve = &cursorCurve;
+  settings.scrollCurve = &scrollCurve;
+  settings.triggerCurve = &triggerCurve;
+  settings.cursorDeadZoneSq = 6000.0f * 6000.0f;
+  settings.scrollDeadZoneSq = 5000.0f * 5000.0f;
+  settings.triggerRest[0] = 30.0f;
+  settings.triggerRest[1] = 30.0f;
+  settings.triggerSpeed[0] = -0.75f;
+  settings.triggerWheel[1] = -20.0f;
+
+  // Both kernels must produce the same outputs on every frame before their speed matters.
+  for (size_t n = 0; n < samples.size(); ++n)
+  {
+    AnalogFrame scalar;
+    AnalogFrame sse2;
+    processAnalogScalar(samples[n].states, settings, scalar);
+    processAnalog(samples[n].states, settings, sse2);
+    if (!compareAnalog(scalar, sse2, n))
+    {
+      return false;
+    }
+  }
+
+  typedef void (*Kernel)(const XINPUT_STATE states[XUSER_MAX_COUNT], const AnalogSettings &settings, AnalogFrame &frame);
+  const Kernel kernels[2] = { processAnalogScalar, processAnalog };
+  const char *names[2] = { "scalar", "sse2" };
+  double nanoseconds[2];
+
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  for (int k = 0; k < 2; ++k)
+  {
+    AnalogFrame frame;
+    volatile float sink = 0.0f;   // Keeps the outputs alive.
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+    for (int pass = 0; pass < passes; ++pass)
+    {
+      for (const InputSample &sample : samples)
+      {
+        kernels[k](sample.states, settings, frame);
+        sink = sink + frame.cursorX[3] + frame.wheelY[2];
+      }
+    }
+    LARGE_INTEGER end;
+    QueryPerformanceCounter(&end);
+
+    nanoseconds[k] = (double)(end.QuadPart - start.QuadPart) * 1e9 / frequency.QuadPart / ((double)samples.size() * passes);
+    printf("analog %-6s     %.1f ns/frame\n", names[k], nanoseconds[k]);
+  }
+  printf("analog speedup:    %.2fx\n", nanoseconds[0] / nanoseconds[1]);
+  return true;
+}
+
+// Description:
+//   Prints the stats published by a running Gopher.
+//
+// Params:
+//   seconds  How long to record before printing what was recorded meanwhile, 0 for all stats
+//
+// Returns:
+//   The exit status: 0 on success, 1 if no Gopher is publishing stats.
+static int printStats(int seconds)
+{
+  HANDLE mapping = OpenFileMapping(FILE_MAP_READ, FALSE, STATS_MAPPING_NAME);
+  if (mapping == NULL)
+  {
+    printf("No running Gopher is publishing stats\n");
+    return 1;
+  }
+
+  const StatsBlock *block = (const StatsBlock*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(StatsBlock));
+  CloseHandle(mapping);
+  if (block == NULL)
+  {
+    printf("Cannot map the stats\n");
+    return 1;
+  }
+
+  int status = 0;
+  if (block->magic != StatsBlock::MAGIC || block->version != StatsBlock::VERSION
+    || block->stageCount != STAT_COUNT || block->bucketCount != StatsHistogram::BUCKET_COUNT)
+  {
+    printf("The running Gopher publishes stats of another version\n");
+    status = 1;
+  }
+  else if (seconds <= 0)
+  {
+    printf("%s", Stats::summary(*block).c_str());
+  }
+  else
+  {
+    // Value-initialized, so the first difference makes a copy of the live stats.
+    std::unique_ptr<StatsBlock> zero(new StatsBlock());
+    std::unique_ptr<StatsBlock> start(new StatsBlock());
+    std::unique_ptr<StatsBlock> interval(new StatsBlock());
+    Stats::difference(*zero, *block, *start);
+    printf("Recording for %d seconds...\n", seconds);
+    Sleep((DWORD)seconds * 1000);
+    Stats::difference(*start, *block, *interval);
+    printf("%s", Stats::summary(*interval).c_str());
+  }
+
+  UnmapViewOfFile(block);
+  return status;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc > 1 && _stricmp(argv[1], "-stats") == 0)
+  {
+    return printStats(argc > 2 ? atoi(argv[2]) : 0);
+  }
+
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+
+  std::vector<InputSample> samples;
+  LONGLONG traceFrequency = frequency.QuadPart;
+  if (argc > 1)
+  {
+    if (!loadTraceSamples(argv[1], samples, traceFrequency) || samples.empty())
+    {
+      printf("Cannot read trace %s\n", argv[1]);
+      return 1;
+    }
+
+    // Gopher measures time on the local performance counter.
+    for (InputSample &sample : samples)
+    {
+      sample.timestamp = (LONGLONG)((double)sample.timestamp * frequency.QuadPart / traceFrequency);
+    }
+    traceFrequency = frequency.QuadPart;
+  }
+  else
+  {
+    samples = makeSyntheticTrace(150 * 60, traceFrequency);
+  }
+
+  const int passes = argc > 2 ? (std::max)(1, atoi(argv[2])) : 100;
+
+  ControllerManager controllers;
+  for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+  {
+    controllers.setController(i, std::unique_ptr<IController>(new NullController()));
+  }
+
+  CountingSink sink;
+  Gopher gopher(&controllers, &sink);
+  gopher.loadConfigFile(false);
+
+  // Timers such as hold, double tap and turbo only fire for samples from the time the timer
+  // wheel was created on, so the trace starts now rather than at 0 or in the recorded session.
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  const LONGLONG offset = now.QuadPart - samples.front().timestamp;
+  for (InputSample &sample : samples)
+  {
+    sample.timestamp += offset;
+  }
+
+  // Warm up caches and any lazily allocated state before measuring.
+  for (const InputSample &sample : samples)
+  {
+    gopher.handleSample(sample);
+  }
+
+  const unsigned long long events = sink.events;
+  const unsigned long long allocationsStart = allocations.load();
+  LARGE_INTEGER start;
+  QueryPerformanceCounter(&start);
+
+  // Each pass continues the timeline of the previous one so time based logic keeps working.
+  const LONGLONG traceLength = samples.back().timestamp - samples.front().timestamp + traceFrequency / 150;
+  for (int pass = 1; pass <= passes; ++pass)
+  {
+    for (InputSample sample : samples)
+    {
+      sample.timestamp += traceLength * pass;
+      gopher.handleSample(sample);
+    }
+  }
+
+  LARGE_INTEGER end;
+  QueryPerformanceCounter(&end);
+
+  const double frames = (double)samples.size() * passes;
+  const double seconds = (double)(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+  const unsigned long long frameAllocations = allocations.load() - allocationsStart;
+
+  printf("frames:            %.0f (%zu samples x %d passes)\n", frames, samples.size(), passes);
+  printf("time per frame:    %.1f ns\n", seconds * 1e9 / frames);
+  printf("frames per second: %.0f\n", frames / seconds);
+  printf("allocations/frame: %.3f\n", frameAllocations / frames);
+  printf("events/frame:      %.3f\n", (sink.events - events) / frames);
+
+  if (frameAllocations != 0)
+  {
+    printf("FAILED: %llu heap allocations in the measured frames\n", frameAllocations);
+    return 2;
+  }
+
+  if (!benchmarkAnalog(samples, passes))
+  {
+    return 3;
+  }
+
+  return 0;
+}
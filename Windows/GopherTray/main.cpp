@@ -0,0 +1,186 @@
+// Gopher360 without a console: runs the same loop as Gopher.exe behind a notification area icon,
+// for machines where a console window is in the way or too heavy.
+
+#include <windows.h>
+#include <shellapi.h>
+
+#pragma comment(lib, "XInput9_1_0.lib")
+#pragma comment(lib, "winmm") // for volume
+
+#include <memory>
+
+#include "ControllerManager.h"
+#include "Gopher.h"
+#include "HidBackend.h"
+#include "resource.h"
+
+static const UINT WM_TRAY = WM_APP + 1;  // Sent by the notification area icon.
+static const UINT ID_SHOW_LOG = 1;
+static const UINT ID_EXIT = 2;
+
+static UINT taskbarCreated = 0;          // Broadcast when Explorer restarts and the icon is lost.
+static NOTIFYICONDATA trayIcon;
+
+// Description:
+//   Runs the Gopher loop until Gopher::stop is called, then releases whatever the pads still
+//     hold. The UI thread only handles the icon, so a stalled menu never delays input.
+static DWORD WINAPI gopherThread(LPVOID param)
+{
+  Gopher *gopher = static_cast<Gopher*>(param);
+  while (gopher->isRunning())
+  {
+    gopher->loop();
+  }
+  gopher->releaseAll();
+  return 0;
+}
+
+// Description:
+//   Shows the icon menu at the cursor and runs the picked command.
+static void showMenu(HWND window)
+{
+  HMENU menu = CreatePopupMenu();
+  if (menu == NULL)
+  {
+    return;
+  }
+  AppendMenu(menu, MF_STRING, ID_SHOW_LOG, TEXT("Show log"));
+  AppendMenu(menu, MF_SEPARATOR, 0, NULL);
+  AppendMenu(menu, MF_STRING, ID_EXIT, TEXT("Exit"));
+
+  POINT cursor;
+  GetCursorPos(&cursor);
+  // Without this the menu does not close when clicking elsewhere.
+  SetForegroundWindow(window);
+  const UINT command = TrackPopupMenu(menu, TPM_RETURNCMD | TPM_NONOTIFY | TPM_RIGHTBUTTON, cursor.x, cursor.y, 0, window, NULL);
+  DestroyMenu(menu);
+
+  if (command == ID_SHOW_LOG)
+  {
+    MessageBoxA(window, getLogText().c_str(), "Gopher360", MB_OK | MB_ICONINFORMATION);
+  }
+  else if (command == ID_EXIT)
+  {
+    DestroyWindow(window);
+  }
+}
+
+static LRESULT CALLBACK windowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam)
+{
+  if (message == WM_TRAY)
+  {
+    if (lParam == WM_RBUTTONUP || lParam == WM_LBUTTONUP)
+    {
+      showMenu(window);
+    }
+    return 0;
+  }
+  if (message == taskbarCreated && taskbarCreated != 0)
+  {
+    Shell_NotifyIcon(NIM_ADD, &trayIcon);
+    return 0;
+  }
+  if (message == WM_DESTROY)
+  {
+    Shell_NotifyIcon(NIM_DELETE, &trayIcon);
+    PostQuitMessage(0);
+    return 0;
+  }
+  return DefWindowProc(window, message, wParam, lParam);
+}
+
+// Description:
+//   Tells whether an option was passed on the command line as a whole argument, so that e.g.
+//     -hid does not match -hidden.
+//
+// Params:
+//   option   The option, compared ignoring case
+static bool hasOption(LPCWSTR option)
+{
+  int argc = 0;
+  LPWSTR *argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+  if (argv == NULL)
+  {
+    return false;
+  }
+
+  bool found = false;
+  for (int i = 1; i < argc && !found; ++i)
+  {
+    found = _wcsicmp(argv[i], option) == 0;
+  }
+  LocalFree(argv);
+  return found;
+}
+
+int WINAPI WinMain(HINSTANCE instance, HINSTANCE previous, LPSTR commandLine, int show)
+{
+  // -hid reads the pads through raw HID instead of XInput, like Gopher.exe -hid.
+  std::unique_ptr<ControllerBackend> controllers;
+  if (hasOption(L"-hid"))
+  {
+    controllers.reset(new HidBackend());
+  }
+  else
+  {
+    controllers.reset(new ControllerManager());
+  }
+
+  SystemInputSink sink;
+  Gopher gopher(controllers.get(), &sink);
+
+  WNDCLASS windowClass;
+  ZeroMemory(&windowClass, sizeof(windowClass));
+  windowClass.lpfnWndProc = windowProc;
+  windowClass.hInstance = instance;
+  windowClass.lpszClassName = TEXT("Gopher360Tray");
+  if (!RegisterClass(&windowClass))
+  {
+    return 1;
+  }
+
+  // A hidden top level window: message-only windows do not get the TaskbarCreated broadcast.
+  HWND window = CreateWindow(windowClass.lpszClassName, TEXT("Gopher360"), 0, 0, 0, 0, 0, NULL, NULL, instance, NULL);
+  if (window == NULL)
+  {
+    return 1;
+  }
+  taskbarCreated = RegisterWindowMessage(TEXT("TaskbarCreated"));
+
+  ZeroMemory(&trayIcon, sizeof(trayIcon));
+  trayIcon.cbSize = sizeof(trayIcon);
+  trayIcon.hWnd = window;
+  trayIcon.uFlags = NIF_ICON | NIF_MESSAGE | NIF_TIP;
+  trayIcon.uCallbackMessage = WM_TRAY;
+  trayIcon.hIcon = LoadIcon(instance, MAKEINTRESOURCE(IDI_ICON1));
+  lstrcpyn(trayIcon.szTip, TEXT("Gopher360"), sizeof(trayIcon.szTip) / sizeof(trayIcon.szTip[0]));
+  Shell_NotifyIcon(NIM_ADD, &trayIcon);
+
+  gopher.loadConfigFile();
+  gopher.loadState("gopher.state");
+  gopher.start();
+
+  HANDLE thread = CreateThread(NULL, 0, gopherThread, &gopher, 0, NULL);
+  if (thread == NULL)
+  {
+    Shell_NotifyIcon(NIM_DELETE, &trayIcon);
+    return 1;
+  }
+
+  // Startup touched pages that are not needed again, such as the config parser. Let them go
+  // rather than keep them resident.
+  SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
+
+  MSG msg;
+  while (GetMessage(&msg, NULL, 0, 0) > 0)
+  {
+    TranslateMessage(&msg);
+    DispatchMessage(&msg);
+  }
+
+  // Let the loop thread release held keys and buttons before the process goes away.
+  gopher.stop();
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+  ExitProcess(0);
+}